@@ -51,4 +51,14 @@ extern void process_parameter(const char*name);
   /* Set the default timescale for the simulator. */
 extern void process_timescale(const char*ts_string);
 
+  /* Record and check the inputs of an incremental (-i) compile. */
+extern void stamp_key(int argc, char*argv[]);
+extern void stamp_add_file(const char*path);
+extern void stamp_add_dir(const char*path);
+extern void stamp_add_target(const char*conf_path, const char*base);
+extern int  stamp_up_to_date(const char*out_path);
+extern void stamp_write(const char*out_path, const char*dep_path,
+			char dep_mode);
+extern void stamp_cleanup(void);
+
 #endif
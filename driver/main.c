@@ -38,7 +38,7 @@ const char NOTICE[] =
 ;
 
 const char HELP[] =
-"Usage: iverilog [-ESvV] [-B base] [-c cmdfile|-f cmdfile]\n"
+"Usage: iverilog [-EiSvV] [-B base] [-c cmdfile|-f cmdfile]\n"
 "                [-g1995|-g2001|-g2005|-g2005-sv|-g2009] [-g<feature>]\n"
 "                [-D macro[=defn]] [-I includedir]\n"
 "                [-M [mode=]depfile] [-m module]\n"
@@ -114,6 +114,8 @@ const char*opath = "a.out";
 const char*npath = 0;
 const char*targ  = "vvp";
 const char*depfile = 0;
+  /* The dependency file that -i uses when there is no -M flag. */
+static char*stamp_depfile = 0;
 
 const char**vhdlpp_libdir = 0;
 unsigned vhdlpp_libdir_cnt = 0;
@@ -161,6 +163,7 @@ char*compiled_defines_path = 0;
 static char iconfig_common_path[4096] = "";
 
 int synth_flag = 0;
+int incremental_flag = 0;
 int verbose_flag = 0;
 
 FILE *fp;
@@ -335,6 +338,31 @@ static int t_version_only(void)
       return 0;
 }
 
+/*
+ * The output of an incremental compile is up to date, so there is
+ * nothing to do but remove the temporary files.
+ */
+static int t_up_to_date(void)
+{
+      fclose(iconfig_file);
+      if ( ! getenv("IVERILOG_ICONFIG")) {
+	    remove(iconfig_path);
+	    free(iconfig_path);
+      }
+      remove(source_path);
+      free(source_path);
+      remove(defines_path);
+      free(defines_path);
+      remove(compiled_defines_path);
+      free(compiled_defines_path);
+      if (stamp_depfile) {
+	    remove(stamp_depfile);
+	    free(stamp_depfile);
+      }
+      stamp_cleanup();
+      return 0;
+}
+
 static void build_preprocess_command(int e_flag)
 {
       snprintf(tmp, sizeof tmp, "%s%civlpp %s%s -F\"%s\" -f\"%s\" -p\"%s\" ",
@@ -561,11 +589,13 @@ static void process_warning_switch(const char*name)
 void process_library_switch(const char *name)
 {
       fprintf(iconfig_file, "-y:%s\n", name);
+      stamp_add_dir(name);
 }
 
 void process_library_nocase_switch(const char *name)
 {
       fprintf(iconfig_file, "-yl:%s\n", name);
+      stamp_add_dir(name);
 }
 
 void process_library2_switch(const char *name)
@@ -576,6 +606,7 @@ void process_library2_switch(const char *name)
 void process_include_dir(const char *name)
 {
       fprintf(defines_file, "I:%s\n", name);
+      stamp_add_dir(name);
 }
 
 void process_define(const char*name)
@@ -884,7 +915,7 @@ int main(int argc, char **argv)
 	}
       }
 
-      while ((opt = getopt(argc, argv, "B:c:D:d:Ef:g:hI:M:m:N::o:P:p:Ss:T:t:vVW:y:Y:")) != EOF) {
+      while ((opt = getopt(argc, argv, "B:c:D:d:Ef:g:hiI:M:m:N::o:P:p:Ss:T:t:vVW:y:Y:")) != EOF) {
 
 	    switch (opt) {
 		case 'B':
@@ -935,6 +966,10 @@ int main(int argc, char **argv)
 		  fprintf(stderr, "%s\n", HELP);
 		  return 1;
 
+		case 'i':
+		  incremental_flag = 1;
+		  break;
+
 		case 'I':
 		  process_include_dir(optarg);
 		  break;
@@ -1038,6 +1073,31 @@ int main(int argc, char **argv)
       snprintf(iconfig_common_path, sizeof iconfig_common_path, "%s%c%s%s.conf",
 	      base, sep, targ, synth_flag? "-s" : "");
 
+	/* An incremental compile needs the full list of files that go
+	   into the output. If there is no -M flag, have the compiler
+	   write the list into a temporary file. */
+      if (incremental_flag && (version_flag || e_flag)) {
+	    incremental_flag = 0;
+      } else if (incremental_flag && depfile == 0) {
+	    FILE*tmp_file = 0;
+	    stamp_depfile = strdup(my_tempfile("ivrli", &tmp_file));
+	    if (tmp_file) fclose(tmp_file);
+	    depfile = stamp_depfile;
+	    depmode = 'a';
+      } else if (incremental_flag && (depmode == 'i' || depmode == 'm')) {
+	    fprintf(stderr, "%s: warning: -i needs -M in all or prefix "
+		    "mode, compiling everything.\n", argv[0]);
+	    incremental_flag = 0;
+      }
+
+      if (incremental_flag) {
+	    stamp_key(argc, argv);
+	    stamp_add_file(iconfig_common_path);
+	    stamp_add_target(iconfig_common_path, base);
+	    snprintf(tmp, sizeof tmp, "%s%civl", base, sep);
+	    stamp_add_file(tmp);
+      }
+
 	/* Write values to the iconfig file. */
       fprintf(iconfig_file, "basedir:%s\n", base);
 
@@ -1096,6 +1156,9 @@ int main(int argc, char **argv)
 		  return 1;
 	    }
 
+	    if (incremental_flag)
+		  stamp_add_file(command_filename);
+
 	    cfreset(fp, command_filename);
 	    rc = cfparse();
 	    if (rc != 0) {
@@ -1152,6 +1215,16 @@ int main(int argc, char **argv)
       fclose(defines_file);
       defines_file = 0;
 
+	/* If nothing that goes into the output has changed since the
+	   last incremental compile, then keep the output that is
+	   there. This is checked before the dependency file is
+	   truncated, so that it still lists the files. */
+      if (incremental_flag && source_count > 0 && stamp_up_to_date(opath)) {
+	    if (verbose_flag)
+		  printf("%s is up to date.\n", opath);
+	    return t_up_to_date();
+      }
+
 	/* If we are planning on opening a dependencies file, then
 	   open and truncate it here. The other phases of compilation
 	   will append to the file, so this is necessary to make sure
@@ -1188,5 +1261,17 @@ int main(int argc, char **argv)
 	    return t_preprocess_only();
 
 	/* Otherwise, this is a full compile. */
+      if (incremental_flag) {
+	    int rc = t_compile();
+	    if (rc == 0)
+		  stamp_write(opath, depfile, depmode);
+	    if (stamp_depfile) {
+		  remove(stamp_depfile);
+		  free(stamp_depfile);
+	    }
+	    stamp_cleanup();
+	    return rc;
+      }
+
       return t_compile();
 }
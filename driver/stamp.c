@@ -0,0 +1,321 @@
+/*
+ * Copyright (c) 2012 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+# include  "config.h"
+# include  "version_base.h"
+
+# include  <stdio.h>
+# include  <stdlib.h>
+# include  <string.h>
+# include  <unistd.h>
+# include  <sys/types.h>
+# include  <sys/stat.h>
+# include  <dirent.h>
+# include  "globals.h"
+# include  "ivl_alloc.h"
+
+/*
+ * The -i flag makes the compile incremental. After a compile that
+ * succeeds, the driver writes next to the output file a stamp file
+ * that lists every file that went into the output, with its size and
+ * modification time:
+ *
+ *    iverilog-stamp 2
+ *    K <key>
+ *    O <size> <mtime>
+ *    D <size> <mtime> <path>       (one for each input file)
+ *    L <hash> <path>               (one for each -y or -I directory)
+ *
+ * The key is a hash of the command line, the working directory and
+ * the compiler version. The next compile with the same key checks the
+ * stamp, and if the output and all the inputs are unchanged, it skips
+ * the compile and keeps the output that is there.
+ *
+ * A file added to a library or include directory can change the
+ * output without changing any of the inputs, for example if it
+ * defines a module that was missing or comes earlier in the search.
+ * So the stamp also keeps a hash of the names in each of these
+ * directories. Only the names directly in the directory are checked.
+ */
+
+static char**extra_files = 0;
+static unsigned extra_cnt = 0;
+
+static char**search_dirs = 0;
+static unsigned search_cnt = 0;
+
+static unsigned long stamp_key_value = 0;
+
+static unsigned long hash_string(unsigned long hash, const char*str)
+{
+      do {
+	    hash = (hash ^ (unsigned char)*str) * 16777619UL;
+      } while (*str++);
+      return hash & 0xffffffffUL;
+}
+
+void stamp_key(int argc, char*argv[])
+{
+      char cwd[4096];
+      unsigned long hash = 2166136261UL;
+      int idx;
+
+      hash = hash_string(hash, VERSION);
+      if (getcwd(cwd, sizeof cwd))
+	    hash = hash_string(hash, cwd);
+      for (idx = 1 ;  idx < argc ;  idx += 1)
+	    hash = hash_string(hash, argv[idx]);
+
+      stamp_key_value = hash;
+}
+
+void stamp_add_file(const char*path)
+{
+      extra_files = realloc(extra_files, (extra_cnt+1) * sizeof(char*));
+      extra_files[extra_cnt] = strdup(path);
+      extra_cnt += 1;
+}
+
+void stamp_add_dir(const char*path)
+{
+      search_dirs = realloc(search_dirs, (search_cnt+1) * sizeof(char*));
+      search_dirs[search_cnt] = strdup(path);
+      search_cnt += 1;
+}
+
+/*
+ * Hash the names in a directory. The order that readdir returns them
+ * in is not fixed, so the hashes of the names are added together. A
+ * directory that cannot be read has the hash 0.
+ */
+static unsigned long dir_hash(const char*path)
+{
+      unsigned long hash = 0;
+      struct dirent*ent;
+      DIR*dir = opendir(path);
+
+      if (dir == 0)
+	    return 0;
+
+      while ((ent = readdir(dir)))
+	    hash += hash_string(2166136261UL, ent->d_name);
+      closedir(dir);
+
+      return (hash & 0xffffffffUL) | 1;
+}
+
+/*
+ * The code generator is the module named by the DLL flag in the
+ * target configuration file. ivl loads that name as it is, or else
+ * from the base directory, so add the first of those that exists.
+ */
+void stamp_add_target(const char*conf_path, const char*base)
+{
+      char line[4096];
+      char*dll = 0;
+      char*path;
+      struct stat sb;
+      FILE*fd = fopen(conf_path, "r");
+
+      if (fd == 0)
+	    return;
+
+      while (fgets(line, sizeof line, fd)) {
+	    line[strcspn(line, "\r\n")] = 0;
+	    if (strncmp(line, "flag:DLL=", 9) == 0) {
+		  free(dll);
+		  dll = strdup(line+9);
+	    }
+      }
+      fclose(fd);
+
+      if (dll == 0)
+	    return;
+
+      if (dll[0] == '/' || stat(dll, &sb) == 0) {
+	    stamp_add_file(dll);
+      } else {
+	    path = malloc(strlen(base) + strlen(dll) + 2);
+	    sprintf(path, "%s/%s", base, dll);
+	    stamp_add_file(path);
+	    free(path);
+      }
+      free(dll);
+}
+
+static char* stamp_path(const char*out_path)
+{
+      char*path = malloc(strlen(out_path) + 10);
+      strcpy(path, out_path);
+      strcat(path, ".ivlstamp");
+      return path;
+}
+
+int stamp_up_to_date(const char*out_path)
+{
+      char line[4096];
+      unsigned long long size;
+      long long mtime;
+      unsigned long key;
+      int pos, rc = 0;
+      struct stat sb;
+      char*path = stamp_path(out_path);
+      FILE*fd = fopen(path, "r");
+
+      free(path);
+      if (fd == 0)
+	    return 0;
+
+      if (fgets(line, sizeof line, fd) == 0
+	  || strcmp(line, "iverilog-stamp 2\n") != 0)
+	    goto done;
+
+      if (fgets(line, sizeof line, fd) == 0
+	  || sscanf(line, "K %lx", &key) != 1
+	  || key != stamp_key_value)
+	    goto done;
+
+      if (fgets(line, sizeof line, fd) == 0
+	  || sscanf(line, "O %llu %lld", &size, &mtime) != 2
+	  || stat(out_path, &sb) != 0
+	  || size != (unsigned long long)sb.st_size
+	  || mtime != (long long)sb.st_mtime)
+	    goto done;
+
+      while (fgets(line, sizeof line, fd)) {
+	    line[strcspn(line, "\n")] = 0;
+	    if (sscanf(line, "L %lx %n", &key, &pos) == 1) {
+		  if (key != dir_hash(line+pos))
+			goto done;
+		  continue;
+	    }
+	    if (sscanf(line, "D %llu %lld %n", &size, &mtime, &pos) != 2)
+		  goto done;
+	    if (stat(line+pos, &sb) != 0
+		|| size != (unsigned long long)sb.st_size
+		|| mtime != (long long)sb.st_mtime)
+		  goto done;
+      }
+
+      rc = 1;
+
+ done:
+      fclose(fd);
+      return rc;
+}
+
+static void write_dep(FILE*fd, const char*path)
+{
+      struct stat sb;
+      if (stat(path, &sb) != 0)
+	    return;
+      fprintf(fd, "D %llu %lld %s\n", (unsigned long long)sb.st_size,
+	      (long long)sb.st_mtime, path);
+}
+
+/*
+ * Write the stamp for the output that was just made. The files are
+ * the extra files that were added, and the files listed in the
+ * dependency file that the preprocessor and the compiler wrote. In
+ * the prefix mode, the paths in that file have a type prefix.
+ *
+ * The stamp is written under a temporary name and then renamed, so
+ * that a compile that is interrupted, or one that runs at the same
+ * time, never leaves a partial stamp behind.
+ */
+void stamp_write(const char*out_path, const char*dep_path, char dep_mode)
+{
+      char line[4096];
+      struct stat sb;
+      unsigned idx;
+      int rc;
+      char*path = stamp_path(out_path);
+      char*tpath;
+      FILE*fd;
+      FILE*deps;
+
+      if (stat(out_path, &sb) != 0) {
+	    free(path);
+	    return;
+      }
+
+      tpath = malloc(strlen(path) + 32);
+      sprintf(tpath, "%s.%ld.tmp", path, (long)getpid());
+
+      fd = fopen(tpath, "w");
+      if (fd == 0) {
+	    fprintf(stderr, "warning: Unable to write %s\n", path);
+	    free(tpath);
+	    free(path);
+	    return;
+      }
+
+      fprintf(fd, "iverilog-stamp 2\n");
+      fprintf(fd, "K %lx\n", stamp_key_value);
+      fprintf(fd, "O %llu %lld\n", (unsigned long long)sb.st_size,
+	      (long long)sb.st_mtime);
+
+      for (idx = 0 ;  idx < extra_cnt ;  idx += 1)
+	    write_dep(fd, extra_files[idx]);
+
+      for (idx = 0 ;  idx < search_cnt ;  idx += 1)
+	    fprintf(fd, "L %lx %s\n", dir_hash(search_dirs[idx]),
+		    search_dirs[idx]);
+
+      deps = fopen(dep_path, "r");
+      if (deps) {
+	    while (fgets(line, sizeof line, deps)) {
+		  char*cp = line;
+		  line[strcspn(line, "\n")] = 0;
+		  if (dep_mode == 'p' && cp[0] && cp[1] == ' ')
+			cp += 2;
+		  if (*cp)
+			write_dep(fd, cp);
+	    }
+	    fclose(deps);
+      }
+
+      rc = fclose(fd);
+	/* rename does not replace an existing file on Windows. */
+      if (rc == 0 && rename(tpath, path) != 0) {
+	    remove(path);
+	    rc = rename(tpath, path);
+      }
+      if (rc != 0) {
+	    fprintf(stderr, "warning: Unable to write %s\n", path);
+	    remove(tpath);
+      }
+      free(tpath);
+      free(path);
+}
+
+void stamp_cleanup(void)
+{
+      unsigned idx;
+      for (idx = 0 ;  idx < extra_cnt ;  idx += 1)
+	    free(extra_files[idx]);
+      free(extra_files);
+      extra_files = 0;
+      extra_cnt = 0;
+      for (idx = 0 ;  idx < search_cnt ;  idx += 1)
+	    free(search_dirs[idx]);
+      free(search_dirs);
+      search_dirs = 0;
+      search_cnt = 0;
+}
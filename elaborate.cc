@@ -30,6 +30,7 @@
 # include  <cstdlib>
 # include  <sstream>
 # include  <list>
+# include  <ctime>
 # include  "pform.h"
 # include  "PEvent.h"
 # include  "PGenerate.h"
@@ -4771,6 +4772,14 @@ bool Design::check_proc_delay() const
       return result_flag;
 }
 
+/*
+ * This is in main.cc. It prints, for the verbose output, the time
+ * that the phase just finished took. The phases run one after the
+ * other over the whole design, so this shows which one a large
+ * design spends its time in.
+ */
+extern void elaborate_phase_done(const char*name);
+
 /*
  * This function is the root of all elaboration. The input is the list
  * of root module names. The function locates the Module definitions
@@ -4870,6 +4879,7 @@ Design* elaborate(list<perm_string>roots)
 	// Look for residual defparams (that point to a non-existent
 	// scope) and clean them out.
       des->residual_defparams();
+      elaborate_phase_done("scopes and parameters");
 
 	// Errors already? Probably missing root modules. Just give up
 	// now and return nothing.
@@ -4900,6 +4910,7 @@ Design* elaborate(list<perm_string>roots)
 		  }
 	    }
       }
+      elaborate_phase_done("signals");
 
 	// Now that the structure and parameters are taken care of,
 	// run through the pform again and generate the full netlist.
@@ -4910,6 +4921,9 @@ Design* elaborate(list<perm_string>roots)
 	    rc &= rmod->elaborate(des, scope);
 	    delete root_elems[i];
       }
+      elaborate_phase_done("netlist");
+      if (verbose_flag && rc)
+	    des->report_parameterizations(cerr);
 
       if (rc == false) {
 	    delete des;
@@ -21,14 +21,62 @@
 
 # include  <stdio.h>
 
+/*
+ * The preprocessor is also compiled into ivl (see library.c). The
+ * names that it exports are then given a prefix so that they do not
+ * clash with the names in the compiler.
+ */
+#ifdef IVLPP_LIBRARY
+# define reset_lexor              ivlpp_reset_lexor
+# define destroy_lexor            ivlpp_destroy_lexor
+# define abort_lexor              ivlpp_abort_lexor
+# define save_macros              ivlpp_save_macros
+# define restore_macros           ivlpp_restore_macros
+# define load_precompiled_defines ivlpp_load_precompiled_defines
+# define define_macro             ivlpp_define_macro
+# define free_macros              ivlpp_free_macros
+# define dump_precompiled_defines ivlpp_dump_precompiled_defines
+# define setup_defaults           ivlpp_setup_defaults
+# define read_flags_file          ivlpp_read_flags_file
+# define free_setup               ivlpp_free_setup
+# define include_dir              ivlpp_include_dir
+# define include_cnt              ivlpp_include_cnt
+# define vhdlpp_path              ivlpp_vhdlpp_path
+# define vhdlpp_work              ivlpp_vhdlpp_work
+# define vhdlpp_libdir            ivlpp_vhdlpp_libdir
+# define vhdlpp_libdir_cnt        ivlpp_vhdlpp_libdir_cnt
+# define relative_include         ivlpp_relative_include
+# define line_direct_flag         ivlpp_line_direct_flag
+# define error_count              ivlpp_error_count
+# define depend_file              ivlpp_depend_file
+# define include_miss_file        ivlpp_include_miss_file
+# define dep_path                 ivlpp_dep_path
+# define dep_mode                 ivlpp_dep_mode
+# define verbose_flag             ivlpp_verbose_flag
+# define yylex                    ivlpp_yylex
+
+# include  <setjmp.h>
+/* The lexor jumps here on an error that it cannot go on from. */
+extern jmp_buf ivlpp_fatal_env;
+#endif
+
 extern void reset_lexor(FILE*out, char*paths[]);
 extern void destroy_lexor();
+extern void abort_lexor();
 extern void load_precompiled_defines(FILE*src);
 extern void define_macro(const char*name, const char*value, int keyword,
                          int argc);
 extern void free_macros();
+extern void save_macros();
+extern void restore_macros();
 extern void dump_precompiled_defines(FILE*out);
 
+/* Set up the builtin keyword macros and the include path, read a -F
+   flags file, and free what these set up. */
+extern void setup_defaults(void);
+extern int  read_flags_file(const char*path);
+extern void free_setup(void);
+
 /* These variables contain the include directories to be searched when
    an include directive in encountered. */
 extern char**include_dir;
@@ -49,6 +97,10 @@ extern int line_direct_flag;
 extern unsigned error_count;
 
 extern FILE *depend_file;
+/* If this is set, the include search writes into it each path that
+   it tried and did not find, one per line. */
+extern FILE *include_miss_file;
+extern char *dep_path;
 extern char dep_mode;
 
 extern int verbose_flag;
@@ -0,0 +1,65 @@
+#ifndef __ivlpp_H
+#define __ivlpp_H
+/*
+ * Copyright (c) 2012 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+# include  <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * This is the interface to the preprocessor when it is linked into
+ * ivl to preprocess library module files.
+ *
+ * ivlpp_library_open takes the ivlpp command line that would be used
+ * to preprocess a library file, without the file name, and sets up
+ * the preprocessor from its flags. It returns 0 if the command line
+ * has flags that the library does not support, in which case the
+ * caller should run the command instead.
+ *
+ * ivlpp_library_file preprocesses a file into a temporary file, and
+ * returns it through res ready for reading. Each file starts with the
+ * macros that were defined when the library was opened, as it would
+ * in its own run of ivlpp. The caller closes the returned file. The
+ * result is 0 if the file was preprocessed, the number of errors if
+ * preprocessing failed (the errors are already printed), or -1 if
+ * the library cannot be used and the caller should run the command.
+ *
+ * ivlpp_library_cache sets a directory where the preprocessed text
+ * of library files is kept from one run to the next. A file that is
+ * unchanged, and is preprocessed with the same include path and
+ * macros, is then read from the cache. ivlpp_library_cache_stats
+ * returns how many files were found in the cache and how many were
+ * not.
+ *
+ * ivlpp_library_close releases everything that the preprocessor holds.
+ */
+extern int   ivlpp_library_open(const char*cmdline);
+extern int   ivlpp_library_file(const char*path, FILE**res);
+extern void  ivlpp_library_cache(const char*dir);
+extern void  ivlpp_library_cache_stats(unsigned*hits, unsigned*misses);
+extern void  ivlpp_library_close(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,598 @@
+/*
+ * Copyright (c) 2012 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+# include  "config.h"
+
+# include  <stdio.h>
+# include  <stdlib.h>
+# include  <string.h>
+# include  <stdint.h>
+# include  <inttypes.h>
+# include  <sys/types.h>
+# include  <sys/stat.h>
+# include  <fcntl.h>
+#ifdef __MINGW32__
+# include  <io.h>
+# include  <process.h>
+#else
+# include  <unistd.h>
+#endif
+# include  "globals.h"
+# include  "ivlpp.h"
+# include  "ivl_alloc.h"
+
+static int library_open = 0;
+
+jmp_buf ivlpp_fatal_env;
+
+static char*cache_dir = 0;
+static uint64_t state_hash = 0;
+static int state_hashed = 0;
+static unsigned cache_hits = 0;
+static unsigned cache_misses = 0;
+
+/*
+ * Get the next word from the command line. A word is ended by white
+ * space that is not in double quotes, and the quotes are removed.
+ */
+static char* next_word(const char**cp)
+{
+      const char*src = *cp;
+      char*word, *dst;
+      int quoted = 0;
+
+      src += strspn(src, " \t");
+      if (*src == 0) {
+	    *cp = src;
+	    return 0;
+      }
+
+      word = malloc(strlen(src) + 1);
+      dst = word;
+      while (*src && (quoted || (*src != ' ' && *src != '\t'))) {
+	    if (*src == '"')
+		  quoted = !quoted;
+	    else
+		  *dst++ = *src;
+	    src += 1;
+      }
+      *dst = 0;
+
+      *cp = src;
+      return word;
+}
+
+int ivlpp_library_open(const char*cmdline)
+{
+      const char*cp = cmdline;
+      char*word;
+      int rc = 1;
+
+      if (library_open)
+	    return 1;
+
+      setup_defaults();
+
+	/* The first word is the program. */
+      word = next_word(&cp);
+      free(word);
+
+      while (rc && (word = next_word(&cp))) {
+	    if (strcmp(word, "-L") == 0) {
+		  line_direct_flag = 1;
+
+	    } else if (strcmp(word, "-v") == 0) {
+		  verbose_flag = 1;
+
+	    } else if (strncmp(word, "-F", 2) == 0 && word[2]) {
+		  if (read_flags_file(word+2) != 0)
+			rc = 0;
+
+	    } else if (strncmp(word, "-K", 2) == 0 && word[2]) {
+		  char*buf = malloc(strlen(word+2) + 2);
+		  buf[0] = '`';
+		  strcpy(buf+1, word+2);
+		  define_macro(word+2, buf, 1, 0);
+		  free(buf);
+
+	    } else if (strncmp(word, "-P", 2) == 0 && word[2]) {
+		  FILE*src = fopen(word+2, "rb");
+		  if (src == 0) {
+			rc = 0;
+		  } else {
+			load_precompiled_defines(src);
+			fclose(src);
+		  }
+
+	    } else {
+		  rc = 0;
+	    }
+	    free(word);
+      }
+
+      if (rc == 0) {
+	    free_macros();
+	    free_setup();
+	    return 0;
+      }
+
+      if (dep_path) {
+	    depend_file = fopen(dep_path, "a");
+	    if (depend_file == 0) {
+		  perror(dep_path);
+		  free_macros();
+		  free_setup();
+		  return 0;
+	    }
+      }
+
+      if (vhdlpp_work == 0) {
+	    vhdlpp_work = strdup("ivl_vhdl_work");
+      }
+
+	/* Each library file starts with the macros that are defined
+	   now. */
+      save_macros();
+
+      library_open = 1;
+      return 1;
+}
+
+/*
+ * The cache holds the preprocessed text of library files, so that a
+ * later run of the compiler that preprocesses the same file the same
+ * way can read the text instead. An entry is found by a hash of the
+ * file path and of everything that changes the output: the contents
+ * of the file, the include path and the macros defined when the file
+ * is started. Every library file starts with the same macros, so a
+ * file that is read from the cache does not need its `define lines
+ * to be run. The entry is a text header followed by the output:
+ *
+ *    ivlpp-cache 2
+ *    S <size> <mtime> <content hash> <path>
+ *    I <size> <mtime> <path>           (one for each included file)
+ *    N <path>                          (one for each include search miss)
+ *    T <text size> <text hash>
+ *    <preprocessed text>
+ *
+ * The N lines are the paths that the include search tried, and did
+ * not find, before it found an included file. If one of them exists
+ * later, the search would find a different file.
+ *
+ * The header is checked again when the entry is used, so that a hash
+ * collision, a changed include file or a new file earlier on the
+ * include path only costs a miss. The size and hash of the text are
+ * checked too, so that a damaged entry is never used.
+ */
+# define CACHE_MAGIC "ivlpp-cache 2\n"
+
+static uint64_t hash_bytes(uint64_t hash, const void*data, size_t len)
+{
+      const unsigned char*cp = (const unsigned char*)data;
+      while (len > 0) {
+	    hash ^= *cp++;
+	    hash *= 0x100000001b3ULL;
+	    len -= 1;
+      }
+      return hash;
+}
+
+static uint64_t hash_string(uint64_t hash, const char*str)
+{
+	/* Include the terminating nul so that adjacent strings do not
+	   run together. */
+      return hash_bytes(hash, str? str : "", str? strlen(str)+1 : 1);
+}
+
+static uint64_t hash_stream(uint64_t hash, FILE*fd)
+{
+      char buf[8192];
+      size_t cnt;
+      while ((cnt = fread(buf, 1, sizeof buf, fd)) > 0)
+	    hash = hash_bytes(hash, buf, cnt);
+      return hash;
+}
+
+/*
+ * Hash the settings that change how a file is preprocessed: the
+ * include path, and the macros that are defined at this point. The
+ * builtin keyword macros are fixed once the library is open, and are
+ * left out of the dump.
+ */
+static uint64_t hash_state(uint64_t hash)
+{
+      unsigned idx;
+      FILE*tmp;
+
+      for (idx = 1 ;  idx < include_cnt ;  idx += 1)
+	    hash = hash_string(hash, include_dir[idx]);
+      hash = hash_bytes(hash, &relative_include, sizeof relative_include);
+      hash = hash_bytes(hash, &line_direct_flag, sizeof line_direct_flag);
+
+      tmp = tmpfile();
+      if (tmp) {
+	    dump_precompiled_defines(tmp);
+	    rewind(tmp);
+	    hash = hash_stream(hash, tmp);
+	    fclose(tmp);
+      }
+
+      return hash;
+}
+
+static char* cache_path(uint64_t key, const char*suffix)
+{
+      char*res = malloc(strlen(cache_dir) + strlen(suffix) + 20);
+      sprintf(res, "%s/%016" PRIx64 "%s", cache_dir, key, suffix);
+      return res;
+}
+
+/*
+ * Create a new temporary file in the cache directory for the entry
+ * with the given key. The name holds the process id and a counter and
+ * the file is created exclusively, so compilers that store the same
+ * entry at the same time each write their own file.
+ */
+static FILE* cache_temp(uint64_t key, char**tpath)
+{
+      static unsigned counter = 0;
+      char suffix[64];
+      FILE*file = 0;
+      int fd;
+
+      sprintf(suffix, ".%ld.%u.tmp", (long)getpid(), counter++);
+      *tpath = cache_path(key, suffix);
+
+#ifdef __MINGW32__
+      fd = _open(*tpath, _O_WRONLY|_O_CREAT|_O_EXCL|_O_BINARY, 0600);
+      if (fd != -1)
+	    file = _fdopen(fd, "wb");
+#else
+      fd = open(*tpath, O_WRONLY|O_CREAT|O_EXCL, 0600);
+      if (fd != -1)
+	    file = fdopen(fd, "wb");
+#endif
+
+      return file;
+}
+
+/*
+ * Return the size and hash of the rest of the stream.
+ */
+static uint64_t hash_text(FILE*fd, unsigned long long*size)
+{
+      char buf[8192];
+      size_t cnt;
+      uint64_t hash = 0xcbf29ce484222325ULL;
+
+      *size = 0;
+      while ((cnt = fread(buf, 1, sizeof buf, fd)) > 0) {
+	    hash = hash_bytes(hash, buf, cnt);
+	    *size += cnt;
+      }
+      return hash;
+}
+
+static void emit_include_dep(const char*path)
+{
+      if (depend_file == 0)
+	    return;
+      if (dep_mode == 'p')
+	    fprintf(depend_file, "I %s\n", path);
+      else if (dep_mode != 'm')
+	    fprintf(depend_file, "%s\n", path);
+}
+
+/*
+ * Read the header of a cache entry, and return the entry positioned
+ * at the preprocessed text if the header matches the file, all the
+ * included files are unchanged and none of the include search misses
+ * exist, and the text is whole. The included files of a matching
+ * entry are written to the dependency file, as they would be if the
+ * file were preprocessed.
+ */
+static FILE* cache_lookup(const char*cpath, const char*path,
+			  const struct stat*sb, uint64_t content)
+{
+      char line[4096];
+      unsigned long long size, text_size;
+      long long mtime;
+      uint64_t hash, text_hash;
+      long text_pos;
+      int pos;
+      char**incs = 0;
+      unsigned ninc = 0, idx;
+      FILE*fd = fopen(cpath, "rb");
+
+      if (fd == 0)
+	    return 0;
+
+      if (fgets(line, sizeof line, fd) == 0 || strcmp(line, CACHE_MAGIC) != 0)
+	    goto no_match;
+
+      if (fgets(line, sizeof line, fd) == 0)
+	    goto no_match;
+      line[strcspn(line, "\n")] = 0;
+      if (sscanf(line, "S %llu %lld %" SCNx64 " %n",
+		 &size, &mtime, &hash, &pos) != 3)
+	    goto no_match;
+      if (size != (unsigned long long)sb->st_size
+	  || mtime != (long long)sb->st_mtime
+	  || hash != content
+	  || strcmp(line+pos, path) != 0)
+	    goto no_match;
+
+      while (fgets(line, sizeof line, fd)) {
+	    struct stat isb;
+
+	    if (sscanf(line, "T %llu %" SCNx64, &size, &hash) == 2) {
+		  text_pos = ftell(fd);
+		  if (text_pos < 0)
+			break;
+		  text_hash = hash_text(fd, &text_size);
+		  if (text_size != size || text_hash != hash
+		      || fseek(fd, text_pos, SEEK_SET) != 0)
+			break;
+
+		  for (idx = 0 ;  idx < ninc ;  idx += 1) {
+			emit_include_dep(incs[idx]);
+			free(incs[idx]);
+		  }
+		  free(incs);
+		  if (depend_file) fflush(depend_file);
+		  return fd;
+	    }
+
+	    line[strcspn(line, "\n")] = 0;
+	    if (strncmp(line, "N ", 2) == 0) {
+		  if (stat(line+2, &isb) == 0)
+			break;
+		  continue;
+	    }
+
+	    if (sscanf(line, "I %llu %lld %n", &size, &mtime, &pos) != 2)
+		  break;
+	    if (stat(line+pos, &isb) != 0
+		|| size != (unsigned long long)isb.st_size
+		|| mtime != (long long)isb.st_mtime)
+		  break;
+
+	    incs = realloc(incs, (ninc+1) * sizeof(char*));
+	    incs[ninc++] = strdup(line+pos);
+      }
+
+  no_match:
+      for (idx = 0 ;  idx < ninc ;  idx += 1)
+	    free(incs[idx]);
+      free(incs);
+      fclose(fd);
+      return 0;
+}
+
+/*
+ * Write the cache entry for a file that has just been preprocessed
+ * into text. The entry is written into a temporary file of its own
+ * and then renamed, so that compilers that run at the same time
+ * never see a partial entry.
+ */
+static void cache_store(uint64_t key, const char*path, const struct stat*sb,
+			uint64_t content, FILE*deps, FILE*misses, FILE*text)
+{
+      char line[4096];
+      char buf[8192];
+      size_t cnt;
+      unsigned long long text_size;
+      uint64_t text_hash;
+      char*cpath = cache_path(key, ".ipp");
+      char*tpath;
+      FILE*fd = cache_temp(key, &tpath);
+
+      if (fd == 0) {
+	    free(cpath);
+	    free(tpath);
+	    return;
+      }
+
+      fputs(CACHE_MAGIC, fd);
+      fprintf(fd, "S %llu %lld %016" PRIx64 " %s\n",
+	      (unsigned long long)sb->st_size, (long long)sb->st_mtime,
+	      content, path);
+
+      rewind(deps);
+      while (fgets(line, sizeof line, deps)) {
+	    struct stat isb;
+	    line[strcspn(line, "\n")] = 0;
+	    if (stat(line, &isb) != 0)
+		  continue;
+	    fprintf(fd, "I %llu %lld %s\n", (unsigned long long)isb.st_size,
+		    (long long)isb.st_mtime, line);
+      }
+
+      rewind(misses);
+      while (fgets(line, sizeof line, misses))
+	    fprintf(fd, "N %s", line);
+
+      rewind(text);
+      text_hash = hash_text(text, &text_size);
+      fprintf(fd, "T %llu %016" PRIx64 "\n", text_size, text_hash);
+
+      rewind(text);
+      while ((cnt = fread(buf, 1, sizeof buf, text)) > 0)
+	    fwrite(buf, 1, cnt, fd);
+
+      if (fclose(fd) == 0 && rename(tpath, cpath) == 0) {
+	    free(cpath);
+	    free(tpath);
+	    return;
+      }
+
+      remove(tpath);
+      free(cpath);
+      free(tpath);
+}
+
+void ivlpp_library_cache(const char*dir)
+{
+      free(cache_dir);
+      cache_dir = dir? strdup(dir) : 0;
+}
+
+void ivlpp_library_cache_stats(unsigned*hits, unsigned*misses)
+{
+      *hits = cache_hits;
+      *misses = cache_misses;
+}
+
+int ivlpp_library_file(const char*path, FILE**res)
+{
+      char*paths[2];
+      char line[4096];
+      FILE*out;
+      FILE*deps = 0;
+      FILE*misses = 0;
+      FILE*save_depend = depend_file;
+      char save_mode = dep_mode;
+      unsigned save_errors = error_count;
+      struct stat sb;
+      uint64_t key = 0, content = 0;
+      int use_cache = 0;
+
+      *res = 0;
+      if (! library_open)
+	    return -1;
+
+      restore_macros();
+
+      if (cache_dir && stat(path, &sb) == 0) {
+	    FILE*src = fopen(path, "rb");
+	    if (src) {
+		  FILE*hit;
+		  char*cpath;
+
+		  if (! state_hashed) {
+			state_hash = hash_state(0xcbf29ce484222325ULL);
+			state_hashed = 1;
+		  }
+
+		  content = hash_stream(0xcbf29ce484222325ULL, src);
+		  fclose(src);
+		  key = hash_string(content ^ state_hash, path);
+
+		  cpath = cache_path(key, ".ipp");
+		  hit = cache_lookup(cpath, path, &sb, content);
+		  free(cpath);
+		  if (hit) {
+			cache_hits += 1;
+			*res = hit;
+			return 0;
+		  }
+
+		  cache_misses += 1;
+		  use_cache = 1;
+	    }
+      }
+
+      out = tmpfile();
+      if (out == 0)
+	    return -1;
+
+	/* Collect the included files, for the cache entry and for the
+	   dependency file. The library file itself is written to the
+	   dependency file by ivl. */
+      if (use_cache || depend_file) {
+	    deps = tmpfile();
+	    if (deps == 0)
+		  use_cache = 0;
+      }
+      if (use_cache) {
+	    misses = tmpfile();
+	    if (misses == 0)
+		  use_cache = 0;
+      }
+
+      paths[0] = strdup(path);
+      paths[1] = 0;
+
+      depend_file = deps;
+      dep_mode = 'i';
+      include_miss_file = misses;
+
+      if (setjmp(ivlpp_fatal_env) == 0) {
+	    reset_lexor(out, paths);
+	    if (yylex() != 0)
+		  error_count += 1;
+	      /* This resets the scanner so that the next file starts
+		 with a `line directive. */
+	    destroy_lexor();
+      } else {
+	    abort_lexor();
+	    error_count += 1;
+      }
+
+      free(paths[0]);
+
+      depend_file = save_depend;
+      dep_mode = save_mode;
+      include_miss_file = 0;
+
+      if (deps) {
+	    rewind(deps);
+	    while (fgets(line, sizeof line, deps)) {
+		  line[strcspn(line, "\n")] = 0;
+		  emit_include_dep(line);
+	    }
+	    if (depend_file) fflush(depend_file);
+      }
+
+      if (error_count != save_errors) {
+	    if (deps) fclose(deps);
+	    if (misses) fclose(misses);
+	    fclose(out);
+	    return error_count - save_errors;
+      }
+
+      if (use_cache) {
+	    fflush(out);
+	    cache_store(key, path, &sb, content, deps, misses, out);
+      }
+      if (deps) fclose(deps);
+      if (misses) fclose(misses);
+
+      rewind(out);
+      *res = out;
+      return 0;
+}
+
+void ivlpp_library_close(void)
+{
+      if (! library_open)
+	    return;
+
+      if (depend_file) {
+	    fclose(depend_file);
+	    depend_file = 0;
+      }
+
+      free_macros();
+      free_setup();
+      free(cache_dir);
+      cache_dir = 0;
+      state_hashed = 0;
+      library_open = 0;
+}
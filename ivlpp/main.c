@@ -53,19 +53,7 @@ extern int getopt(int argc, char*argv[], const char*fmt);
 extern int optind;
 extern const char*optarg;
 #endif
-/* Path to the dependency file, if there is one. */
-char *dep_path = NULL;
-/* Dependency file output mode */
-char dep_mode = 'a';
-/* verbose flag */
-int verbose_flag = 0;
-/* Path to vhdlpp */
-char *vhdlpp_path = 0;
-/* vhdlpp work directory */
-char *vhdlpp_work = 0;
-
-char**vhdlpp_libdir = 0;
-unsigned vhdlpp_libdir_cnt = 0;
+
 /*
  * Keep in source_list an array of pointers to file names. The array
  * is terminated by a pointer to null.
@@ -88,120 +76,6 @@ void add_source_file(const char*name)
       }
 }
 
-char**include_dir = 0;
-unsigned include_cnt = 0;
-
-int relative_include = 0;
-
-int line_direct_flag = 0;
-
-unsigned error_count = 0;
-FILE *depend_file = NULL;
-
-static int flist_read_flags(const char*path)
-{
-      char line_buf[2048];
-      FILE*fd = fopen(path, "r");
-      if (fd == 0) {
-	    fprintf(stderr, "%s: unable to open for reading.\n", path);
-	    return -1;
-      }
-
-      while (fgets(line_buf, sizeof line_buf, fd) != 0) {
-	      /* Skip leading white space. */
-	    char*cp = line_buf + strspn(line_buf, " \t\r\b\f");
-	      /* Remove trailing white space. */
-	    char*tail = cp + strlen(cp);
-	    char*arg;
-
-	    while (tail > cp) {
-		  if (! isspace((int)tail[-1]))
-			break;
-		  tail -= 1;
-		  tail[0] = 0;
-	    }
-
-	      /* Skip empty lines */
-	    if (*cp == 0)
-		  continue;
-	      /* Skip comment lines */
-	    if (cp[0] == '#')
-		  continue;
-
-	      /* The arg points to the argument to the keyword. */
-	    arg = strchr(cp, ':');
-	    if (arg) *arg++ = 0;
-
-	    if (strcmp(cp,"D") == 0) {
-		  char*val = strchr(arg, '=');
-		  const char *valo = "1";
-		  if (val) {
-			*val++ = 0;
-			valo = val;
-		  }
-
-		  define_macro(arg, valo, 0, 0);
-
-	    } else if (strcmp(cp,"I") == 0) {
-		  include_dir = realloc(include_dir,
-					(include_cnt+1)*sizeof(char*));
-		  include_dir[include_cnt] = strdup(arg);
-		  include_cnt += 1;
-
-	    } else if (strcmp(cp,"keyword") == 0) {
-		  char*buf = malloc(strlen(arg) + 2);
-		  buf[0] = '`';
-		  strcpy(buf+1, optarg);
-		  define_macro(optarg, buf, 1, 0);
-		  free(buf);
-
-	    } else if ((strcmp(cp,"Ma") == 0)
-                   ||  (strcmp(cp,"Mi") == 0)
-                   ||  (strcmp(cp,"Mm") == 0)
-                   ||  (strcmp(cp,"Mp") == 0)) {
-		  if (dep_path) {
-			fprintf(stderr, "duplicate -M flag.\n");
-                  } else {
-                        dep_mode = cp[1];
-			dep_path = strdup(arg);
-		  }
-
-	    } else if (strcmp(cp,"relative include") == 0) {
-		  if (strcmp(arg, "true") == 0) {
-			relative_include = 1;
-		  } else {
-			relative_include = 0;
-		  }
-
-	    } else if (strcmp(cp,"vhdlpp") == 0) {
-		  if (vhdlpp_path) {
-			fprintf(stderr, "Ignore multiple vhdlpp flags\n");
-		  } else {
-			vhdlpp_path = strdup(arg);
-		  }
-
-	    } else if (strcmp(cp,"vhdlpp-work") == 0) {
-		  if (vhdlpp_work) {
-			fprintf(stderr, "Ignore duplicate vhdlpp-work flags\n");
-		  } else {
-			vhdlpp_work = strdup(arg);
-		  }
-
-	    } else if (strcmp(cp,"vhdlpp-libdir") == 0) {
-		  vhdlpp_libdir = realloc(vhdlpp_libdir,
-					  (vhdlpp_libdir_cnt+1)*sizeof(char*));
-		  vhdlpp_libdir[vhdlpp_libdir_cnt] = strdup(arg);
-		  vhdlpp_libdir_cnt += 1;
-
-	    } else {
-		  fprintf(stderr, "%s: Invalid keyword %s\n", path, cp);
-	    }
-      }
-
-      fclose(fd);
-      return 0;
-}
-
 /*
  * This function reads from a file a list of file names. Each name
  * starts with the first non-space character, and ends with the last
@@ -246,46 +120,12 @@ int main(int argc, char*argv[])
       char*precomp_out_path = 0;
       FILE*precomp_out = NULL;
 
-	/* Define preprocessor keywords that I plan to just pass. */
-	/* From 1364-2005 Chapter 19. */
-      define_macro("begin_keywords",          "`begin_keywords", 1, 0);
-      define_macro("celldefine",              "`celldefine", 1, 0);
-      define_macro("default_nettype",         "`default_nettype", 1, 0);
-      define_macro("end_keywords",            "`end_keywords", 1, 0);
-      define_macro("endcelldefine",           "`endcelldefine", 1, 0);
-      define_macro("line",                    "`line", 1, 0);
-      define_macro("nounconnected_drive",     "`nounconnected_drive", 1, 0);
-      define_macro("pragma",                  "`pragma", 1, 0);
-      define_macro("resetall",                "`resetall", 1, 0);
-      define_macro("timescale",               "`timescale", 1, 0);
-      define_macro("unconnected_drive",       "`unconnected_drive", 1, 0);
-
-	/* From 1364-2005 Annex D. */
-      define_macro("default_decay_time",      "`default_decay_time", 1, 0);
-      define_macro("default_trireg_strength", "`default_trireg_strength", 1, 0);
-      define_macro("delay_mode_distributed",  "`delay_mode_distributed", 1, 0);
-      define_macro("delay_mode_path",         "`delay_mode_path", 1, 0);
-      define_macro("delay_mode_unit",         "`delay_mode_unit", 1, 0);
-      define_macro("delay_mode_zero",         "`delay_mode_zero", 1, 0);
-
-	/* From other places. */
-      define_macro("disable_portfaults",      "`disable_portfaults", 1, 0);
-      define_macro("enable_portfaults",       "`enable_portfaults", 1, 0);
-      define_macro("endprotect",              "`endprotect", 1, 0);
-      define_macro("nosuppress_faults",       "`nosuppress_faults", 1, 0);
-      define_macro("protect",                 "`protect", 1, 0);
-      define_macro("suppress_faults",         "`suppress_faults", 1, 0);
-      define_macro("uselib",                  "`uselib", 1, 0);
-
-      include_cnt = 2;
-      include_dir = malloc(include_cnt*sizeof(char*));
-      include_dir[0] = 0;  /* 0 is reserved for the current files path. */
-      include_dir[1] = strdup(".");
+      setup_defaults();
 
       while ((opt=getopt(argc, argv, "F:f:K:Lo:p:P:vV")) != EOF) switch (opt) {
 
 	  case 'F':
-	    flist_read_flags(optarg);
+	    read_flags_file(optarg);
 	    break;
 
 	  case 'f':
@@ -447,24 +287,13 @@ int main(int argc, char*argv[])
 
       if (out_path) fclose(out);
 
-	/* Free the source and include directory lists. */
+	/* Free the source list. */
       for (lp = 0; lp < source_cnt; lp += 1) {
 	    free(source_list[lp]);
       }
       free(source_list);
-      for (lp = 0; lp < include_cnt; lp += 1) {
-	    free(include_dir[lp]);
-      }
-      free(include_dir);
-
-	/* Free the VHDL library directories, the path and work directory. */
-      for (lp = 0; lp < vhdlpp_libdir_cnt; lp += 1) {
-	    free(vhdlpp_libdir[lp]);
-      }
-      free(vhdlpp_libdir);
-      free(vhdlpp_path);
-      free(vhdlpp_work);
 
+      free_setup();
       free_macros();
 
       return error_count;
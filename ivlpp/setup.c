@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 1999-2012 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+# include  "config.h"
+
+/*
+ * The settings of the preprocessor, and the functions that set them
+ * up from the flags. These are used by the ivlpp program, and by the
+ * preprocessor library that is linked into ivl.
+ */
+
+# include  <stdio.h>
+# include  <stdlib.h>
+# include  <string.h>
+# include  <ctype.h>
+# include  "globals.h"
+# include  "ivl_alloc.h"
+
+/* Path to the dependency file, if there is one. */
+char *dep_path = NULL;
+/* Dependency file output mode */
+char dep_mode = 'a';
+/* verbose flag */
+int verbose_flag = 0;
+/* Path to vhdlpp */
+char *vhdlpp_path = 0;
+/* vhdlpp work directory */
+char *vhdlpp_work = 0;
+
+char**vhdlpp_libdir = 0;
+unsigned vhdlpp_libdir_cnt = 0;
+
+char**include_dir = 0;
+unsigned include_cnt = 0;
+
+int relative_include = 0;
+
+int line_direct_flag = 0;
+
+unsigned error_count = 0;
+FILE *depend_file = NULL;
+FILE *include_miss_file = NULL;
+
+void setup_defaults(void)
+{
+	/* Define preprocessor keywords that I plan to just pass. */
+	/* From 1364-2005 Chapter 19. */
+      define_macro("begin_keywords",          "`begin_keywords", 1, 0);
+      define_macro("celldefine",              "`celldefine", 1, 0);
+      define_macro("default_nettype",         "`default_nettype", 1, 0);
+      define_macro("end_keywords",            "`end_keywords", 1, 0);
+      define_macro("endcelldefine",           "`endcelldefine", 1, 0);
+      define_macro("line",                    "`line", 1, 0);
+      define_macro("nounconnected_drive",     "`nounconnected_drive", 1, 0);
+      define_macro("pragma",                  "`pragma", 1, 0);
+      define_macro("resetall",                "`resetall", 1, 0);
+      define_macro("timescale",               "`timescale", 1, 0);
+      define_macro("unconnected_drive",       "`unconnected_drive", 1, 0);
+
+	/* From 1364-2005 Annex D. */
+      define_macro("default_decay_time",      "`default_decay_time", 1, 0);
+      define_macro("default_trireg_strength", "`default_trireg_strength", 1, 0);
+      define_macro("delay_mode_distributed",  "`delay_mode_distributed", 1, 0);
+      define_macro("delay_mode_path",         "`delay_mode_path", 1, 0);
+      define_macro("delay_mode_unit",         "`delay_mode_unit", 1, 0);
+      define_macro("delay_mode_zero",         "`delay_mode_zero", 1, 0);
+
+	/* From other places. */
+      define_macro("disable_portfaults",      "`disable_portfaults", 1, 0);
+      define_macro("enable_portfaults",       "`enable_portfaults", 1, 0);
+      define_macro("endprotect",              "`endprotect", 1, 0);
+      define_macro("nosuppress_faults",       "`nosuppress_faults", 1, 0);
+      define_macro("protect",                 "`protect", 1, 0);
+      define_macro("suppress_faults",         "`suppress_faults", 1, 0);
+      define_macro("uselib",                  "`uselib", 1, 0);
+
+      include_cnt = 2;
+      include_dir = malloc(include_cnt*sizeof(char*));
+      include_dir[0] = 0;  /* 0 is reserved for the current files path. */
+      include_dir[1] = strdup(".");
+}
+
+int read_flags_file(const char*path)
+{
+      char line_buf[2048];
+      FILE*fd = fopen(path, "r");
+      if (fd == 0) {
+	    fprintf(stderr, "%s: unable to open for reading.\n", path);
+	    return -1;
+      }
+
+      while (fgets(line_buf, sizeof line_buf, fd) != 0) {
+	      /* Skip leading white space. */
+	    char*cp = line_buf + strspn(line_buf, " \t\r\b\f");
+	      /* Remove trailing white space. */
+	    char*tail = cp + strlen(cp);
+	    char*arg;
+
+	    while (tail > cp) {
+		  if (! isspace((int)tail[-1]))
+			break;
+		  tail -= 1;
+		  tail[0] = 0;
+	    }
+
+	      /* Skip empty lines */
+	    if (*cp == 0)
+		  continue;
+	      /* Skip comment lines */
+	    if (cp[0] == '#')
+		  continue;
+
+	      /* The arg points to the argument to the keyword. */
+	    arg = strchr(cp, ':');
+	    if (arg) *arg++ = 0;
+
+	    if (strcmp(cp,"D") == 0) {
+		  char*val = strchr(arg, '=');
+		  const char *valo = "1";
+		  if (val) {
+			*val++ = 0;
+			valo = val;
+		  }
+
+		  define_macro(arg, valo, 0, 0);
+
+	    } else if (strcmp(cp,"I") == 0) {
+		  include_dir = realloc(include_dir,
+					(include_cnt+1)*sizeof(char*));
+		  include_dir[include_cnt] = strdup(arg);
+		  include_cnt += 1;
+
+	    } else if (strcmp(cp,"keyword") == 0) {
+		  char*buf = malloc(strlen(arg) + 2);
+		  buf[0] = '`';
+		  strcpy(buf+1, arg);
+		  define_macro(arg, buf, 1, 0);
+		  free(buf);
+
+	    } else if ((strcmp(cp,"Ma") == 0)
+                   ||  (strcmp(cp,"Mi") == 0)
+                   ||  (strcmp(cp,"Mm") == 0)
+                   ||  (strcmp(cp,"Mp") == 0)) {
+		  if (dep_path) {
+			fprintf(stderr, "duplicate -M flag.\n");
+                  } else {
+                        dep_mode = cp[1];
+			dep_path = strdup(arg);
+		  }
+
+	    } else if (strcmp(cp,"relative include") == 0) {
+		  if (strcmp(arg, "true") == 0) {
+			relative_include = 1;
+		  } else {
+			relative_include = 0;
+		  }
+
+	    } else if (strcmp(cp,"vhdlpp") == 0) {
+		  if (vhdlpp_path) {
+			fprintf(stderr, "Ignore multiple vhdlpp flags\n");
+		  } else {
+			vhdlpp_path = strdup(arg);
+		  }
+
+	    } else if (strcmp(cp,"vhdlpp-work") == 0) {
+		  if (vhdlpp_work) {
+			fprintf(stderr, "Ignore duplicate vhdlpp-work flags\n");
+		  } else {
+			vhdlpp_work = strdup(arg);
+		  }
+
+	    } else if (strcmp(cp,"vhdlpp-libdir") == 0) {
+		  vhdlpp_libdir = realloc(vhdlpp_libdir,
+					  (vhdlpp_libdir_cnt+1)*sizeof(char*));
+		  vhdlpp_libdir[vhdlpp_libdir_cnt] = strdup(arg);
+		  vhdlpp_libdir_cnt += 1;
+
+	    } else {
+		  fprintf(stderr, "%s: Invalid keyword %s\n", path, cp);
+	    }
+      }
+
+      fclose(fd);
+      return 0;
+}
+
+void free_setup(void)
+{
+      unsigned lp;
+
+	/* Free the include directory list. */
+      for (lp = 0; lp < include_cnt; lp += 1) {
+	    free(include_dir[lp]);
+      }
+      free(include_dir);
+      include_dir = 0;
+      include_cnt = 0;
+
+	/* Free the VHDL library directories, the path and work directory. */
+      for (lp = 0; lp < vhdlpp_libdir_cnt; lp += 1) {
+	    free(vhdlpp_libdir[lp]);
+      }
+      free(vhdlpp_libdir);
+      free(vhdlpp_path);
+      free(vhdlpp_work);
+      vhdlpp_libdir = 0;
+      vhdlpp_libdir_cnt = 0;
+      vhdlpp_path = 0;
+      vhdlpp_work = 0;
+
+      free(dep_path);
+      dep_path = 0;
+}
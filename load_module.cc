@@ -30,6 +30,11 @@
 # include  <dirent.h>
 # include  <cctype>
 # include  <cassert>
+#if defined(HAVE_TIMES)
+# include  <sys/times.h>
+# include  <unistd.h>
+#endif
+# include  "ivlpp/ivlpp.h"
 # include  "ivl_alloc.h"
 
 /*
@@ -50,6 +55,74 @@ const char dir_character = '/';
 extern char depfile_mode;
 extern FILE *depend_file;
 
+/*
+ * Library files are preprocessed by the preprocessor that is linked
+ * in, unless the ivlpp command has flags that it does not handle. The
+ * time spent on library files is kept for the verbose report.
+ */
+enum { IVLPP_UNKNOWN, IVLPP_LINKED, IVLPP_COMMAND };
+static int ivlpp_mode = IVLPP_UNKNOWN;
+
+static unsigned library_files = 0;
+static double library_pp_time = 0.0;
+static double library_parse_time = 0.0;
+
+#if defined(HAVE_TIMES)
+static double wall_time(void)
+{
+      struct tms tmp;
+      return times(&tmp) / (double)sysconf(_SC_CLK_TCK);
+}
+#else
+static double wall_time(void) { return 0.0; }
+#endif
+
+/*
+ * Preprocess and parse a library file with the linked in
+ * preprocessor. Return 1 if the file is loaded, 0 if the preprocessor
+ * cannot be used so that the caller runs the ivlpp command instead,
+ * or -1 if preprocessing the file failed.
+ */
+static int load_linked(const char*path)
+{
+      if (ivlpp_mode == IVLPP_UNKNOWN) {
+	    if (ivlpp_library_open(ivlpp_string)) {
+		  ivlpp_mode = IVLPP_LINKED;
+	    } else {
+		  ivlpp_mode = IVLPP_COMMAND;
+		  if (verbose_flag)
+			cerr << "Using the preprocessor command for "
+			     << "library files." << endl;
+	    }
+      }
+
+      if (ivlpp_mode != IVLPP_LINKED)
+	    return 0;
+
+      if (verbose_flag)
+	    cerr << "Preprocessing library file " << path << "." << endl;
+
+      double start = wall_time();
+      FILE*file;
+      int rc = ivlpp_library_file(path, &file);
+      if (rc < 0)
+	    return 0;
+      if (rc > 0) {
+	    cerr << path << ": error: " << rc << " error(s) while "
+		 << "preprocessing the library file." << endl;
+	    return -1;
+      }
+
+      double mid = wall_time();
+      pform_parse(path, file);
+      fclose(file);
+      double end = wall_time();
+
+      library_pp_time += mid - start;
+      library_parse_time += end - mid;
+      return 1;
+}
+
 /*
  * Use the type name as a key, and search the module library for a
  * file name that has that key.
@@ -82,7 +155,17 @@ bool load_module(const char*type)
 		  fflush(depend_file);
 	    }
 
-	    if (ivlpp_string) {
+	    library_files += 1;
+
+	    int linked = ivlpp_string? load_linked(path) : 0;
+	    if (linked < 0) {
+		  return false;
+
+	    } else if (linked > 0) {
+		    /* Already preprocessed and parsed. */
+
+	    } else if (ivlpp_string) {
+		  double start = wall_time();
 		  char*cmdline = (char*)malloc(strlen(ivlpp_string) +
 					       strlen(path) + 4);
 		  strcpy(cmdline, ivlpp_string);
@@ -101,6 +184,7 @@ bool load_module(const char*type)
 		  pform_parse(path, file);
 		  pclose(file);
 		  free(cmdline);
+		  library_pp_time += wall_time() - start;
 
 	    } else {
 		  if (verbose_flag)
@@ -123,6 +207,35 @@ bool load_module(const char*type)
       return false;
 }
 
+/*
+ * Print the time spent on library files, and release the linked in
+ * preprocessor.
+ */
+void library_load_report(void)
+{
+      if (verbose_flag && library_files > 0) {
+	    cerr << "Loaded " << library_files << " library files";
+#if defined(HAVE_TIMES)
+	    if (ivlpp_mode == IVLPP_LINKED) {
+		  cerr << ", " << library_pp_time << " seconds preprocessing, "
+		       << library_parse_time << " seconds parsing";
+	    } else if (ivlpp_string) {
+		  cerr << ", " << library_pp_time << " seconds "
+		       << "preprocessing and parsing";
+	    }
+#endif
+	    cerr << "." << endl;
+
+	    unsigned hits, misses;
+	    ivlpp_library_cache_stats(&hits, &misses);
+	    if (hits + misses > 0)
+		  cerr << "Library cache: " << hits << " hits, "
+		       << misses << " misses." << endl;
+      }
+
+      ivlpp_library_close();
+}
+
 /*
  * This function takes the name of a library directory that the caller
  * passed, and builds a name index for it.
@@ -61,6 +61,8 @@ const char NOTICE[] =
 # include  "compiler.h"
 # include  "discipline.h"
 # include  "t-dll.h"
+# include  "util.h"
+# include  "ivlpp/ivlpp.h"
 
 #if defined(__MINGW32__) && !defined(HAVE_GETOPT_H)
 extern "C" int getopt(int argc, char*argv[], const char*fmt);
@@ -740,6 +742,25 @@ inline static void times(struct tms *) { }
 inline static double cycles_diff(struct tms *, struct tms *) { return 0; }
 #endif // ! defined(HAVE_TIMES)
 
+/*
+ * elaborate() calls this at the end of each of its phases. The time
+ * of each phase is printed with the times of the compiler steps.
+ */
+static bool phase_times_flag = false;
+static struct tms phase_cycles;
+
+void elaborate_phase_done(const char*name)
+{
+      if (! phase_times_flag)
+	    return;
+
+      struct tms now;
+      times(&now);
+      cerr<<" ... "<<name<<", "
+	  <<cycles_diff(&now, &phase_cycles)<<" seconds."<<endl;
+      phase_cycles = now;
+}
+
 static void EOC_cleanup(void)
 {
       cleanup_sys_func_table();
@@ -951,6 +972,9 @@ int main(int argc, char*argv[])
       flag_tmp = flags["RECURSIVE_MOD_LIMIT"];
       if (flag_tmp) recursive_mod_limit = strtoul(flag_tmp,NULL,0);
 
+      flag_tmp = flags["LIBRARY_CACHE"];
+      if (flag_tmp) ivlpp_library_cache(flag_tmp);
+
 	/* Parse the input. Make the pform. */
       pform_set_timescale(def_ts_units, def_ts_prec, 0, 0);
       int rc = pform_parse(argv[optind]);
@@ -1032,6 +1056,8 @@ int main(int argc, char*argv[])
 		  times(cycles+1);
 		  cerr<<" ... done, "
 		      <<cycles_diff(cycles+1, cycles+0)<<" seconds."<<endl;
+		  phase_cycles = cycles[1];
+		  phase_times_flag = true;
 	    }
 	    cout << "ELABORATING DESIGN" << endl;
       }
@@ -1044,6 +1070,7 @@ int main(int argc, char*argv[])
 
 	/* On with the process of elaborating the module. */
       Design*des = elaborate(roots);
+      library_load_report();
 
       if ((des == 0) || (des->errors > 0)) {
 	    if (des != 0) {
@@ -675,6 +675,67 @@ void NetScope::residual_defparams(Design*des)
 	    cur->second->residual_defparams(des);
 }
 
+void Design::report_parameterizations(ostream&out) const
+{
+      NetScope::param_count_t res;
+      for (list<NetScope*>::const_iterator scope = root_scopes_.begin();
+	   scope != root_scopes_.end(); ++ scope )
+	    (*scope)->count_parameterizations(res);
+
+	// Count the instances of each module.
+      map<perm_string,unsigned> mod_instances;
+      unsigned instances = 0, distinct = 0;
+      for (NetScope::param_count_t::const_iterator mod = res.begin()
+		 ; mod != res.end() ; ++ mod ) {
+	    unsigned count = 0;
+	    for (map<string,unsigned>::const_iterator cur = mod->second.begin()
+		       ; cur != mod->second.end() ; ++ cur )
+		  count += cur->second;
+	    mod_instances[mod->first] = count;
+	    instances += count;
+	    distinct += mod->second.size();
+      }
+
+      out << " ... " << instances << " module instances, " << distinct
+	  << " distinct parameterizations" << endl;
+
+	// List the modules that have instances with the same
+	// parameter values.
+      for (NetScope::param_count_t::const_iterator mod = res.begin()
+		 ; mod != res.end() ; ++ mod ) {
+	    unsigned count = mod_instances[mod->first];
+	    if (count == mod->second.size())
+		  continue;
+
+	    out << "     " << mod->first << ": " << count << " instances, "
+		<< mod->second.size() << " parameterizations" << endl;
+      }
+}
+
+/*
+ * The key of a module instance is the list of its parameter names and
+ * evaluated values. Instances of a module with the same key have the
+ * same parameter values.
+ */
+void NetScope::count_parameterizations(param_count_t&res) const
+{
+      if (type_ == MODULE) {
+	    ostringstream key;
+	    for (map<perm_string,param_expr_t>::const_iterator cur = parameters.begin()
+		       ; cur != parameters.end() ; ++ cur ) {
+		  key << cur->first << "=";
+		  if (cur->second.val)
+			key << *cur->second.val;
+		  key << ";";
+	    }
+	    res[module_name()][key.str()] += 1;
+      }
+
+      for (map<hname_t,NetScope*>::const_iterator cur = children_.begin()
+		 ; cur != children_.end() ; ++ cur )
+	    cur->second->count_parameterizations(res);
+}
+
 const char* Design::get_flag(const string&key) const
 {
       map<string,const char*>::const_iterator tmp = flags_.find(key);
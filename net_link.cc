@@ -95,6 +95,13 @@ void connect(Link&l, Link&r)
 	    connect(l.nexus_, r);
       } else if (r.nexus_ != 0) {
 	    connect(r.nexus_, l);
+      } else if (l.next_ != 0) {
+	      // The link is already part of a nexus. Join the other
+	      // link to that nexus instead of making a new nexus to
+	      // take over the list. The links end up in the same order
+	      // either way. A net that many instances share, such as a
+	      // clock, is connected this way once for each instance.
+	    l.find_nexus_()->connect(r);
       } else {
 	    Nexus*tmp = new Nexus(l);
 	    tmp->connect(r);
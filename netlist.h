@@ -918,6 +918,11 @@ class NetScope : public Attrib {
 	// Look for defparams that never matched, and print warnings.
       void residual_defparams(class Design*);
 
+	// Count the module instances at and below this scope by
+	// module name and parameter values.
+      typedef map<perm_string, map<string,unsigned> > param_count_t;
+      void count_parameterizations(param_count_t&res) const;
+
 	/* This method generates a non-hierarchical name that is
 	   guaranteed to be unique within this scope. */
       perm_string local_symbol();
@@ -4078,6 +4083,10 @@ class Design {
 	// Look for defparams that never matched, and print warnings.
       void residual_defparams();
 
+	// Print how many module instances share each set of parameter
+	// values, for the verbose output.
+      void report_parameterizations(ostream&) const;
+
 	/* This method locates a signal, starting at a given
 	   scope. The name parameter may be partially hierarchical, so
 	   this method, unlike the NetScope::find_signal method,
@@ -36,6 +36,12 @@ class NetScope;
  */
 extern bool load_module(const char*type);
 
+/*
+ * Print the time spent loading library files with -v, and release
+ * the linked in preprocessor.
+ */
+extern void library_load_report(void);
+
 
 
 struct attrib_list_t {
@@ -25,6 +25,11 @@
 #include "fstapi.h"
 #include "fastlz.h"
 
+#if defined(HAVE_LIBPTHREAD) && !defined(__MINGW32__)
+#define FST_WRITER_PARALLEL
+#include <pthread.h>
+#endif
+
 
 /* this define is to force writer backward compatibility with old readers */
 #ifndef FST_DYNAMIC_ALIAS_DISABLE
@@ -55,6 +60,7 @@ void **JenkinsIns(void *base_i, unsigned char *mem, uint32_t length, uint32_t ha
 #define FST_HDR_SIM_VERSION_SIZE 	(128)
 #define FST_HDR_DATE_SIZE 		(128)
 #define FST_GZIO_LEN			(32768)
+#define FST_WRITER_QUEUE_DEPTH		(2)
 
 #if defined(__i386__) || defined(__x86_64__) || defined(_AIX)
 #define FST_DO_MISALIGNED_OPS
@@ -502,14 +508,48 @@ uint64_t dump_size_limit;
 
 unsigned compress_hier : 1;
 unsigned repack_on_close : 1;
-unsigned skip_writing_section_hdr : 1;
-unsigned size_limit_locked : 1;
-unsigned section_header_only : 1;
 unsigned flush_context_pending : 1;
 
+/* not bitfields, as the writer thread sets these while the simulation thread sets the ones above */
+unsigned char skip_writing_section_hdr;
+unsigned char size_limit_locked;
+unsigned char section_header_only;
+
 /* should really be semaphores, but are bytes to cut down on read-modify-write window size */
 unsigned char already_in_flush; /* in case control-c handlers interrupt */
 unsigned char already_in_close; /* in case control-c handlers interrupt */
+
+#ifdef FST_WRITER_PARALLEL
+/* blocks waiting for (or being written by) the writer thread, see fstWriterSetParallelMode() */
+pthread_t worker;
+pthread_mutex_t queue_mutex;
+pthread_cond_t queue_cond;
+struct fstWriterBlock *queue_head;
+struct fstWriterBlock *queue_tail;
+unsigned int queue_len;
+unsigned char parallel_enabled;
+unsigned char worker_exit;
+unsigned char limit_reached;
+uint64_t limit_time;
+#endif
+};
+
+
+/*
+ * a completed block of value changes, along with the time changes and
+ * the value chain heads (valpos_mem) that go with it
+ */
+struct fstWriterBlock
+{
+unsigned char *vchg_mem;
+uint32_t vchg_siz;
+uint32_t *valpos_mem;
+fstHandle maxhandle;
+FILE *tchn_handle;
+uint32_t tchn_cnt;
+uint64_t curtime;
+unsigned char fastpack; /* copied from the context, which the simulation thread keeps changing */
+struct fstWriterBlock *next;
 };
 
 
@@ -762,10 +802,8 @@ return(xc);
 /*
  * generation and writing out of value change data sections
  */
-static void fstWriterEmitSectionHeader(void *ctx)
+static void fstWriterEmitSectionHeader(struct fstWriterContext *xc, uint64_t begtime, uint64_t endtime, fstHandle maxhandle)
 {
-struct fstWriterContext *xc = (struct fstWriterContext *)ctx;
-
 if(xc)
 	{
 	unsigned long destlen;
@@ -780,8 +818,8 @@ if(xc)
 	xc->section_start = ftello(xc->handle);
 	xc->section_header_only = 1;			/* indicates truncate might be needed */
 	fstWriterUint64(xc->handle, 0); 		/* placeholder = section length */
-	fstWriterUint64(xc->handle, xc->is_initial_time ? xc->firsttime : xc->curtime); 	/* begin time of section */
-	fstWriterUint64(xc->handle, xc->curtime); 	/* end time of section (placeholder) */
+	fstWriterUint64(xc->handle, begtime); 		/* begin time of section */
+	fstWriterUint64(xc->handle, endtime); 		/* end time of section (placeholder) */
 	fstWriterUint64(xc->handle, 0);			/* placeholder = amount of buffer memory required in reader for full vc traversal */
 	fstWriterVarint(xc->handle, xc->maxvalpos);	/* maxvalpos = length of uncompressed data */
 
@@ -793,7 +831,7 @@ if(xc)
 		{
 		fstWriterVarint(xc->handle, xc->maxvalpos); /* length of (unable to be) compressed data */
 		}
-	fstWriterVarint(xc->handle, xc->maxhandle);	/* max handle associated with this data (in case of dynamic facility adds) */
+	fstWriterVarint(xc->handle, maxhandle);		/* max handle associated with this data (in case of dynamic facility adds) */
 
 	if((rc == Z_OK) && (destlen < xc->maxvalpos))
 		{
@@ -810,10 +848,10 @@ if(xc)
 
 
 /*
- * only to be called directly by fst code...otherwise must
- * be synced up with time changes
+ * write out a block of value changes, its time changes, and the
+ * header of the next section
  */
-static void fstWriterFlushContextPrivate(void *ctx)
+static void fstWriterWriteBlock(struct fstWriterContext *xc, struct fstWriterBlock *blk)
 {
 #ifdef FST_DEBUG
 int cnt = 0;
@@ -832,12 +870,11 @@ off_t unc_memreq = 0; /* for reader */
 unsigned char *packmem;
 unsigned int packmemlen;
 uint32_t *vm4ip;
-struct fstWriterContext *xc = (struct fstWriterContext *)ctx;
 
 #ifndef FST_DYNAMIC_ALIAS_DISABLE
 Pvoid_t PJHSArray = (Pvoid_t) NULL;
 #ifndef _WAVE_HAVE_JUDY
-uint32_t hashmask =  xc->maxhandle;
+uint32_t hashmask =  blk->maxhandle;
 hashmask |= hashmask >> 1;
 hashmask |= hashmask >> 2;
 hashmask |= hashmask >> 4;
@@ -846,25 +883,22 @@ hashmask |= hashmask >> 16;
 #endif
 #endif
 
-if((!xc)||(xc->vchg_siz <= 1)||(xc->already_in_flush)) return;
-xc->already_in_flush = 1; /* should really do this with a semaphore */
-
 xc->section_header_only = 0;
-scratchpad = malloc(xc->vchg_siz);
+scratchpad = malloc(blk->vchg_siz);
 
-vchg_mem = xc->vchg_mem;
+vchg_mem = blk->vchg_mem;
 
 f = xc->handle;
-fstWriterVarint(f, xc->maxhandle);	/* emit current number of handles */
-fputc(xc->fastpack ? 'F' : 'Z', f);
+fstWriterVarint(f, blk->maxhandle);	/* emit current number of handles */
+fputc(blk->fastpack ? 'F' : 'Z', f);
 fpos = 1;
 
 packmemlen = 1024;			/* maintain a running "longest" allocation to */
 packmem = malloc(packmemlen);		/* prevent continual malloc...free every loop iter */
 
-for(i=0;i<xc->maxhandle;i++)
+for(i=0;i<blk->maxhandle;i++)
 	{
-	vm4ip = &(xc->valpos_mem[4*i]);
+	vm4ip = &(blk->valpos_mem[4*i]);
 
 	if(vm4ip[2]) 
 		{
@@ -874,7 +908,7 @@ for(i=0;i<xc->maxhandle;i++)
 
 		vm4ip[2] = fpos;
 
-		scratchpnt = scratchpad + xc->vchg_siz;		/* build this buffer backwards */
+		scratchpnt = scratchpad + blk->vchg_siz;		/* build this buffer backwards */
 		if(vm4ip[1] <= 1)
 			{
 			if(vm4ip[1] == 1)
@@ -999,7 +1033,7 @@ for(i=0;i<xc->maxhandle;i++)
 				}
 			}
 
-		wrlen = scratchpad + xc->vchg_siz - scratchpnt;
+		wrlen = scratchpad + blk->vchg_siz - scratchpnt;
 		unc_memreq += wrlen;
 		if(wrlen > 32)
 			{
@@ -1007,7 +1041,7 @@ for(i=0;i<xc->maxhandle;i++)
 			unsigned char *dmem;
 		        int rc;
 
-			if(!xc->fastpack)
+			if(!blk->fastpack)
 				{
 				if(wrlen <= packmemlen)
 					{
@@ -1156,9 +1190,9 @@ free(scratchpad); scratchpad = NULL;
 indxpos = ftello(f);
 xc->secnum++;
 
-for(i=0;i<xc->maxhandle;i++)
+for(i=0;i<blk->maxhandle;i++)
 	{
-	vm4ip = &(xc->valpos_mem[4*i]);
+	vm4ip = &(blk->valpos_mem[4*i]);
 
 	if(vm4ip[2])
 		{
@@ -1194,18 +1228,15 @@ if(zerocnt)
 printf("value chains: %d\n", cnt);
 #endif
 
-xc->vchg_mem[0] = '!';
-xc->vchg_siz = 1;
-
 endpos = ftello(xc->handle);
 fstWriterUint64(xc->handle, endpos-indxpos);		/* write delta index position at very end of block */
 
 /*emit time changes for block */
-fflush(xc->tchn_handle);
-tlen = ftello(xc->tchn_handle);
-fseeko(xc->tchn_handle, 0, SEEK_SET);
+fflush(blk->tchn_handle);
+tlen = ftello(blk->tchn_handle);
+fseeko(blk->tchn_handle, 0, SEEK_SET);
 
-tmem = fstMmap(NULL, tlen, PROT_READ|PROT_WRITE, MAP_SHARED, fileno(xc->tchn_handle), 0);
+tmem = fstMmap(NULL, tlen, PROT_READ|PROT_WRITE, MAP_SHARED, fileno(blk->tchn_handle), 0);
 if(tmem)
 	{
 	unsigned long destlen = tlen;
@@ -1225,19 +1256,18 @@ if(tmem)
 	fstMunmap(tmem, tlen);
 	fstWriterUint64(xc->handle, tlen);		/* uncompressed */
 	fstWriterUint64(xc->handle, destlen);		/* compressed */
-	fstWriterUint64(xc->handle, xc->tchn_cnt); 	/* number of time items */
+	fstWriterUint64(xc->handle, blk->tchn_cnt); 	/* number of time items */
 	}
 
-xc->tchn_cnt = xc->tchn_idx = 0;
-fseeko(xc->tchn_handle, 0, SEEK_SET);
-fstFtruncate(fileno(xc->tchn_handle), 0);
+fseeko(blk->tchn_handle, 0, SEEK_SET);
+fstFtruncate(fileno(blk->tchn_handle), 0);
 
 /* write block trailer */
 endpos = ftello(xc->handle);
 fseeko(xc->handle, xc->section_start, SEEK_SET);
 fstWriterUint64(xc->handle, endpos - xc->section_start); 	/* write block length */
 fseeko(xc->handle, 8, SEEK_CUR);				/* skip begin time */
-fstWriterUint64(xc->handle, xc->curtime); 			/* write end time for section */
+fstWriterUint64(xc->handle, blk->curtime); 			/* write end time for section */
 fstWriterUint64(xc->handle, unc_memreq);			/* amount of buffer memory required in reader for full traversal */
 fflush(xc->handle);
 
@@ -1260,7 +1290,6 @@ if(xc->dump_size_limit)
 		{
 		xc->skip_writing_section_hdr = 1;
 		xc->size_limit_locked = 1;
-		xc->is_initial_time = 1; /* to trick emit value and emit time change */
 #ifdef FST_DEBUG
 		printf("<< dump file size limit reached, stopping dumping >>\n");
 #endif
@@ -1269,9 +1298,217 @@ if(xc->dump_size_limit)
 
 if(!xc->skip_writing_section_hdr)
 	{
-	fstWriterEmitSectionHeader(xc);				/* emit next section header */
+	fstWriterEmitSectionHeader(xc, blk->curtime, blk->curtime, blk->maxhandle);	/* emit next section header */
 	}
 fflush(xc->handle);
+}
+
+
+#ifdef FST_WRITER_PARALLEL
+/*
+ * In parallel mode a full block is handed to a writer thread, which
+ * compresses and writes it while the simulation fills the next
+ * block. The queue holds at most FST_WRITER_QUEUE_DEPTH blocks
+ * (counting the one being written), after which the simulation
+ * thread waits for the writer to catch up.
+ *
+ * The writer thread owns the output file, curval_mem and the section
+ * bookkeeping while parallel mode is on. Anything else that touches
+ * them first waits for the queue to drain.
+ */
+static void fstWriterFreeBlock(struct fstWriterBlock *blk)
+{
+free(blk->vchg_mem);
+free(blk->valpos_mem);
+fclose(blk->tchn_handle);
+free(blk);
+}
+
+
+static void *fstWriterWorker(void *ctx)
+{
+struct fstWriterContext *xc = (struct fstWriterContext *)ctx;
+
+pthread_mutex_lock(&xc->queue_mutex);
+for(;;)
+	{
+	struct fstWriterBlock *blk = xc->queue_head;
+	uint64_t blk_time;
+
+	if(!blk)
+		{
+		if(xc->worker_exit) break;
+		pthread_cond_wait(&xc->queue_cond, &xc->queue_mutex);
+		continue;
+		}
+
+	xc->queue_head = blk->next;
+	if(!xc->queue_head) xc->queue_tail = NULL;
+	pthread_mutex_unlock(&xc->queue_mutex);
+
+	blk_time = blk->curtime;
+
+	if(!xc->size_limit_locked) /* once the limit is reached, the rest is dropped */
+		{
+		fstWriterWriteBlock(xc, blk);
+		}
+	fstWriterFreeBlock(blk);
+
+	pthread_mutex_lock(&xc->queue_mutex);
+	xc->queue_len--;
+	if(xc->size_limit_locked && !xc->limit_reached)
+		{
+		xc->limit_reached = 1;
+		xc->limit_time = blk_time;
+		}
+	pthread_cond_broadcast(&xc->queue_cond);
+	}
+pthread_mutex_unlock(&xc->queue_mutex);
+
+return(NULL);
+}
+
+
+/*
+ * once the writer thread has reached the dump size limit, stop
+ * dumping as the serial writer does, and end the dump at the time of
+ * the last block written. called with the queue mutex held.
+ */
+static void fstWriterCheckLimit(struct fstWriterContext *xc)
+{
+if(xc->limit_reached && !xc->is_initial_time)
+	{
+	xc->is_initial_time = 1; /* to trick emit value and emit time change */
+	xc->curtime = xc->limit_time;
+	}
+}
+
+
+static void fstWriterQueueBlock(struct fstWriterContext *xc)
+{
+struct fstWriterBlock *blk = calloc(1, sizeof(struct fstWriterBlock));
+size_t vlen = xc->maxhandle * 4 * sizeof(uint32_t);
+int i;
+
+blk->vchg_mem = xc->vchg_mem;
+blk->vchg_siz = xc->vchg_siz;
+blk->valpos_mem = malloc(vlen);
+memcpy(blk->valpos_mem, xc->valpos_mem, vlen);
+blk->maxhandle = xc->maxhandle;
+blk->tchn_handle = xc->tchn_handle;
+blk->tchn_cnt = xc->tchn_cnt;
+blk->curtime = xc->curtime;
+blk->fastpack = xc->fastpack;
+
+/* the next block starts out with fresh buffers */
+xc->vchg_mem = malloc(xc->vchg_alloc_siz);
+xc->tchn_handle = tmpfile();
+if((!xc->vchg_mem)||(!xc->tchn_handle))
+	{
+	fprintf(stderr, "FATAL ERROR, could not allocate a new block in fstWriterQueueBlock, exiting.\n");
+	exit(255);
+	}
+xc->vchg_mem[0] = '!';
+xc->vchg_siz = 1;
+xc->tchn_cnt = xc->tchn_idx = 0;
+for(i=0;i<xc->maxhandle;i++)
+	{
+	xc->valpos_mem[4*i+2] = 0; /* zero out offset val */
+	xc->valpos_mem[4*i+3] = 0; /* zero out last time change val */
+	}
+
+pthread_mutex_lock(&xc->queue_mutex);
+while(xc->queue_len >= FST_WRITER_QUEUE_DEPTH)
+	{
+	pthread_cond_wait(&xc->queue_cond, &xc->queue_mutex);
+	}
+if(xc->queue_tail)
+	{
+	xc->queue_tail->next = blk;
+	}
+	else
+	{
+	xc->queue_head = blk;
+	}
+xc->queue_tail = blk;
+xc->queue_len++;
+fstWriterCheckLimit(xc);
+pthread_cond_broadcast(&xc->queue_cond);
+pthread_mutex_unlock(&xc->queue_mutex);
+}
+
+
+/*
+ * wait until the writer thread has written out every queued block
+ */
+static void fstWriterDrainQueue(struct fstWriterContext *xc)
+{
+pthread_mutex_lock(&xc->queue_mutex);
+while(xc->queue_len)
+	{
+	pthread_cond_wait(&xc->queue_cond, &xc->queue_mutex);
+	}
+fstWriterCheckLimit(xc);
+pthread_mutex_unlock(&xc->queue_mutex);
+}
+
+
+static void fstWriterStopWorker(struct fstWriterContext *xc)
+{
+fstWriterDrainQueue(xc);
+
+pthread_mutex_lock(&xc->queue_mutex);
+xc->worker_exit = 1;
+pthread_cond_broadcast(&xc->queue_cond);
+pthread_mutex_unlock(&xc->queue_mutex);
+pthread_join(xc->worker, NULL);
+
+pthread_cond_destroy(&xc->queue_cond);
+pthread_mutex_destroy(&xc->queue_mutex);
+xc->parallel_enabled = 0;
+}
+#endif
+
+
+/*
+ * only to be called directly by fst code...otherwise must
+ * be synced up with time changes
+ */
+static void fstWriterFlushContextPrivate(void *ctx)
+{
+struct fstWriterContext *xc = (struct fstWriterContext *)ctx;
+struct fstWriterBlock blk;
+
+if((!xc)||(xc->vchg_siz <= 1)||(xc->already_in_flush)) return;
+xc->already_in_flush = 1; /* should really do this with a semaphore */
+
+#ifdef FST_WRITER_PARALLEL
+if(xc->parallel_enabled)
+	{
+	fstWriterQueueBlock(xc);
+	xc->already_in_flush = 0;
+	return;
+	}
+#endif
+
+blk.vchg_mem = xc->vchg_mem;
+blk.vchg_siz = xc->vchg_siz;
+blk.valpos_mem = xc->valpos_mem;
+blk.maxhandle = xc->maxhandle;
+blk.tchn_handle = xc->tchn_handle;
+blk.tchn_cnt = xc->tchn_cnt;
+blk.curtime = xc->curtime;
+blk.fastpack = xc->fastpack;
+fstWriterWriteBlock(xc, &blk);
+
+xc->vchg_mem[0] = '!';
+xc->vchg_siz = 1;
+xc->tchn_cnt = xc->tchn_idx = 0;
+
+if(xc->size_limit_locked)
+	{
+	xc->is_initial_time = 1; /* to trick emit value and emit time change */
+	}
 
 xc->already_in_flush = 0;
 }
@@ -1306,6 +1543,13 @@ if(xc && !xc->already_in_close && !xc->already_in_flush)
 
 	xc->already_in_close = 1; /* never need to zero this out as it is freed at bottom */
 
+#ifdef FST_WRITER_PARALLEL
+	if(xc->parallel_enabled)
+		{
+		fstWriterStopWorker(xc);
+		}
+#endif
+
 	if(xc->section_header_only && xc->section_header_truncpos && (xc->vchg_siz <= 1) && (!xc->is_initial_time))
 		{
 		fstFtruncate(fileno(xc->handle), xc->section_header_truncpos);
@@ -1686,16 +1930,70 @@ void fstWriterSetDumpSizeLimit(void *ctx, uint64_t numbytes)
 struct fstWriterContext *xc = (struct fstWriterContext *)ctx;
 if(xc)
 	{
+#ifdef FST_WRITER_PARALLEL
+	if(xc->parallel_enabled)
+		{
+		fstWriterDrainQueue(xc);
+		}
+#endif
 	xc->dump_size_limit = numbytes;
 	}
 }
 
 
+void fstWriterSetParallelMode(void *ctx, int enable)
+{
+struct fstWriterContext *xc = (struct fstWriterContext *)ctx;
+#ifdef FST_WRITER_PARALLEL
+if(xc)
+	{
+	if(enable && !xc->parallel_enabled)
+		{
+		pthread_mutex_init(&xc->queue_mutex, NULL);
+		pthread_cond_init(&xc->queue_cond, NULL);
+		xc->queue_head = xc->queue_tail = NULL;
+		xc->queue_len = 0;
+		xc->worker_exit = 0;
+		xc->limit_reached = xc->size_limit_locked;
+
+		if(pthread_create(&xc->worker, NULL, fstWriterWorker, xc) == 0)
+			{
+			xc->parallel_enabled = 1;
+			}
+			else
+			{
+			pthread_cond_destroy(&xc->queue_cond);
+			pthread_mutex_destroy(&xc->queue_mutex);
+			}
+		}
+	else if(!enable && xc->parallel_enabled)
+		{
+		fstWriterStopWorker(xc);
+		}
+	}
+#else
+(void)xc;
+(void)enable;
+#endif
+}
+
+
 int fstWriterGetDumpSizeLimitReached(void *ctx)
 {
 struct fstWriterContext *xc = (struct fstWriterContext *)ctx;
 if(xc)
         {
+#ifdef FST_WRITER_PARALLEL
+	if(xc->parallel_enabled)
+		{
+		int rc;
+
+		pthread_mutex_lock(&xc->queue_mutex);
+		rc = (xc->limit_reached != 0);
+		pthread_mutex_unlock(&xc->queue_mutex);
+		return(rc);
+		}
+#endif
         return(xc->size_limit_locked != 0);
         }
 
@@ -1716,6 +2014,12 @@ if(xc && nam)
         {
 	if(xc->valpos_mem)
 		{
+#ifdef FST_WRITER_PARALLEL
+		if(xc->parallel_enabled)
+			{
+			fstWriterDrainQueue(xc);
+			}
+#endif
 		fstDestroyMmaps(xc, 0);
 		}
 
@@ -1954,7 +2258,7 @@ if(xc)
 		xc->curtime = 0;
 		xc->vchg_mem[0] = '!';
 		xc->vchg_siz = 1;
-		fstWriterEmitSectionHeader(xc);
+		fstWriterEmitSectionHeader(xc, xc->firsttime, xc->curtime, xc->maxhandle);
 		for(i=0;i<xc->maxhandle;i++)
 			{
 			xc->valpos_mem[4*i+2] = 0; /* zero out offset val */
@@ -1966,8 +2270,21 @@ if(xc)
 		{
 		if((xc->vchg_siz >= FST_BREAK_SIZE) || (xc->flush_context_pending))
 			{
+#ifdef FST_WRITER_PARALLEL
+			int explicit_flush = xc->flush_context_pending;
+#endif
 			xc->flush_context_pending = 0;
 			fstWriterFlushContextPrivate(xc);
+#ifdef FST_WRITER_PARALLEL
+			if(explicit_flush && xc->parallel_enabled)
+				{
+				fstWriterDrainQueue(xc); /* a requested flush is on disk on return */
+				}
+			if(xc->parallel_enabled && xc->is_initial_time)
+				{
+				return; /* writer thread reached the size limit, the dump ends at limit_time */
+				}
+#endif
 			xc->tchn_cnt++;
 			fstWriterVarint(xc->tchn_handle, xc->curtime);
 			}
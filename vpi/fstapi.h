@@ -150,6 +150,7 @@ void fstWriterSetPackType(void *ctx, int typ); 		/* type = 0 (libz), 1 (fastlz)
 void fstWriterSetRepackOnClose(void *ctx, int enable); 	/* type = 0 (none), 1 (libz) */
 void fstWriterSetDumpSizeLimit(void *ctx, uint64_t numbytes);
 int fstWriterGetDumpSizeLimitReached(void *ctx);
+void fstWriterSetParallelMode(void *ctx, int enable);	/* write blocks from a background thread if possible */
 
 void *fstWriterCreate(const char *nam, int use_compressed_hier);
 void fstWriterClose(void *ctx);
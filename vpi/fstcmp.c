@@ -0,0 +1,671 @@
+/*
+ * Copyright (c) 2012 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+/*
+ * fstcmp compares two FST dump files signal by signal, and reports
+ * the first time at which each signal differs. The signals are
+ * matched by their full hierarchical name.
+ *
+ *     fstcmp [-j <jobs>] [-b <time>] [-e <time>] [-s <scope>]...
+ *            <a.fst> <b.fst>
+ *
+ * The signals are split into groups, and a number of worker threads
+ * take the groups in turn. Each worker has a reader of its own for
+ * each file, and decodes the value change blocks for only the
+ * signals of its group, so the decoding is spread across the cores
+ * and the memory holds the changes of only a few groups at a time.
+ * Without pthreads (or if a thread cannot be started) the workers
+ * run one after the other in the main thread.
+ *
+ * The exit status is 0 if the dumps match, 1 if they differ and 2
+ * if there is trouble, like cmp(1).
+ */
+
+# include  <config.h>
+# include  "fstapi.h"
+# include  <stdio.h>
+# include  <stdlib.h>
+# include  <string.h>
+# include  <unistd.h>
+# include  <assert.h>
+# include  "ivl_alloc.h"
+
+#if defined(HAVE_LIBPTHREAD) && !defined(__MINGW32__)
+#define FSTCMP_PARALLEL
+#include <pthread.h>
+#endif
+
+/* The number of signals that a worker decodes in one pass. */
+# define GROUP_SIZE 1024
+
+/*
+ * A signal in one of the files.
+ */
+struct fst_var {
+      char *name;
+      fstHandle handle;
+      uint32_t width;
+};
+
+/*
+ * A signal that is in both files, and the result of comparing it.
+ */
+struct cmp_sig {
+      const char *name;
+      fstHandle a, b;
+      int differs;
+      uint64_t time;
+      char *a_val, *b_val;
+};
+
+/*
+ * The value changes of one signal, with the values packed one after
+ * the other in a single buffer.
+ */
+struct chg_list {
+      uint64_t *time;
+      size_t *off;
+      uint32_t *len;
+      size_t cnt, alloc;
+      char *data;
+      size_t used, size;
+};
+
+static const char *path_a, *path_b;
+static uint64_t time_begin = 0, time_end = 0;
+static int have_end = 0;
+static const char **scopes = 0;
+static unsigned nscopes = 0;
+
+static struct cmp_sig *sigs = 0;
+static size_t nsigs = 0;
+
+#ifdef FSTCMP_PARALLEL
+static pthread_mutex_t next_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+static size_t next_group = 0;
+
+/*
+ * A name passes the scope filter if it is in, or below, one of the
+ * scopes given with -s. With no -s every name passes.
+ */
+static int scope_match(const char *name)
+{
+      unsigned idx;
+
+      if (nscopes == 0) return 1;
+
+      for (idx = 0 ;  idx < nscopes ;  idx += 1) {
+	    size_t len = strlen(scopes[idx]);
+	    if (strncmp(name, scopes[idx], len) == 0 &&
+	        (name[len] == '.' || name[len] == 0))
+		  return 1;
+      }
+
+      return 0;
+}
+
+static int var_compare(const void *a, const void *b)
+{
+      const struct fst_var *va = (const struct fst_var *)a;
+      const struct fst_var *vb = (const struct fst_var *)b;
+      return strcmp(va->name, vb->name);
+}
+
+/*
+ * Read the hierarchy of the file and make a sorted list of the full
+ * names of its signals. The range that the dumper adds to the name of
+ * a vector is left off, so the width is matched separately.
+ */
+static struct fst_var *read_vars(void *ctx, size_t *count)
+{
+      struct fst_var *vars = 0;
+      size_t nvars = 0, alloc = 0;
+      char *scope = 0;
+      size_t scope_len = 0, scope_alloc = 0;
+      size_t *stack = 0;
+      unsigned depth = 0, stack_alloc = 0;
+      struct fstHier *hier;
+
+      fstReaderIterateHierRewind(ctx);
+      while ((hier = fstReaderIterateHier(ctx))) {
+	    size_t len;
+	    const char *name;
+	    char *full;
+
+	    switch (hier->htyp) {
+		case FST_HT_SCOPE:
+		  if (depth == stack_alloc) {
+			stack_alloc = stack_alloc ? 2*stack_alloc : 16;
+			stack = realloc(stack, stack_alloc*sizeof(size_t));
+		  }
+		  stack[depth++] = scope_len;
+
+		  name = hier->u.scope.name;
+		  len = strlen(name);
+		  if (scope_len + len + 2 > scope_alloc) {
+			scope_alloc = 2*(scope_len + len + 2);
+			scope = realloc(scope, scope_alloc);
+		  }
+		  if (scope_len > 0) scope[scope_len++] = '.';
+		  memcpy(scope + scope_len, name, len);
+		  scope_len += len;
+		  scope[scope_len] = 0;
+		  break;
+
+		case FST_HT_UPSCOPE:
+		  assert(depth > 0);
+		  scope_len = stack[--depth];
+		  if (scope) scope[scope_len] = 0;
+		  break;
+
+		case FST_HT_VAR:
+		  name = hier->u.var.name;
+		  len = strcspn(name, " ");
+		  full = malloc(scope_len + len + 2);
+		  if (scope_len > 0) {
+			memcpy(full, scope, scope_len);
+			full[scope_len] = '.';
+			memcpy(full + scope_len + 1, name, len);
+			full[scope_len + 1 + len] = 0;
+		  } else {
+			memcpy(full, name, len);
+			full[len] = 0;
+		  }
+
+		  if (!scope_match(full)) {
+			free(full);
+			break;
+		  }
+
+		  if (nvars == alloc) {
+			alloc = alloc ? 2*alloc : 1024;
+			vars = realloc(vars, alloc*sizeof(struct fst_var));
+		  }
+		  vars[nvars].name = full;
+		  vars[nvars].handle = hier->u.var.handle;
+		  vars[nvars].width = hier->u.var.length;
+		  nvars += 1;
+		  break;
+	    }
+      }
+
+      free(scope);
+      free(stack);
+
+      qsort(vars, nvars, sizeof(struct fst_var), var_compare);
+      *count = nvars;
+      return vars;
+}
+
+static void chg_clear(struct chg_list *list)
+{
+      list->cnt = 0;
+      list->used = 0;
+}
+
+static void chg_free(struct chg_list *list)
+{
+      free(list->time);
+      free(list->off);
+      free(list->len);
+      free(list->data);
+}
+
+/*
+ * Add a value change to the list. A change to the value that the
+ * signal already has is dropped, so the values repeated at the start
+ * of each block do not count as changes.
+ */
+static void chg_add(struct chg_list *list, uint64_t time,
+                    const unsigned char *val, uint32_t len)
+{
+      if (list->cnt > 0) {
+	    size_t last = list->cnt - 1;
+	    if (list->len[last] == len &&
+	        memcmp(list->data + list->off[last], val, len) == 0)
+		  return;
+      }
+
+      if (list->cnt == list->alloc) {
+	    list->alloc = list->alloc ? 2*list->alloc : 16;
+	    list->time = realloc(list->time, list->alloc*sizeof(uint64_t));
+	    list->off = realloc(list->off, list->alloc*sizeof(size_t));
+	    list->len = realloc(list->len, list->alloc*sizeof(uint32_t));
+      }
+      if (list->used + len > list->size) {
+	    list->size = 2*(list->used + len);
+	    list->data = realloc(list->data, list->size);
+      }
+
+      list->time[list->cnt] = time;
+      list->off[list->cnt] = list->used;
+      list->len[list->cnt] = len;
+      memcpy(list->data + list->used, val, len);
+      list->used += len;
+      list->cnt += 1;
+}
+
+/*
+ * Everything a worker needs to decode one file. The slot of each
+ * handle is the index (plus one) of its change list in this pass.
+ */
+struct reader {
+      void *ctx;
+      uint32_t *slot;
+      struct chg_list *lists;
+      unsigned nlists;
+};
+
+static void value_cb(void *user, uint64_t time, fstHandle facidx,
+                     const unsigned char *value)
+{
+      struct reader *rd = (struct reader *)user;
+      uint32_t slot = rd->slot[facidx];
+      if (slot) chg_add(rd->lists + slot - 1, time, value,
+                        strlen((const char *)value));
+}
+
+static void value_varlen_cb(void *user, uint64_t time, fstHandle facidx,
+                            const unsigned char *value, uint32_t len)
+{
+      struct reader *rd = (struct reader *)user;
+      uint32_t slot = rd->slot[facidx];
+      if (slot) chg_add(rd->lists + slot - 1, time, value, len);
+}
+
+static int reader_open(struct reader *rd, const char *path)
+{
+      rd->ctx = fstReaderOpen(path);
+      if (rd->ctx == 0) return 0;
+
+      rd->slot = calloc(fstReaderGetMaxHandle(rd->ctx) + 1, sizeof(uint32_t));
+      rd->lists = calloc(GROUP_SIZE, sizeof(struct chg_list));
+      rd->nlists = 0;
+      if (have_end) fstReaderSetLimitTimeRange(rd->ctx, 0, time_end);
+      return 1;
+}
+
+static void reader_close(struct reader *rd)
+{
+      unsigned idx;
+
+      for (idx = 0 ;  idx < GROUP_SIZE ;  idx += 1)
+	    chg_free(rd->lists + idx);
+      free(rd->lists);
+      free(rd->slot);
+      fstReaderClose(rd->ctx);
+}
+
+/* Give the handle a change list and mark it to be decoded. */
+static void reader_want(struct reader *rd, fstHandle handle)
+{
+      if (rd->slot[handle]) return;
+
+      assert(rd->nlists < GROUP_SIZE);
+      rd->slot[handle] = ++rd->nlists;
+      chg_clear(rd->lists + rd->nlists - 1);
+      fstReaderSetFacProcessMask(rd->ctx, handle);
+}
+
+static const struct chg_list *reader_list(struct reader *rd,
+                                          fstHandle handle)
+{
+      return rd->lists + rd->slot[handle] - 1;
+}
+
+static char *value_string(const struct chg_list *list, size_t idx)
+{
+      char *res;
+
+      if (idx == (size_t)-1) return strdup("(none)");
+
+      res = malloc(list->len[idx] + 1);
+      memcpy(res, list->data + list->off[idx], list->len[idx]);
+      res[list->len[idx]] = 0;
+      return res;
+}
+
+static int same_value(const struct chg_list *a, size_t ia,
+                      const struct chg_list *b, size_t ib)
+{
+      if (ia == (size_t)-1 || ib == (size_t)-1) return ia == ib;
+      if (a->len[ia] != b->len[ib]) return 0;
+      return memcmp(a->data + a->off[ia], b->data + b->off[ib],
+                    a->len[ia]) == 0;
+}
+
+/*
+ * Walk the two lists of changes together, and find the first time in
+ * the time range where the signal has different values in the two
+ * files. A value holds from its change until the next change in
+ * either file, so a difference that started before the range counts
+ * from the start of the range.
+ */
+static void compare_sig(struct cmp_sig *sig, const struct chg_list *a,
+                        const struct chg_list *b)
+{
+      size_t ia = 0, ib = 0;
+      size_t cur_a = (size_t)-1, cur_b = (size_t)-1;
+
+      for (;;) {
+	    uint64_t now, next;
+	    int more_a = ia < a->cnt, more_b = ib < b->cnt;
+
+	    if (!more_a && !more_b) break;
+	    if (more_a && (!more_b || a->time[ia] <= b->time[ib]))
+		  now = a->time[ia];
+	    else
+		  now = b->time[ib];
+
+	    if (have_end && now > time_end) break;
+
+	    while (ia < a->cnt && a->time[ia] == now) cur_a = ia++;
+	    while (ib < b->cnt && b->time[ib] == now) cur_b = ib++;
+
+	    if (same_value(a, cur_a, b, cur_b)) continue;
+
+	      /* The values differ until the next change. */
+	    more_a = ia < a->cnt;
+	    more_b = ib < b->cnt;
+	    if (more_a && (!more_b || a->time[ia] <= b->time[ib]))
+		  next = a->time[ia];
+	    else if (more_b)
+		  next = b->time[ib];
+	    else
+		  next = now;
+
+	    if (next <= time_begin && (more_a || more_b)) continue;
+
+	    sig->differs = 1;
+	    sig->time = now < time_begin ? time_begin : now;
+	    sig->a_val = value_string(a, cur_a);
+	    sig->b_val = value_string(b, cur_b);
+	    return;
+      }
+}
+
+static void *worker(void *arg)
+{
+      struct reader ra, rb;
+      int *ok = (int *)arg;
+
+      if (!reader_open(&ra, path_a)) {
+	    *ok = 0;
+	    return 0;
+      }
+      if (!reader_open(&rb, path_b)) {
+	    reader_close(&ra);
+	    *ok = 0;
+	    return 0;
+      }
+
+      for (;;) {
+	    size_t first, last, idx;
+
+#ifdef FSTCMP_PARALLEL
+	    pthread_mutex_lock(&next_lock);
+#endif
+	    first = next_group;
+	    next_group += GROUP_SIZE;
+#ifdef FSTCMP_PARALLEL
+	    pthread_mutex_unlock(&next_lock);
+#endif
+
+	    if (first >= nsigs) break;
+	    last = first + GROUP_SIZE;
+	    if (last > nsigs) last = nsigs;
+
+	    fstReaderClrFacProcessMaskAll(ra.ctx);
+	    fstReaderClrFacProcessMaskAll(rb.ctx);
+	    for (idx = first ;  idx < last ;  idx += 1) {
+		  reader_want(&ra, sigs[idx].a);
+		  reader_want(&rb, sigs[idx].b);
+	    }
+
+	    fstReaderIterBlocks2(ra.ctx, value_cb, value_varlen_cb, &ra, 0);
+	    fstReaderIterBlocks2(rb.ctx, value_cb, value_varlen_cb, &rb, 0);
+
+	    for (idx = first ;  idx < last ;  idx += 1)
+		  compare_sig(sigs + idx, reader_list(&ra, sigs[idx].a),
+		              reader_list(&rb, sigs[idx].b));
+
+	    for (idx = first ;  idx < last ;  idx += 1) {
+		  ra.slot[sigs[idx].a] = 0;
+		  rb.slot[sigs[idx].b] = 0;
+	    }
+	    ra.nlists = 0;
+	    rb.nlists = 0;
+      }
+
+      reader_close(&ra);
+      reader_close(&rb);
+      return 0;
+}
+
+/*
+ * Sort the signals by handle in the first file, so that each group
+ * covers a compact range of handles.
+ */
+static int sig_handle_compare(const void *a, const void *b)
+{
+      const struct cmp_sig *sa = (const struct cmp_sig *)a;
+      const struct cmp_sig *sb = (const struct cmp_sig *)b;
+      if (sa->a != sb->a) return sa->a < sb->a ? -1 : 1;
+      return sa->b < sb->b ? -1 : sa->b > sb->b;
+}
+
+/* The differences are reported in the order that they happen. */
+static int sig_time_compare(const void *a, const void *b)
+{
+      const struct cmp_sig *sa = (const struct cmp_sig *)a;
+      const struct cmp_sig *sb = (const struct cmp_sig *)b;
+      if (sa->differs != sb->differs) return sb->differs - sa->differs;
+      if (sa->time != sb->time) return sa->time < sb->time ? -1 : 1;
+      return strcmp(sa->name, sb->name);
+}
+
+static void usage(const char *prog)
+{
+      fprintf(stderr,
+"Usage: %s [-j <jobs>] [-b <time>] [-e <time>] [-s <scope>]... <a.fst> <b.fst>\n"
+"  -j <jobs>   Decode with this many threads (default: one per core).\n"
+"  -b <time>   Ignore differences before this time.\n"
+"  -e <time>   Ignore differences after this time.\n"
+"  -s <scope>  Only compare the signals in and below this scope. This\n"
+"              may be given more than once.\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+      struct fst_var *vars_a, *vars_b;
+      size_t nvars_a, nvars_b, ia, ib, idx;
+      unsigned jobs = 0, ndiffs = 0, nmissing = 0;
+#ifdef FSTCMP_PARALLEL
+      pthread_t *threads;
+      int *started;
+#endif
+      int *ok;
+      void *ctx_a, *ctx_b;
+      int opt, rc = 0;
+
+      while ((opt = getopt(argc, argv, "b:e:hj:s:")) != -1) switch (opt) {
+	  case 'b':
+	    time_begin = strtoull(optarg, 0, 10);
+	    break;
+	  case 'e':
+	    time_end = strtoull(optarg, 0, 10);
+	    have_end = 1;
+	    break;
+	  case 'j':
+	    jobs = strtoul(optarg, 0, 10);
+	    break;
+	  case 's':
+	    scopes = realloc(scopes, (nscopes+1)*sizeof(const char *));
+	    scopes[nscopes++] = optarg;
+	    break;
+	  case 'h':
+	    usage(argv[0]);
+	    return 0;
+	  default:
+	    usage(argv[0]);
+	    return 2;
+      }
+
+      if (optind + 2 != argc) {
+	    usage(argv[0]);
+	    return 2;
+      }
+      path_a = argv[optind];
+      path_b = argv[optind+1];
+
+      if (jobs == 0) {
+#if defined(FSTCMP_PARALLEL) && defined(_SC_NPROCESSORS_ONLN)
+	    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	    jobs = cpus > 0 ? cpus : 1;
+#else
+	    jobs = 1;
+#endif
+      }
+
+      ctx_a = fstReaderOpen(path_a);
+      if (ctx_a == 0) {
+	    fprintf(stderr, "%s: unable to open %s.\n", argv[0], path_a);
+	    return 2;
+      }
+      ctx_b = fstReaderOpen(path_b);
+      if (ctx_b == 0) {
+	    fprintf(stderr, "%s: unable to open %s.\n", argv[0], path_b);
+	    fstReaderClose(ctx_a);
+	    return 2;
+      }
+
+      if (fstReaderGetTimescale(ctx_a) != fstReaderGetTimescale(ctx_b)) {
+	    fprintf(stderr, "%s: %s and %s have different time scales.\n",
+	            argv[0], path_a, path_b);
+	    fstReaderClose(ctx_a);
+	    fstReaderClose(ctx_b);
+	    return 2;
+      }
+
+      vars_a = read_vars(ctx_a, &nvars_a);
+      vars_b = read_vars(ctx_b, &nvars_b);
+      fstReaderClose(ctx_a);
+      fstReaderClose(ctx_b);
+
+	/* Match the signals by name. */
+      sigs = calloc(nvars_a < nvars_b ? nvars_a+1 : nvars_b+1,
+                    sizeof(struct cmp_sig));
+      ia = ib = 0;
+      while (ia < nvars_a || ib < nvars_b) {
+	    int cmp;
+	    if (ia == nvars_a) cmp = 1;
+	    else if (ib == nvars_b) cmp = -1;
+	    else cmp = strcmp(vars_a[ia].name, vars_b[ib].name);
+
+	    if (cmp < 0) {
+		  printf("only in %s: %s\n", path_a, vars_a[ia].name);
+		  nmissing += 1;
+		  ia += 1;
+	    } else if (cmp > 0) {
+		  printf("only in %s: %s\n", path_b, vars_b[ib].name);
+		  nmissing += 1;
+		  ib += 1;
+	    } else if (vars_a[ia].width != vars_b[ib].width) {
+		  printf("%s: width %u in %s, %u in %s\n", vars_a[ia].name,
+		         (unsigned)vars_a[ia].width, path_a,
+		         (unsigned)vars_b[ib].width, path_b);
+		  nmissing += 1;
+		  ia += 1;
+		  ib += 1;
+	    } else {
+		  sigs[nsigs].name = vars_a[ia].name;
+		  sigs[nsigs].a = vars_a[ia].handle;
+		  sigs[nsigs].b = vars_b[ib].handle;
+		  nsigs += 1;
+		  ia += 1;
+		  ib += 1;
+	    }
+      }
+
+      qsort(sigs, nsigs, sizeof(struct cmp_sig), sig_handle_compare);
+
+      if (jobs > (nsigs + GROUP_SIZE - 1) / GROUP_SIZE)
+	    jobs = (nsigs + GROUP_SIZE - 1) / GROUP_SIZE;
+      if (jobs == 0) jobs = 1;
+
+      ok = calloc(jobs, sizeof(int));
+#ifdef FSTCMP_PARALLEL
+	/* A worker that cannot be started runs here instead. The groups
+	   are shared, so the other workers just take more of them. */
+      threads = calloc(jobs, sizeof(pthread_t));
+      started = calloc(jobs, sizeof(int));
+      for (idx = 0 ;  idx < jobs ;  idx += 1) {
+	    ok[idx] = 1;
+	    started[idx] = pthread_create(threads + idx, 0, worker,
+	                                  ok + idx) == 0;
+	    if (!started[idx]) worker(ok + idx);
+      }
+      for (idx = 0 ;  idx < jobs ;  idx += 1) {
+	    if (started[idx]) pthread_join(threads[idx], 0);
+	    if (!ok[idx]) rc = 2;
+      }
+      free(threads);
+      free(started);
+#else
+      for (idx = 0 ;  idx < jobs ;  idx += 1) {
+	    ok[idx] = 1;
+	    worker(ok + idx);
+	    if (!ok[idx]) rc = 2;
+      }
+#endif
+      free(ok);
+
+      if (rc) {
+	    fprintf(stderr, "%s: unable to read the dump files.\n", argv[0]);
+      } else {
+	    qsort(sigs, nsigs, sizeof(struct cmp_sig), sig_time_compare);
+	    for (idx = 0 ;  idx < nsigs && sigs[idx].differs ;  idx += 1) {
+		  printf("%s: differs at %llu, %s in %s, %s in %s\n",
+		         sigs[idx].name, (unsigned long long)sigs[idx].time,
+		         sigs[idx].a_val, path_a, sigs[idx].b_val, path_b);
+		  ndiffs += 1;
+	    }
+
+	    if (ndiffs || nmissing) {
+		  printf("%s and %s differ: %u of %lu signals have different "
+		         "values, %u are not matched.\n", path_a, path_b,
+		         ndiffs, (unsigned long)nsigs, nmissing);
+		  rc = 1;
+	    }
+      }
+
+      for (idx = 0 ;  idx < nsigs ;  idx += 1) {
+	    free(sigs[idx].a_val);
+	    free(sigs[idx].b_val);
+      }
+      free(sigs);
+      for (idx = 0 ;  idx < nvars_a ;  idx += 1) free(vars_a[idx].name);
+      for (idx = 0 ;  idx < nvars_b ;  idx += 1) free(vars_b[idx].name);
+      free(vars_a);
+      free(vars_b);
+      free(scopes);
+
+      return rc;
+}
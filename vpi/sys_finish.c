@@ -18,6 +18,7 @@
  */
 
 #include "sys_priv.h"
+#include "vcd_priv.h"
 #include <string.h>
 
 static PLI_INT32 sys_finish_calltf(ICARUS_VPI_CONST PLI_BYTE8 *name)
@@ -38,6 +39,8 @@ static PLI_INT32 sys_finish_calltf(ICARUS_VPI_CONST PLI_BYTE8 *name)
       }
 
       if (strcmp((const char*)name, "$stop") == 0) {
+	      /* Write out the dumper's flight recorder, if it has one. */
+	    if (vcd_dump_trigger) vcd_dump_trigger();
 	    vpi_control(vpiStop, diag_msg);
 	    return 0;
       }
@@ -33,27 +33,53 @@
 # include  "ivl_alloc.h"
 
 static char *dump_path = NULL;
-static struct fstContext *dump_file = NULL;
+
+/*
+ * The dump normally goes to a single FST file. With +dumpshards=<n>
+ * the dumped scopes are instead spread over <n> files, each with its
+ * own writer (and writer thread), and an index file lists the scopes
+ * that went into each file. Each shard file has only the scopes that
+ * have signals in it and their parent scopes.
+ */
+struct fst_shard {
+      struct fstContext *file;
+      char *path;
+	/* The number of scope_stack entries open in this file. */
+      unsigned depth;
+};
+
+static struct fst_shard *dump_shards = NULL;
+static unsigned dump_shard_count = 1;
+static unsigned next_shard = 0;
+static FILE *shard_index = NULL;
 
 struct vcd_info {
       vpiHandle item;
       vpiHandle cb;
       struct t_vpi_time time;
       struct vcd_info *next;
-      struct vcd_info *dmp_next;
+      struct fstContext *file;
       fstHandle handle;
-      int scheduled;
+	/* The flight recorder keeps the oldest value it still knows
+	 * here. */
+      char *base;
+      unsigned base_len;
 };
 
 
 static struct vcd_info *vcd_list = NULL;
-static struct vcd_info *vcd_dmp_list = NULL;
 static PLI_UINT64 vcd_cur_time = 0;
 static int dump_is_off = 0;
 static long dump_limit = 0;
 static int dump_is_full = 0;
 static int finish_status = 0;
 
+	/* The flight recorder, if it is enabled and not yet triggered. */
+static struct vcd_ring_s *dump_ring = NULL;
+static size_t ring_size = 0;
+static PLI_UINT64 ring_window = 0;
+static int ring_enabled = 0;
+
 
 static enum lxm_optimum_mode_e {
       LXM_NONE  = 0,
@@ -71,6 +97,15 @@ static const char*units_names[] = {
       "fs"
 };
 
+/*
+ * Write a value change, or record it if the flight recorder is on.
+ */
+static void emit_value(struct vcd_info*info, const void*data, unsigned len)
+{
+      if (dump_ring) vcd_ring_add(dump_ring, vcd_cur_time, info, data, len);
+      else fstWriterEmitValueChange(info->file, info->handle, data);
+}
+
 static void show_this_item(struct vcd_info*info)
 {
       s_vpi_value value;
@@ -79,11 +114,11 @@ static void show_this_item(struct vcd_info*info)
       if (type == vpiRealVar) {
 	    value.format = vpiRealVal;
 	    vpi_get_value(info->item, &value);
-	    fstWriterEmitValueChange(dump_file, info->handle, &value.value.real);
+	    emit_value(info, &value.value.real, sizeof(double));
       } else {
 	    value.format = vpiBinStrVal;
 	    vpi_get_value(info->item, &value);
-	    fstWriterEmitValueChange(dump_file, info->handle, value.value.str);
+	    emit_value(info, value.value.str, strlen(value.value.str));
       }
 }
 
@@ -95,18 +130,223 @@ static void show_this_item_x(struct vcd_info*info)
       if (type == vpiRealVar) {
 	      /* Some tools dump nothing here...? */
             double mynan = strtod("NaN", NULL);
-	    fstWriterEmitValueChange(dump_file, info->handle, &mynan);
+	    emit_value(info, &mynan, sizeof(double));
       } else if (type == vpiNamedEvent) {
 	    /* Do nothing for named events. */
       } else {
 	    int siz = vpi_get(vpiSize, info->item);
 	    char *xmem = malloc(siz);
 	    memset(xmem, 'x', siz);
-	    fstWriterEmitValueChange(dump_file, info->handle, xmem);
+	    emit_value(info, xmem, siz);
 	    free(xmem);
       }
 }
 
+/*
+ * The time changes and $dumpon/$dumpoff go to every shard. The flight
+ * recorder only records value changes, so these do nothing while it
+ * is on.
+ */
+static void emit_time_change(PLI_UINT64 now)
+{
+      unsigned idx;
+
+      if (dump_ring) return;
+
+      for (idx = 0 ;  idx < dump_shard_count ;  idx += 1)
+	    fstWriterEmitTimeChange(dump_shards[idx].file, now);
+}
+
+static void emit_dump_active(int enable)
+{
+      unsigned idx;
+
+      if (dump_ring) return;
+
+      for (idx = 0 ;  idx < dump_shard_count ;  idx += 1)
+	    fstWriterEmitDumpActive(dump_shards[idx].file, enable);
+}
+
+/* The dump is full when any one of the shards reaches the limit. */
+static int dump_limit_reached(void)
+{
+      unsigned idx;
+
+      for (idx = 0 ;  idx < dump_shard_count ;  idx += 1) {
+	    if (fstWriterGetDumpSizeLimitReached(dump_shards[idx].file))
+		  return 1;
+      }
+
+      return 0;
+}
+
+/*
+ * The flight recorder calls this with the records that fall out of
+ * the ring. Keep the value as the base value of the signal.
+ */
+static void ring_evict(void*ptr, const char*data, unsigned len)
+{
+      struct vcd_info*info = (struct vcd_info*)ptr;
+
+      if (len > info->base_len || info->base == 0)
+	    info->base = realloc(info->base, len);
+      memcpy(info->base, data, len);
+      info->base_len = len;
+}
+
+static PLI_UINT64 ring_last_time;
+static int ring_wrote_time;
+
+static void ring_emit(PLI_UINT64 time, void*ptr, const char*data,
+                      unsigned len)
+{
+      struct vcd_info*info = (struct vcd_info*)ptr;
+
+      (void)len;
+      if (!ring_wrote_time || time != ring_last_time) {
+	    emit_time_change(time);
+	    ring_last_time = time;
+	    ring_wrote_time = 1;
+      }
+      fstWriterEmitValueChange(info->file, info->handle, data);
+}
+
+/*
+ * Write out the flight recorder and go back to normal dumping. The
+ * base values are written at the base time, and then the recorded
+ * changes.
+ */
+static void fst_trigger(struct vcd_info*list)
+{
+      struct vcd_ring_s*ring = dump_ring;
+      struct vcd_info*cur;
+      PLI_UINT64 base_time;
+
+      if (ring == 0) return;
+      dump_ring = 0;
+
+      vpi_printf("FST info: writing the flight recorder at time %"
+                 PLI_UINT64_FMT ".\n", vcd_cur_time);
+
+      ring_wrote_time = 0;
+      if (vcd_ring_base_time(ring, &base_time)) {
+	    emit_time_change(base_time);
+	    ring_last_time = base_time;
+	    ring_wrote_time = 1;
+	    for (cur = list ;  cur ;  cur = cur->next) {
+		  if (cur->base)
+			fstWriterEmitValueChange(cur->file, cur->handle,
+			                         cur->base);
+	    }
+      }
+
+      vcd_ring_drain(ring, ring_emit);
+      vcd_ring_delete(ring);
+
+	/* The following changes are at the current time. */
+      if (!ring_wrote_time || ring_last_time != vcd_cur_time)
+	    emit_time_change(vcd_cur_time);
+}
+
+/*
+ * The scopes are pushed on this stack as $dumpvars walks the design,
+ * and are only written into a shard file when a signal is put in that
+ * file. The scopes open in a file are always the bottom of the stack.
+ */
+struct fst_scope {
+      PLI_INT32 type;
+      char *name;
+      char *defname;
+      char *fullname;
+	/* The shard that the signals of this scope go to, or -1 if
+	 * it has no signals yet. */
+      int shard;
+};
+
+static struct fst_scope *scope_stack = NULL;
+static unsigned scope_depth = 0;
+static unsigned scope_alloc = 0;
+
+static void open_shard_scopes(struct fst_shard *shard)
+{
+      while (shard->depth < scope_depth) {
+	    struct fst_scope *cur = scope_stack + shard->depth;
+	    fstWriterSetScope(shard->file, (enum fstScopeType)cur->type,
+	                      cur->name, cur->defname);
+	    shard->depth += 1;
+      }
+}
+
+static void push_scope(PLI_INT32 type, const char *name, const char *defname,
+                       const char *fullname)
+{
+      struct fst_scope *cur;
+
+      if (scope_depth == scope_alloc) {
+	    scope_alloc += 16;
+	    scope_stack = realloc(scope_stack,
+	                          scope_alloc * sizeof(struct fst_scope));
+      }
+
+      cur = scope_stack + scope_depth;
+      cur->type = type;
+      cur->name = strdup(name);
+      cur->defname = defname ? strdup(defname) : NULL;
+      cur->fullname = strdup(fullname);
+      cur->shard = -1;
+      scope_depth += 1;
+
+	/* A single file gets every scope, even empty ones. */
+      if (dump_shard_count == 1) open_shard_scopes(dump_shards);
+}
+
+static void pop_scope(void)
+{
+      struct fst_scope *cur;
+      unsigned idx;
+
+      assert(scope_depth > 0);
+      scope_depth -= 1;
+      cur = scope_stack + scope_depth;
+
+      for (idx = 0 ;  idx < dump_shard_count ;  idx += 1) {
+	    if (dump_shards[idx].depth > scope_depth) {
+		  fstWriterSetUpscope(dump_shards[idx].file);
+		  dump_shards[idx].depth = scope_depth;
+	    }
+      }
+
+      free(cur->name);
+      free(cur->defname);
+      free(cur->fullname);
+}
+
+/*
+ * Get the shard for a signal in the current scope, and make sure the
+ * scope is open in that shard. The scopes are given to the shards in
+ * turn as their first signal is found.
+ */
+static struct fst_shard *current_shard(void)
+{
+      struct fst_shard *shard;
+      struct fst_scope *cur;
+
+      assert(scope_depth > 0);
+      cur = scope_stack + scope_depth - 1;
+
+      if (cur->shard < 0) {
+	    cur->shard = next_shard;
+	    next_shard = (next_shard + 1) % dump_shard_count;
+	    if (shard_index) {
+		  fprintf(shard_index, "scope %d %s\n", cur->shard,
+		          cur->fullname);
+	    }
+      }
+
+      shard = dump_shards + cur->shard;
+      open_shard_scopes(shard);
+      return shard;
+}
 
 /*
  * managed qsorted list of scope names/variables for duplicates bsearching
@@ -143,53 +383,39 @@ static void vcd_checkpoint_x()
 	    show_this_item_x(cur);
 }
 
-static PLI_INT32 variable_cb_2(p_cb_data cause)
+/*
+ * The value changes of all the dumped signals come in one batch at
+ * the end of each time step. The batch lists the signals in the order
+ * that they first changed, so walk it backwards to write the values
+ * in the order that they have always been written.
+ */
+static PLI_INT32 variable_cb(p_cb_data cause)
 {
-      struct vcd_info* info = vcd_dmp_list;
+      struct vcd_info**list = (struct vcd_info**)cause->user_data;
       PLI_UINT64 now = timerec_to_time64(cause->time);
-
-      if (now != vcd_cur_time) {
-	    fstWriterEmitTimeChange(dump_file, now);
-	    vcd_cur_time = now;
-      }
-
-      do {
-           show_this_item(info);
-           info->scheduled = 0;
-      } while ((info = info->dmp_next) != 0);
-
-      vcd_dmp_list = 0;
-
-      return 0;
-}
-
-static PLI_INT32 variable_cb_1(p_cb_data cause)
-{
-      struct t_cb_data cb;
-      struct vcd_info*info = (struct vcd_info*)cause->user_data;
+      PLI_INT32 idx;
 
       if (dump_is_full) return 0;
       if (dump_is_off) return 0;
       if (dump_header_pending()) return 0;
-      if (info->scheduled) return 0;
 
-      if ((dump_limit > 0) && fstWriterGetDumpSizeLimitReached(dump_file)) {
+	/* The $dumpvars checkpoint already has the values at its time. */
+      if (now == dumpvars_time) return 0;
+
+      if ((dump_limit > 0) && dump_limit_reached()) {
             dump_is_full = 1;
             vpi_printf("WARNING: Dump file limit (%ld bytes) "
                                "exceeded.\n", dump_limit);
             return 0;
       }
 
-      if (!vcd_dmp_list) {
-          cb = *cause;
-          cb.reason = cbReadOnlySynch;
-          cb.cb_rtn = variable_cb_2;
-          vpi_register_cb(&cb);
+      if (now != vcd_cur_time) {
+	    emit_time_change(now);
+	    vcd_cur_time = now;
       }
 
-      info->scheduled = 1;
-      info->dmp_next  = vcd_dmp_list;
-      vcd_dmp_list    = info;
+      for (idx = cause->index ;  idx > 0 ;  idx -= 1)
+	    show_this_item(list[idx-1]);
 
       return 0;
 }
@@ -206,7 +432,7 @@ static PLI_INT32 dumpvars_cb(p_cb_data cause)
       /* nothing to do for $enddefinitions $end */
 
       if (!dump_is_off) {
-	    fstWriterEmitTimeChange(dump_file, dumpvars_time);
+	    emit_time_change(dumpvars_time);
 	    /* nothing to do for  $dumpvars... */
 	    vcd_checkpoint();
 	    /* ...nothing to do for $end */
@@ -218,6 +444,7 @@ static PLI_INT32 dumpvars_cb(p_cb_data cause)
 static PLI_INT32 finish_cb(p_cb_data cause)
 {
       struct vcd_info *cur, *next;
+      unsigned idx;
 
       if (finish_status != 0) return 0;
 
@@ -225,20 +452,40 @@ static PLI_INT32 finish_cb(p_cb_data cause)
 
       dumpvars_time = timerec_to_time64(cause->time);
 
-      if (!dump_is_off && !dump_is_full && dumpvars_time != vcd_cur_time) {
-	    fstWriterEmitTimeChange(dump_file, dumpvars_time);
+	/* A flight recorder that was not triggered is thrown away. */
+      if (dump_ring) {
+	    vcd_ring_delete(dump_ring);
+	    dump_ring = 0;
+      } else if (!dump_is_off && !dump_is_full &&
+                 dumpvars_time != vcd_cur_time) {
+	    emit_time_change(dumpvars_time);
       }
 
-      fstWriterClose(dump_file);
+      for (idx = 0 ;  idx < dump_shard_count ;  idx += 1) {
+	    fstWriterClose(dump_shards[idx].file);
+	    free(dump_shards[idx].path);
+      }
+      free(dump_shards);
+      dump_shards = 0;
+      if (shard_index) {
+	    fclose(shard_index);
+	    shard_index = 0;
+      }
+      free(scope_stack);
+      scope_stack = 0;
+      scope_alloc = 0;
 
       for (cur = vcd_list ;  cur ;  cur = next) {
 	    next = cur->next;
+	    free(cur->base);
 	    free(cur);
       }
       vcd_list = 0;
       vcd_names_delete(&fst_tab);
       vcd_names_delete(&fst_var);
+      nexus_ident_stats("FST");
       nexus_ident_delete();
+      vcd_filter_delete();
       free(dump_path);
       dump_path = 0;
 
@@ -286,7 +533,7 @@ static PLI_INT32 sys_dumpoff_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
 
       dump_is_off = 1;
 
-      if (dump_file == 0) return 0;
+      if (dump_shards == 0) return 0;
       if (dump_header_pending()) return 0;
 
       now.type = vpiSimTime;
@@ -294,11 +541,11 @@ static PLI_INT32 sys_dumpoff_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
       now64 = timerec_to_time64(&now);
 
       if (now64 > vcd_cur_time) {
-	    fstWriterEmitTimeChange(dump_file, now64);
+	    emit_time_change(now64);
 	    vcd_cur_time = now64;
       }
 
-      fstWriterEmitDumpActive(dump_file, 0); /* $dumpoff */
+      emit_dump_active(0); /* $dumpoff */
       vcd_checkpoint_x();
 
       return 0;
@@ -313,7 +560,7 @@ static PLI_INT32 sys_dumpon_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
 
       dump_is_off = 0;
 
-      if (dump_file == 0) return 0;
+      if (dump_shards == 0) return 0;
       if (dump_header_pending()) return 0;
 
       now.type = vpiSimTime;
@@ -321,11 +568,11 @@ static PLI_INT32 sys_dumpon_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
       now64 = timerec_to_time64(&now);
 
       if (now64 > vcd_cur_time) {
-	    fstWriterEmitTimeChange(dump_file, now64);
+	    emit_time_change(now64);
 	    vcd_cur_time = now64;
       }
 
-      fstWriterEmitDumpActive(dump_file, 1); /* $dumpon */
+      emit_dump_active(1); /* $dumpon */
       vcd_checkpoint();
 
       return 0;
@@ -337,7 +584,7 @@ static PLI_INT32 sys_dumpall_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
       PLI_UINT64 now64;
 
       if (dump_is_off) return 0;
-      if (dump_file == 0) return 0;
+      if (dump_shards == 0) return 0;
       if (dump_header_pending()) return 0;
 
       now.type = vpiSimTime;
@@ -345,7 +592,7 @@ static PLI_INT32 sys_dumpall_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
       now64 = timerec_to_time64(&now);
 
       if (now64 > vcd_cur_time) {
-	    fstWriterEmitTimeChange(dump_file, now64);
+	    emit_time_change(now64);
 	    vcd_cur_time = now64;
       }
 
@@ -355,54 +602,128 @@ static PLI_INT32 sys_dumpall_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
       return 0;
 }
 
-static void open_dumpfile(vpiHandle callh)
+static struct fstContext *open_fst_file(const char *path)
 {
-      if (dump_path == 0) dump_path = strdup("dump.fst");
+      struct fstContext *file = fstWriterCreate(path, 1);
+      int prec = vpi_get(vpiTimePrecision, 0);
+      unsigned scale = 1;
+      unsigned udx = 0;
+      time_t walltime;
+      char scale_buf[65];
 
-      dump_file = fstWriterCreate(dump_path, 1);
+      if (file == 0) return 0;
 
-      if (dump_file == 0) {
-	    vpi_printf("FST Error: %s:%d: ", vpi_get_str(vpiFile, callh),
-	               (int)vpi_get(vpiLineNo, callh));
-	    vpi_printf("Unable to open %s for output.\n", dump_path);
-	    vpi_control(vpiFinish, 1);
-	    return;
-      } else {
-	    int prec = vpi_get(vpiTimePrecision, 0);
-	    unsigned scale = 1;
-	    unsigned udx = 0;
-	    time_t walltime;
-	    char scale_buf[65];
+      vpi_printf("FST info: dumpfile %s opened for output.\n", path);
 
-	    vpi_printf("FST info: dumpfile %s opened for output.\n",
-	               dump_path);
+      time(&walltime);
 
-	    time(&walltime);
+      assert(prec >= -15);
+      while (prec < 0) {
+	    udx += 1;
+	    prec += 3;
+      }
+      while (prec > 0) {
+	    scale *= 10;
+	    prec -= 1;
+      }
 
-	    assert(prec >= -15);
-	    while (prec < 0) {
-		  udx += 1;
-		  prec += 3;
-	    }
-	    while (prec > 0) {
-		  scale *= 10;
-		  prec -= 1;
-	    }
+      fstWriterSetDate(file, asctime(localtime(&walltime)));
+      fstWriterSetVersion(file, "Icarus Verilog");
+      sprintf(scale_buf, "\t%u%s\n", scale, units_names[udx]);
+      fstWriterSetTimescaleFromString(file, scale_buf);
+	/* Set the faster dump type when requested. */
+      if ((lxm_optimum_mode == LXM_SPEED) ||
+          (lxm_optimum_mode == LXM_BOTH)) {
+	    fstWriterSetPackType(file, 1);
+      }
+	/* Set the most effective compression when requested. */
+      if ((lxm_optimum_mode == LXM_SPACE) ||
+          (lxm_optimum_mode == LXM_BOTH)) {
+	    fstWriterSetRepackOnClose(file, 1);
+      }
+	/* Compress and write the value change blocks from a
+	   background thread, when the platform has threads. */
+      fstWriterSetParallelMode(file, 1);
 
-	    fstWriterSetDate(dump_file, asctime(localtime(&walltime)));
-	    fstWriterSetVersion(dump_file, "Icarus Verilog");
-	    sprintf(scale_buf, "\t%u%s\n", scale, units_names[udx]);
-	    fstWriterSetTimescaleFromString(dump_file, scale_buf);
-	      /* Set the faster dump type when requested. */
-	    if ((lxm_optimum_mode == LXM_SPEED) ||
-	        (lxm_optimum_mode == LXM_BOTH)) {
-		  fstWriterSetPackType(dump_file, 1);
+      return file;
+}
+
+/*
+ * The shard files are named from the dump file name, so dump.fst is
+ * split into dump_0.fst, dump_1.fst... and the index is dump.shards.
+ */
+static char *shard_file_name(const char *suffix, unsigned idx)
+{
+      size_t len = strlen(dump_path);
+      char *res = malloc(len + 32);
+
+      if (len > 4 && strcmp(dump_path + len - 4, ".fst") == 0) len -= 4;
+      memcpy(res, dump_path, len);
+      if (suffix) strcpy(res + len, suffix);
+      else sprintf(res + len, "_%u.fst", idx);
+      return res;
+}
+
+/* $dumptrigger and $stop write out the flight recorder. */
+static void dump_trigger(void)
+{
+      if (dump_shards && !dump_header_pending()) fst_trigger(vcd_list);
+}
+
+static void open_dumpfile(vpiHandle callh)
+{
+      unsigned idx;
+
+      if (dump_path == 0) dump_path = strdup("dump.fst");
+
+      dump_shards = calloc(dump_shard_count, sizeof(struct fst_shard));
+
+      for (idx = 0 ;  idx < dump_shard_count ;  idx += 1) {
+	    struct fst_shard *shard = dump_shards + idx;
+
+	    if (dump_shard_count == 1) shard->path = strdup(dump_path);
+	    else shard->path = shard_file_name(0, idx);
+	    shard->file = open_fst_file(shard->path);
+
+	    if (shard->file == 0) {
+		  vpi_printf("FST Error: %s:%d: ",
+		             vpi_get_str(vpiFile, callh),
+		             (int)vpi_get(vpiLineNo, callh));
+		  vpi_printf("Unable to open %s for output.\n",
+		             shard->path);
+		  while (idx > 0) {
+			idx -= 1;
+			fstWriterClose(dump_shards[idx].file);
+			free(dump_shards[idx].path);
+		  }
+		  free(shard->path);
+		  free(dump_shards);
+		  dump_shards = 0;
+		  vpi_control(vpiFinish, 1);
+		  return;
 	    }
-	      /* Set the most effective compression when requested. */
-	    if ((lxm_optimum_mode == LXM_SPACE) ||
-	        (lxm_optimum_mode == LXM_BOTH)) {
-		  fstWriterSetRepackOnClose(dump_file, 1);
+      }
+
+      if (dump_shard_count > 1) {
+	    char *index_path = shard_file_name(".shards", 0);
+	    shard_index = fopen(index_path, "w");
+	    if (shard_index == 0) {
+		  vpi_printf("FST warning: Unable to open shard index %s "
+		             "for output.\n", index_path);
+	    } else {
+		  fprintf(shard_index, "shards %u\n", dump_shard_count);
+		  for (idx = 0 ;  idx < dump_shard_count ;  idx += 1)
+			fprintf(shard_index, "file %u %s\n", idx,
+			        dump_shards[idx].path);
 	    }
+	    free(index_path);
+      }
+
+      if (ring_enabled) {
+	    dump_ring = vcd_ring_create(ring_size, ring_window, ring_evict);
+	    vcd_dump_trigger = dump_trigger;
+	    vpi_printf("FST info: flight recorder is on, the dump "
+	               "is written by $dumptrigger or $stop.\n");
       }
 }
 
@@ -441,9 +762,21 @@ static PLI_INT32 sys_dumpfile_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
       return 0;
 }
 
+static PLI_INT32 sys_dumptrigger_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
+{
+      dump_trigger();
+
+      return 0;
+}
+
 static PLI_INT32 sys_dumpflush_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
 {
-      if (dump_file) fstWriterFlushContext(dump_file);
+      unsigned idx;
+
+      if (dump_shards == 0) return 0;
+
+      for (idx = 0 ;  idx < dump_shard_count ;  idx += 1)
+	    fstWriterFlushContext(dump_shards[idx].file);
 
       return 0;
 }
@@ -453,97 +786,198 @@ static PLI_INT32 sys_dumplimit_calltf(ICARUS_VPI_CONST PLI_BYTE8 *name)
       vpiHandle callh = vpi_handle(vpiSysTfCall, 0);
       vpiHandle argv = vpi_iterate(vpiArgument, callh);
       s_vpi_value val;
+      unsigned idx;
 
-      /* Get the value and set the dump limit. */
+      /* Get the value and set the dump limit. The limit is for each
+       * shard file. */
       val.format = vpiIntVal;
       vpi_get_value(vpi_scan(argv), &val);
       dump_limit = val.value.integer;
-      fstWriterSetDumpSizeLimit(dump_file, dump_limit);
+      if (dump_shards) {
+	    for (idx = 0 ;  idx < dump_shard_count ;  idx += 1)
+		  fstWriterSetDumpSizeLimit(dump_shards[idx].file, dump_limit);
+      }
 
       vpi_free_object(argv);
       return 0;
 }
 
-static void scan_item(unsigned depth, vpiHandle item, int skip)
+/*
+ * Get the FST type for the various var and scope types, or -1 if the
+ * type is not supported. Not all of these are supported now, but they
+ * should be in a future development version.
+ */
+static PLI_INT32 item_fst_type(PLI_INT32 item_type, PLI_INT32 net_type)
 {
-      struct t_cb_data cb;
-      struct vcd_info* info;
-
-      PLI_INT32 type;
-      const char *name;
-      const char *fullname;
-      char *escname;
-      const char *ident;
-      fstHandle new_ident;
-      int nexus_id;
-      unsigned size;
-      PLI_INT32 item_type;
-
-      /* list of types to iterate upon */
-      int i;
-      static int types[] = {
-	    /* Value */
-	    vpiNamedEvent,
-	    vpiNet,
-//	    vpiParameter,
-	    vpiReg,
-	    vpiVariables,
-	    /* Scope */
-	    vpiFunction,
-	    vpiModule,
-	    vpiNamedBegin,
-	    vpiNamedFork,
-	    vpiTask,
-	    -1
-      };
-
-	/* Get the displayed type for the various $var and $scope types. */
-	/* Not all of these are supported now, but they should be in a
-	 * future development version. */
-      item_type = vpi_get(vpiType, item);
       switch (item_type) {
-	  case vpiNamedEvent: type = FST_VT_VCD_EVENT; break;
+	  case vpiNamedEvent: return FST_VT_VCD_EVENT;
 	  case vpiIntVar:
-	  case vpiIntegerVar: type = FST_VT_VCD_INTEGER; break;
-	  case vpiParameter:  type = FST_VT_VCD_PARAMETER; break;
+	  case vpiIntegerVar: return FST_VT_VCD_INTEGER;
+	  case vpiParameter:  return FST_VT_VCD_PARAMETER;
 	    /* Icarus converts realtime to real. */
-	  case vpiRealVar:    type = FST_VT_VCD_REAL; break;
+	  case vpiRealVar:    return FST_VT_VCD_REAL;
 	  case vpiMemoryWord:
 	  case vpiBitVar:
 	  case vpiByteVar:
 	  case vpiShortIntVar:
 	  case vpiLongIntVar:
-	  case vpiReg:        type = FST_VT_VCD_REG; break;
+	  case vpiReg:        return FST_VT_VCD_REG;
 	    /* Icarus converts a time to a plain register. */
-	  case vpiTimeVar:    type = FST_VT_VCD_TIME; break;
+	  case vpiTimeVar:    return FST_VT_VCD_TIME;
 	  case vpiNet:
-	    switch (vpi_get(vpiNetType, item)) {
-		case vpiWand:    type = FST_VT_VCD_WAND; break;
-		case vpiWor:     type = FST_VT_VCD_WOR; break;
-		case vpiTri:     type = FST_VT_VCD_TRI; break;
-		case vpiTri0:    type = FST_VT_VCD_TRI0; break;
-		case vpiTri1:    type = FST_VT_VCD_TRI1; break;
-		case vpiTriReg:  type = FST_VT_VCD_TRIREG; break;
-		case vpiTriAnd:  type = FST_VT_VCD_TRIAND; break;
-		case vpiTriOr:   type = FST_VT_VCD_TRIOR; break;
-		case vpiSupply1: type = FST_VT_VCD_SUPPLY1; break;
-		case vpiSupply0: type = FST_VT_VCD_SUPPLY0; break;
-		default:         type = FST_VT_VCD_WIRE; break;
+	    switch (net_type) {
+		case vpiWand:    return FST_VT_VCD_WAND;
+		case vpiWor:     return FST_VT_VCD_WOR;
+		case vpiTri:     return FST_VT_VCD_TRI;
+		case vpiTri0:    return FST_VT_VCD_TRI0;
+		case vpiTri1:    return FST_VT_VCD_TRI1;
+		case vpiTriReg:  return FST_VT_VCD_TRIREG;
+		case vpiTriAnd:  return FST_VT_VCD_TRIAND;
+		case vpiTriOr:   return FST_VT_VCD_TRIOR;
+		case vpiSupply1: return FST_VT_VCD_SUPPLY1;
+		case vpiSupply0: return FST_VT_VCD_SUPPLY0;
+		default:         return FST_VT_VCD_WIRE;
 	    }
-	    break;
 
-	  case vpiNamedBegin: type = FST_ST_VCD_BEGIN; break;
-	  case vpiNamedFork:  type = FST_ST_VCD_FORK; break;
-	  case vpiFunction:   type = FST_ST_VCD_FUNCTION; break;
-	  case vpiModule:     type = FST_ST_VCD_MODULE; break;
-	  case vpiTask:       type = FST_ST_VCD_TASK; break;
+	  case vpiNamedBegin: return FST_ST_VCD_BEGIN;
+	  case vpiNamedFork:  return FST_ST_VCD_FORK;
+	  case vpiFunction:   return FST_ST_VCD_FUNCTION;
+	  case vpiModule:     return FST_ST_VCD_MODULE;
+	  case vpiTask:       return FST_ST_VCD_TASK;
+      }
 
-	  default:
+      return -1;
+}
+
+static int is_scope_type(PLI_INT32 item_type)
+{
+      switch (item_type) {
+	  case vpiModule:
+	  case vpiNamedBegin:
+	  case vpiTask:
+	  case vpiFunction:
+	  case vpiNamedFork:
+	    return 1;
+      }
+      return 0;
+}
+
+/* Create the FST var for a signal and add its callback. */
+static void scan_var(const s_vpip_hier_item *it, int skip)
+{
+      struct t_cb_data cb;
+      struct vcd_info* info;
+      PLI_INT32 type = item_fst_type(it->type, it->net_type);
+      char *escname;
+      struct vcd_info *alias;
+      struct fst_shard *shard;
+      fstHandle new_ident;
+      unsigned size;
+
+	/* If we are skipping all signal or this is in an automatic
+	 * scope then just return. */
+      if (skip || it->automatic) return;
+
+	/* Skip this signal if it has already been included. This can
+	 * only happen for implicitly given signals, so the full name
+	 * is only needed when some have been given or there is a dump
+	 * filter. */
+      if (vcd_filter_active ||
+          fst_var.listed_names || fst_var.sorted_names) {
+	    const char *fullname = vpi_get_str(vpiFullName, it->obj);
+	    if (!vcd_filter_signal(it->obj, fullname, it->type,
+	                           it->type == vpiNamedEvent ? 1 : it->size))
+		  return;
+	    if (vcd_names_search(&fst_var, fullname)) return;
+      }
+
+	/* Declare the variable in the FST file. */
+      if (is_escaped_id(it->name)) {
+	    escname = malloc(strlen(it->name) + 2);
+	    sprintf(escname, "\\%s", it->name);
+      } else escname = strdup(it->name);
+
+      shard = current_shard();
+
+	/* Some signals can have an alias so handle that. The alias can
+	 * only be used if it is in the same shard. */
+      alias = (struct vcd_info*)find_nexus_ident(it->nexus_id);
+      if (alias && alias->file != shard->file) alias = 0;
+
+	/* Named events do not have a size, but other tools use a size
+	 * of 1 and some viewers do not accept a width of zero so we
+	 * will also use a width of one for events. */
+      if (it->type == vpiNamedEvent) size = 1;
+      else size = it->size;
+
+      if (size > 1 || it->left_range != 0) {
+	    char *buf = malloc(strlen(escname) + 65);
+	    sprintf(buf, "%s [%i:%i]", escname,
+	            (int)it->left_range, (int)it->right_range);
+
+	    new_ident = fstWriterCreateVar(shard->file, type,
+	                                   FST_VD_IMPLICIT, size, buf,
+	                                   alias ? alias->handle : 0);
+	    free(buf);
+      } else {
+	    new_ident = fstWriterCreateVar(shard->file, type,
+	                                   FST_VD_IMPLICIT, size, escname,
+	                                   alias ? alias->handle : 0);
+      }
+      free(escname);
+
+      if (!alias) {
+	      /* Add a callback for the signal. */
+	    info = malloc(sizeof(*info));
+
+	    set_nexus_ident(it->nexus_id, info);
+
+	    info->time.type = vpiSimTime;
+	    info->item  = it->obj;
+	    info->file  = shard->file;
+	    info->handle = new_ident;
+	    info->base  = 0;
+	    info->base_len = 0;
+
+	    cb.time      = &info->time;
+	    cb.user_data = (char*)info;
+	    cb.value     = NULL;
+	    cb.obj       = it->obj;
+	    cb.reason    = _cbValueChangeBatch;
+	    cb.cb_rtn    = variable_cb;
+
+	    info->next  = vcd_list;
+	    vcd_list    = info;
+
+	    info->cb    = vpi_register_cb(&cb);
+      }
+}
+
+/*
+ * Dump the item and, if it is a scope, everything under it to the
+ * given depth. The whole tree is fetched from the run time in one
+ * array, and the scopes are pushed and popped following the parent
+ * of each item in the array.
+ */
+static void scan_item(unsigned depth, vpiHandle item, int skip)
+{
+      p_vpip_hier_item items;
+      PLI_INT32 count, pos;
+      PLI_INT32 open = -1;
+      char *skips;
+      PLI_INT32 item_type = vpi_get(vpiType, item);
+
+      if (item_fst_type(item_type, 0) < 0) {
 	    vpi_printf("FST warning: $dumpvars: Unsupported argument "
 	               "type (%s)\n", vpi_get_str(vpiType, item));
 	    return;
       }
 
+      if (item_type == vpiParameter) {
+	    vpi_printf("FST sorry: $dumpvars: can not dump parameters.\n");
+	    return;
+      }
+
 	/* Do some special processing/checking on array words. Dumping
 	 * array words is an Icarus extension. */
       if (item_type == vpiMemoryWord) {
@@ -567,145 +1001,56 @@ static void scan_item(unsigned depth, vpiHandle item, int skip)
             }
       }
 
-      fullname = vpi_get_str(vpiFullName, item);
+      items = vpip_hier_export(item, depth, &count);
+      if (items == 0) return;
 
-	/* Generate the $var or $scope commands. */
-      switch (item_type) {
-	  case vpiParameter:
-	    vpi_printf("FST sorry: $dumpvars: can not dump parameters.\n");
-	    break;
+	/* This is set for each scope whose signals are skipped. */
+      skips = calloc(count, sizeof(char));
 
-	  case vpiNamedEvent:
-	  case vpiIntegerVar:
-	  case vpiBitVar:
-	  case vpiByteVar:
-	  case vpiShortIntVar:
-	  case vpiIntVar:
-	  case vpiLongIntVar:
-	  case vpiRealVar:
-	  case vpiMemoryWord:
-	  case vpiReg:
-	  case vpiTimeVar:
-	  case vpiNet:
-
-	      /* If we are skipping all signal or this is in an automatic
-	       * scope then just return. */
-            if (skip || vpi_get(vpiAutomatic, item)) return;
-
-	      /* Skip this signal if it has already been included.
-	       * This can only happen for implicitly given signals. */
-	    if (vcd_names_search(&fst_var, fullname)) return;
+      for (pos = 0 ;  pos < count ;  pos += 1) {
+	    p_vpip_hier_item it = items + pos;
+	    const char *fullname;
+	    const char *defname;
 
-	      /* Declare the variable in the FST file. */
-	    name = vpi_get_str(vpiName, item);
-	    if (is_escaped_id(name)) {
-		  escname = malloc(strlen(name) + 2);
-		  sprintf(escname, "\\%s", name);
-	    } else escname = strdup(name);
-
-	      /* Some signals can have an alias so handle that. */
-	    nexus_id = vpi_get(_vpiNexusId, item);
-
-	    ident = 0;
-	    if (nexus_id) ident = find_nexus_ident(nexus_id);
-
-	      /* Named events do not have a size, but other tools use
-	       * a size of 1 and some viewers do not accept a width of
-	       * zero so we will also use a width of one for events. */
-	    if (item_type == vpiNamedEvent) size = 1;
-	    else size = vpi_get(vpiSize, item);
-
-            if (size > 1 || vpi_get(vpiLeftRange, item) != 0) {
-		  char *buf = malloc(strlen(escname) + 65);
-		  sprintf(buf, "%s [%i:%i]", escname,
-                            (int)vpi_get(vpiLeftRange, item),
-                            (int)vpi_get(vpiRightRange, item));
-
-		  new_ident = fstWriterCreateVar(dump_file, type,
-		                                 FST_VD_IMPLICIT, size, buf,
-		                                 (fstHandle)(long)ident);
-		  free(buf);
-	    } else {
-		  new_ident = fstWriterCreateVar(dump_file, type,
-		                                 FST_VD_IMPLICIT, size, escname,
-		                                 (fstHandle)(long)ident);
+	      /* Close the scopes that this item is not in. */
+	    while (open != it->parent) {
+		  pop_scope();
+		  open = items[open].parent;
 	    }
-	    free(escname);
 
-	    if (!ident) {
-		  if (nexus_id) set_nexus_ident(nexus_id,
-		                                (const char *)(long)new_ident);
-
-		    /* Add a callback for the signal. */
-		  info = malloc(sizeof(*info));
-
-		  info->time.type = vpiSimTime;
-		  info->item  = item;
-		  info->handle = new_ident;
-		  info->scheduled = 0;
-
-		  cb.time      = &info->time;
-		  cb.user_data = (char*)info;
-		  cb.value     = NULL;
-		  cb.obj       = item;
-		  cb.reason    = cbValueChange;
-		  cb.cb_rtn    = variable_cb_1;
-
-		  info->dmp_next = 0;
-		  info->next  = vcd_list;
-		  vcd_list    = info;
-
-		  info->cb    = vpi_register_cb(&cb);
+	    if (! is_scope_type(it->type)) {
+		  scan_var(it, it->parent < 0 ? skip : skips[it->parent]);
+		  continue;
 	    }
 
-	    break;
+	    fullname = vpi_get_str(vpiFullName, it->obj);
 
-	  case vpiModule:
-	  case vpiNamedBegin:
-	  case vpiTask:
-	  case vpiFunction:
-	  case vpiNamedFork:
-
-	    if (depth > 0) {
-		  int nskip = (vcd_names_search(&fst_tab, fullname) != 0);
-		  char *defname = NULL;
+	      /* We have to always scan the scope because the depth
+	       * could be different for this call. */
+	    skips[pos] = (vcd_names_search(&fst_tab, fullname) != 0);
+	    if (skips[pos]) {
+		  vpi_printf("FST warning: ignoring signals in "
+		             "previously scanned scope %s.\n", fullname);
+	    } else {
+		  vcd_names_add(&fst_tab, fullname);
+	    }
 
-		    /* We have to always scan the scope because the
-		     * depth could be different for this call. */
-		  if (nskip) {
-			vpi_printf("FST warning: ignoring signals in "
-			           "previously scanned scope %s.\n", fullname);
-		  } else {
-			vcd_names_add(&fst_tab, fullname);
-		  }
+	      /* If the two names match only use the vpiName. */
+	    defname = it->def_name;
+	    if (defname && (strcmp(defname, it->name) == 0)) defname = NULL;
 
-		    /* This must be done before the other name is fetched
-		     * and the string must always be freed */
-		  if (item_type == vpiModule) {
-			defname = strdup(vpi_get_str(vpiDefName, item));
-		  }
-		  name = vpi_get_str(vpiName, item);
-		    /* If the two names match only use the vpiName. */
-		  if (defname && (strcmp(defname, name) == 0)) {
-			free(defname);
-			defname = NULL;
-		  }
-		  fstWriterSetScope(dump_file, type, name, defname);
-		  free(defname);
-
-		  for (i=0; types[i]>0; i++) {
-			vpiHandle hand;
-			vpiHandle argv = vpi_iterate(types[i], item);
-			while (argv && (hand = vpi_scan(argv))) {
-			      scan_item(depth-1, hand, nskip);
-			}
-		  }
+	    push_scope(item_fst_type(it->type, 0), it->name, defname,
+	               fullname);
+	    open = pos;
+      }
 
-		    /* Sort any signals that we added above. */
-		  fstWriterSetUpscope(dump_file);
-	    }
-	    break;
+      while (open >= 0) {
+	    pop_scope();
+	    open = items[open].parent;
       }
+
+      free(skips);
+      vpip_hier_free(items);
 }
 
 static int draw_scope(vpiHandle item, vpiHandle callh)
@@ -713,6 +1058,7 @@ static int draw_scope(vpiHandle item, vpiHandle callh)
       int depth;
       const char *name;
       char *defname = NULL;
+      char *fullname;
       PLI_INT32 scope_type, type;
 
       vpiHandle scope = vpi_handle(vpiScope, item);
@@ -721,6 +1067,7 @@ static int draw_scope(vpiHandle item, vpiHandle callh)
       depth = 1 + draw_scope(scope, callh);
 
       scope_type = vpi_get(vpiType, scope);
+      fullname = strdup(vpi_get_str(vpiFullName, scope));
 	/* This must be done before the other name is fetched
 	 * and the string must always be freed */
       if (scope_type == vpiModule) {
@@ -748,8 +1095,9 @@ static int draw_scope(vpiHandle item, vpiHandle callh)
             assert(0);
       }
 
-      fstWriterSetScope(dump_file, type, name, defname);
+      push_scope(type, name, defname, fullname);
       free(defname);
+      free(fullname);
 
       return depth;
 }
@@ -762,9 +1110,9 @@ static PLI_INT32 sys_dumpvars_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
       s_vpi_value value;
       unsigned depth = 0;
 
-      if (dump_file == 0) {
+      if (dump_shards == 0) {
 	    open_dumpfile(callh);
-	    if (dump_file == 0) {
+	    if (dump_shards == 0) {
 		  if (argv) vpi_free_object(argv);
 		  return 0;
 	    }
@@ -840,7 +1188,7 @@ static PLI_INT32 sys_dumpvars_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
 	      /* The scope list must be sorted after we scan an item.  */
 	    vcd_names_sort(&fst_tab);
 
-	    while (dep--) fstWriterSetUpscope(dump_file);
+	    while (dep--) pop_scope();
 
 	      /* Add this signal to the variable list so we can verify it
 	       * is not included twice. This must be done after it has
@@ -861,10 +1209,14 @@ void sys_fst_register()
       s_vpi_systf_data tf_data;
       vpiHandle res;
 
+      ring_enabled = vcd_ring_args(&ring_size, &ring_window);
+      vcd_filter_args("FST");
+
 	/* Scan the extended arguments, looking for fst optimization flags. */
       vpi_get_vlog_info(&vlog_info);
 
-	/* The "speed" option is not used in this dumper. */
+	/* The "speed" option is not used in this dumper. The +dumpshards
+	 * option splits the dump into several files. */
       for (idx = 0 ;  idx < vlog_info.argc ;  idx += 1) {
 	    if (strcmp(vlog_info.argv[idx],"-fst-space") == 0) {
 		  lxm_optimum_mode = LXM_SPACE;
@@ -876,6 +1228,14 @@ void sys_fst_register()
 		  lxm_optimum_mode = LXM_BOTH;
 	    } else if (strcmp(vlog_info.argv[idx],"-fst-speed-space") == 0) {
 		  lxm_optimum_mode = LXM_BOTH;
+	    } else if (strncmp(vlog_info.argv[idx],"+dumpshards=",12) == 0) {
+		  long cnt = strtol(vlog_info.argv[idx]+12, 0, 10);
+		  if (cnt < 1 || cnt > 1024) {
+			vpi_printf("FST warning: ignoring invalid shard "
+			           "count %s.\n", vlog_info.argv[idx]+12);
+		  } else {
+			dump_shard_count = (unsigned)cnt;
+		  }
 	    }
       }
 
@@ -908,6 +1268,15 @@ void sys_fst_register()
       res = vpi_register_systf(&tf_data);
       vpip_make_systf_system_defined(res);
 
+      tf_data.type      = vpiSysTask;
+      tf_data.tfname    = "$dumptrigger";
+      tf_data.calltf    = sys_dumptrigger_calltf;
+      tf_data.compiletf = sys_no_arg_compiletf;
+      tf_data.sizetf    = 0;
+      tf_data.user_data = "$dumptrigger";
+      res = vpi_register_systf(&tf_data);
+      vpip_make_systf_system_defined(res);
+
       tf_data.type      = vpiSysTask;
       tf_data.tfname    = "$dumplimit";
       tf_data.calltf    = sys_dumplimit_calltf;
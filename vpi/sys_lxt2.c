@@ -348,6 +348,7 @@ static PLI_INT32 finish_cb(p_cb_data cause)
       delete_all_vcd_info();
 
       vcd_scope_names_delete();
+      nexus_ident_stats("LXT2");
       nexus_ident_delete();
       free(dump_path);
       dump_path = 0;
@@ -566,6 +567,14 @@ static PLI_INT32 sys_dumpflush_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
       return 0;
 }
 
+/*
+ * This format has no flight recorder, so $dumptrigger does nothing.
+ */
+static PLI_INT32 sys_dumptrigger_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
+{
+      return 0;
+}
+
 static PLI_INT32 sys_dumplimit_calltf(ICARUS_VPI_CONST PLI_BYTE8 *name)
 {
       vpiHandle callh = vpi_handle(vpiSysTfCall, 0);
@@ -640,18 +649,14 @@ static void scan_item(unsigned depth, vpiHandle item, int skip)
 
 	    name = vpi_get_str(vpiName, item);
 	    nexus_id = vpi_get(_vpiNexusId, item);
-	    if (nexus_id) {
-		  ident = find_nexus_ident(nexus_id);
-	    } else {
-		  ident = 0;
-	    }
+	    ident = find_nexus_ident(nexus_id);
 
 	    if (!ident) {
 		  char*tmp = create_full_name(name);
 		  ident = strdup_sh(&name_heap, tmp);
 		  free(tmp);
 
-		  if (nexus_id) set_nexus_ident(nexus_id, ident);
+		  set_nexus_ident(nexus_id, ident);
 
 		  info = new_vcd_info();
 
@@ -675,7 +680,8 @@ static void scan_item(unsigned depth, vpiHandle item, int skip)
 	    } else {
 		  char *n = create_full_name(name);
 		  lxt2_wr_symbol_alias(dump_file, ident, n,
-				       vpi_get(vpiSize, item)-1, 0);
+				       (int)vpi_get(vpiLeftRange, item),
+				       (int)vpi_get(vpiRightRange, item));
 		  free(n);
             }
 
@@ -686,10 +692,22 @@ static void scan_item(unsigned depth, vpiHandle item, int skip)
             if (skip || vpi_get(vpiAutomatic, item)) break;
 
 	    name = vpi_get_str(vpiName, item);
+	    nexus_id = vpi_get(_vpiNexusId, item);
+	    ident = find_nexus_ident(nexus_id);
+
+	    if (ident) {
+		  char *n = create_full_name(name);
+		  lxt2_wr_symbol_alias(dump_file, ident, n, 0, 0);
+		  free(n);
+		  break;
+	    }
+
 	    { char*tmp = create_full_name(name);
 	      ident = strdup_sh(&name_heap, tmp);
 	      free(tmp);
 	    }
+	    set_nexus_ident(nexus_id, ident);
+
 	    info = new_vcd_info();
 
 	    info->item = item;
@@ -929,6 +947,15 @@ void sys_lxt2_register()
       res = vpi_register_systf(&tf_data);
       vpip_make_systf_system_defined(res);
 
+      tf_data.type      = vpiSysTask;
+      tf_data.tfname    = "$dumptrigger";
+      tf_data.calltf    = sys_dumptrigger_calltf;
+      tf_data.compiletf = sys_no_arg_compiletf;
+      tf_data.sizetf    = 0;
+      tf_data.user_data = "$dumptrigger";
+      res = vpi_register_systf(&tf_data);
+      vpip_make_systf_system_defined(res);
+
       tf_data.type      = vpiSysTask;
       tf_data.tfname    = "$dumplimit";
       tf_data.calltf    = sys_dumplimit_calltf;
@@ -40,19 +40,55 @@ struct vcd_info {
       struct t_vpi_time time;
       const char *ident;
       struct vcd_info *next;
-      struct vcd_info *dmp_next;
-      int scheduled;
+      PLI_INT32 type;
+      unsigned size;
+	/* The flight recorder keeps the oldest value it still knows
+	 * here, as the line that would have been written. */
+      char *base;
+      unsigned base_len;
 };
 
 
 static struct vcd_info *vcd_list = NULL;
-static struct vcd_info *vcd_dmp_list = NULL;
 static PLI_UINT64 vcd_cur_time = 0;
 static int dump_is_off = 0;
 static long dump_limit = 0;
 static int dump_is_full = 0;
 static int finish_status = 0;
 
+	/* The flight recorder, if it is enabled and not yet triggered. */
+static struct vcd_ring_s *dump_ring = NULL;
+static size_t ring_size = 0;
+static PLI_UINT64 ring_window = 0;
+static int ring_enabled = 0;
+
+/*
+ * A dump file named *.gz is written through a thread that compresses
+ * it (see vcd_gzip.c). The size that the dump limit is checked
+ * against is then the compressed size.
+ */
+static int dump_is_gzip = 0;
+
+static long dump_file_size(void)
+{
+#ifdef HAVE_LIBZ
+      if (dump_is_gzip) return vcd_gzip_size(dump_file);
+#endif
+      return ftell(dump_file);
+}
+
+static void close_dumpfile(void)
+{
+#ifdef HAVE_LIBZ
+      if (dump_is_gzip) {
+	    vcd_gzip_close(dump_file);
+	    dump_is_gzip = 0;
+	    return;
+      }
+#endif
+      fclose(dump_file);
+}
+
 
 static const char*units_names[] = {
       "s",
@@ -83,59 +119,201 @@ static void gen_new_vcd_id(void)
       assert(0);
 }
 
-static char *truncate_bitvec(char *s)
+/*
+ * The value changes are encoded directly from the aval/bval words of
+ * the value into this buffer, which is then written to the (fully
+ * buffered) dump file in one go. This skips formatting the value as a
+ * string and then scanning the string again to print it.
+ */
+static char *vcd_buf = NULL;
+static unsigned vcd_buf_size = 0;
+
+static char *need_vcd_buf(unsigned size)
+{
+      if (size > vcd_buf_size) {
+	    vcd_buf_size = size + 256;
+	    vcd_buf = realloc(vcd_buf, vcd_buf_size);
+      }
+      return vcd_buf;
+}
+
+/* The 4-value bit from its aval/bval pair. */
+static const char vcd_bit_chars[4] = { '0', '1', 'z', 'x' };
+
+#define VCD_BIT(vec, idx) (vcd_bit_chars[(((vec)[(idx)/32].aval >> ((idx)%32)) & 1) | \
+                                         ((((vec)[(idx)/32].bval >> ((idx)%32)) & 1) << 1)])
+
+/*
+ * Write a value change line from the vcd_buf, or record it if the
+ * flight recorder is on.
+ */
+static void write_line(struct vcd_info*info, unsigned len)
 {
-      char l, r;
+      if (dump_ring) vcd_ring_add(dump_ring, vcd_cur_time, info, vcd_buf, len);
+      else fwrite(vcd_buf, 1, len, dump_file);
+}
 
-      r=*s;
-      if(r=='1') return s;
-      else s += 1;
+static unsigned encode_vecval(const s_vpi_vecval *vec, unsigned size,
+                              const char *ident)
+{
+      unsigned ilen = strlen(ident);
+      char *cp = need_vcd_buf(size + ilen + 3);
+      char *start = cp;
+      unsigned idx;
+
+      if (size == 1) {
+	    *cp++ = VCD_BIT(vec, 0);
+	    memcpy(cp, ident, ilen);
+	    cp += ilen;
+	    *cp++ = '\n';
+	    return cp - start;
+      }
 
-      for(;;s++) {
-	    l=r; r=*s;
-	    if(!r) return (s-1);
-	    if(l!=r) return(((l=='0')&&(r=='1'))?s:s-1);
+	/* Drop the redundant leading bits. A run of leading 0 bits is
+	   dropped before a 1, otherwise the run is reduced to a single
+	   bit. This is the same as what other tools do. */
+      idx = size - 1;
+      if (VCD_BIT(vec, idx) != '1') {
+	    char lead = VCD_BIT(vec, idx);
+	    while (idx > 0 && VCD_BIT(vec, idx-1) == lead) idx -= 1;
+	    if (idx > 0 && lead == '0' && VCD_BIT(vec, idx-1) == '1')
+		  idx -= 1;
       }
+
+      *cp++ = 'b';
+      for (;;) {
+	    *cp++ = VCD_BIT(vec, idx);
+	    if (idx == 0) break;
+	    idx -= 1;
+      }
+      *cp++ = ' ';
+      memcpy(cp, ident, ilen);
+      cp += ilen;
+      *cp++ = '\n';
+      return cp - start;
+}
+
+static void write_time(PLI_UINT64 now)
+{
+      char buf[32];
+      char *cp = buf + sizeof(buf);
+
+      *--cp = '\n';
+      do {
+	    *--cp = '0' + (char)(now % 10);
+	    now /= 10;
+      } while (now);
+      *--cp = '#';
+      fwrite(cp, 1, buf + sizeof(buf) - cp, dump_file);
 }
 
 static void show_this_item(struct vcd_info*info)
 {
       s_vpi_value value;
-      PLI_INT32 type = vpi_get(vpiType, info->item);
+      unsigned ilen = strlen(info->ident);
+      unsigned len;
 
-      if (type == vpiRealVar) {
+      if (info->type == vpiRealVar) {
 	    value.format = vpiRealVal;
 	    vpi_get_value(info->item, &value);
-	    fprintf(dump_file, "r%.16g %s\n", value.value.real, info->ident);
-      } else if (type == vpiNamedEvent) {
-	    fprintf(dump_file, "1%s\n", info->ident);
-      } else if (vpi_get(vpiSize, info->item) == 1) {
-	    value.format = vpiBinStrVal;
-	    vpi_get_value(info->item, &value);
-	    fprintf(dump_file, "%s%s\n", value.value.str, info->ident);
+	    len = sprintf(need_vcd_buf(ilen + 32), "r%.16g %s\n",
+	                  value.value.real, info->ident);
+      } else if (info->type == vpiNamedEvent) {
+	    len = sprintf(need_vcd_buf(ilen + 3), "1%s\n", info->ident);
       } else {
-	    value.format = vpiBinStrVal;
+	    value.format = vpiVectorVal;
 	    vpi_get_value(info->item, &value);
-	    fprintf(dump_file, "b%s %s\n", truncate_bitvec(value.value.str),
-		    info->ident);
+	    len = encode_vecval(value.value.vector, info->size, info->ident);
       }
+
+      write_line(info, len);
 }
 
 /* Dump values for a $dumpoff. */
 static void show_this_item_x(struct vcd_info*info)
 {
-      PLI_INT32 type = vpi_get(vpiType, info->item);
+      unsigned ilen = strlen(info->ident);
+      unsigned len;
 
-      if (type == vpiRealVar) {
+      if (info->type == vpiRealVar) {
 	      /* Some tools dump nothing here...? */
-	    fprintf(dump_file, "rNaN %s\n", info->ident);
-      } else if (type == vpiNamedEvent) {
+	    len = sprintf(need_vcd_buf(ilen + 6), "rNaN %s\n", info->ident);
+      } else if (info->type == vpiNamedEvent) {
 	    /* Do nothing for named events. */
-      } else if (vpi_get(vpiSize, info->item) == 1) {
-	    fprintf(dump_file, "x%s\n", info->ident);
+	    return;
+      } else if (info->size == 1) {
+	    len = sprintf(need_vcd_buf(ilen + 3), "x%s\n", info->ident);
       } else {
-	    fprintf(dump_file, "bx %s\n", info->ident);
+	    len = sprintf(need_vcd_buf(ilen + 4), "bx %s\n", info->ident);
+      }
+
+      write_line(info, len);
+}
+
+/*
+ * The flight recorder calls this with the records that fall out of
+ * the ring. Keep the line as the base value of the signal.
+ */
+static void ring_evict(void*ptr, const char*data, unsigned len)
+{
+      struct vcd_info*info = (struct vcd_info*)ptr;
+
+      if (len > info->base_len || info->base == 0)
+	    info->base = realloc(info->base, len);
+      memcpy(info->base, data, len);
+      info->base_len = len;
+}
+
+static PLI_UINT64 ring_last_time;
+static int ring_wrote_time;
+
+static void ring_emit(PLI_UINT64 time, void*info, const char*data,
+                      unsigned len)
+{
+      (void)info;
+      if (!ring_wrote_time || time != ring_last_time) {
+	    write_time(time);
+	    ring_last_time = time;
+	    ring_wrote_time = 1;
+      }
+      fwrite(data, 1, len, dump_file);
+}
+
+/*
+ * Write out the flight recorder and go back to normal dumping. The
+ * base values are written as a $dumpvars at the base time, and then
+ * the recorded changes.
+ */
+static void vcd_trigger(void)
+{
+      struct vcd_ring_s*ring = dump_ring;
+      struct vcd_info*cur;
+      PLI_UINT64 base_time;
+
+      if (ring == 0) return;
+      dump_ring = 0;
+
+      vpi_printf("VCD info: writing the flight recorder at time %"
+                 PLI_UINT64_FMT ".\n", vcd_cur_time);
+
+      ring_wrote_time = 0;
+      if (vcd_ring_base_time(ring, &base_time)) {
+	    write_time(base_time);
+	    ring_last_time = base_time;
+	    ring_wrote_time = 1;
+	    fprintf(dump_file, "$dumpvars\n");
+	    for (cur = vcd_list ;  cur ;  cur = cur->next) {
+		  if (cur->base) fwrite(cur->base, 1, cur->base_len, dump_file);
+	    }
+	    fprintf(dump_file, "$end\n");
       }
+
+      vcd_ring_drain(ring, ring_emit);
+      vcd_ring_delete(ring);
+
+	/* The following changes are at the current time. */
+      if (!ring_wrote_time || ring_last_time != vcd_cur_time)
+	    write_time(vcd_cur_time);
 }
 
 
@@ -174,37 +352,26 @@ static void vcd_checkpoint_x()
 	    show_this_item_x(cur);
 }
 
-static PLI_INT32 variable_cb_2(p_cb_data cause)
+/*
+ * The value changes of all the dumped signals come in one batch at
+ * the end of each time step. The batch lists the signals in the order
+ * that they first changed, so walk it backwards to write the values
+ * in the order that they have always been written.
+ */
+static PLI_INT32 variable_cb(p_cb_data cause)
 {
-      struct vcd_info* info = vcd_dmp_list;
+      struct vcd_info**list = (struct vcd_info**)cause->user_data;
       PLI_UINT64 now = timerec_to_time64(cause->time);
-
-      if (now != vcd_cur_time) {
-	    fprintf(dump_file, "#%" PLI_UINT64_FMT "\n", now);
-	    vcd_cur_time = now;
-      }
-
-      do {
-           show_this_item(info);
-           info->scheduled = 0;
-      } while ((info = info->dmp_next) != 0);
-
-      vcd_dmp_list = 0;
-
-      return 0;
-}
-
-static PLI_INT32 variable_cb_1(p_cb_data cause)
-{
-      struct t_cb_data cb;
-      struct vcd_info*info = (struct vcd_info*)cause->user_data;
+      PLI_INT32 idx;
 
       if (dump_is_full) return 0;
       if (dump_is_off) return 0;
       if (dump_header_pending()) return 0;
-      if (info->scheduled) return 0;
 
-      if ((dump_limit > 0) && (ftell(dump_file) > dump_limit)) {
+	/* The $dumpvars checkpoint already has the values at its time. */
+      if (now == dumpvars_time) return 0;
+
+      if ((dump_limit > 0) && (dump_file_size() > dump_limit)) {
             dump_is_full = 1;
             vpi_printf("WARNING: Dump file limit (%ld bytes) "
                                "exceeded.\n", dump_limit);
@@ -213,16 +380,13 @@ static PLI_INT32 variable_cb_1(p_cb_data cause)
             return 0;
       }
 
-      if (!vcd_dmp_list) {
-          cb = *cause;
-          cb.reason = cbReadOnlySynch;
-          cb.cb_rtn = variable_cb_2;
-          vpi_register_cb(&cb);
+      if (now != vcd_cur_time) {
+	    if (!dump_ring) write_time(now);
+	    vcd_cur_time = now;
       }
 
-      info->scheduled = 1;
-      info->dmp_next  = vcd_dmp_list;
-      vcd_dmp_list    = info;
+      for (idx = cause->index ;  idx > 0 ;  idx -= 1)
+	    show_this_item(list[idx-1]);
 
       return 0;
 }
@@ -238,7 +402,10 @@ static PLI_INT32 dumpvars_cb(p_cb_data cause)
 
       fprintf(dump_file, "$enddefinitions $end\n");
 
-      if (!dump_is_off) {
+      if (!dump_is_off && dump_ring) {
+	      /* The flight recorder only records the initial values. */
+	    vcd_checkpoint();
+      } else if (!dump_is_off) {
 	    fprintf(dump_file, "#%" PLI_UINT64_FMT "\n", dumpvars_time);
 	    fprintf(dump_file, "$dumpvars\n");
 	    vcd_checkpoint();
@@ -258,21 +425,32 @@ static PLI_INT32 finish_cb(p_cb_data cause)
 
       dumpvars_time = timerec_to_time64(cause->time);
 
-      if (!dump_is_off && !dump_is_full && dumpvars_time != vcd_cur_time) {
+	/* A flight recorder that was not triggered is thrown away. */
+      if (dump_ring) {
+	    vcd_ring_delete(dump_ring);
+	    dump_ring = 0;
+      } else if (!dump_is_off && !dump_is_full &&
+                 dumpvars_time != vcd_cur_time) {
 	    fprintf(dump_file, "#%" PLI_UINT64_FMT "\n", dumpvars_time);
       }
 
-      fclose(dump_file);
+      close_dumpfile();
+      free(vcd_buf);
+      vcd_buf = 0;
+      vcd_buf_size = 0;
 
       for (cur = vcd_list ;  cur ;  cur = next) {
 	    next = cur->next;
 	    free((char *)cur->ident);
+	    free(cur->base);
 	    free(cur);
       }
       vcd_list = 0;
       vcd_names_delete(&vcd_tab);
       vcd_names_delete(&vcd_var);
+      nexus_ident_stats("VCD");
       nexus_ident_delete();
+      vcd_filter_delete();
       free(dump_path);
       dump_path = 0;
 
@@ -328,10 +506,17 @@ static PLI_INT32 sys_dumpoff_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
       now64 = timerec_to_time64(&now);
 
       if (now64 > vcd_cur_time) {
-	    fprintf(dump_file, "#%" PLI_UINT64_FMT "\n", now64);
+	    if (!dump_ring)
+		  fprintf(dump_file, "#%" PLI_UINT64_FMT "\n", now64);
 	    vcd_cur_time = now64;
       }
 
+	/* The flight recorder only records the values. */
+      if (dump_ring) {
+	    vcd_checkpoint_x();
+	    return 0;
+      }
+
       fprintf(dump_file, "$dumpoff\n");
       vcd_checkpoint_x();
       fprintf(dump_file, "$end\n");
@@ -356,10 +541,17 @@ static PLI_INT32 sys_dumpon_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
       now64 = timerec_to_time64(&now);
 
       if (now64 > vcd_cur_time) {
-	    fprintf(dump_file, "#%" PLI_UINT64_FMT "\n", now64);
+	    if (!dump_ring)
+		  fprintf(dump_file, "#%" PLI_UINT64_FMT "\n", now64);
 	    vcd_cur_time = now64;
       }
 
+	/* The flight recorder only records the values. */
+      if (dump_ring) {
+	    vcd_checkpoint();
+	    return 0;
+      }
+
       fprintf(dump_file, "$dumpon\n");
       vcd_checkpoint();
       fprintf(dump_file, "$end\n");
@@ -381,10 +573,17 @@ static PLI_INT32 sys_dumpall_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
       now64 = timerec_to_time64(&now);
 
       if (now64 > vcd_cur_time) {
-	    fprintf(dump_file, "#%" PLI_UINT64_FMT "\n", now64);
+	    if (!dump_ring)
+		  fprintf(dump_file, "#%" PLI_UINT64_FMT "\n", now64);
 	    vcd_cur_time = now64;
       }
 
+	/* The flight recorder only records the values. */
+      if (dump_ring) {
+	    vcd_checkpoint();
+	    return 0;
+      }
+
       fprintf(dump_file, "$dumpall\n");
       vcd_checkpoint();
       fprintf(dump_file, "$end\n");
@@ -392,10 +591,22 @@ static PLI_INT32 sys_dumpall_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
       return 0;
 }
 
+/* $dumptrigger and $stop write out the flight recorder. */
+static void dump_trigger(void)
+{
+      if (dump_file && !dump_header_pending()) vcd_trigger();
+}
+
 static void open_dumpfile(vpiHandle callh)
 {
       if (dump_path == 0) dump_path = strdup("dump.vcd");
 
+#ifdef HAVE_LIBZ
+      if (vcd_gzip_path(dump_path)) {
+	    dump_file = vcd_gzip_open(dump_path);
+	    dump_is_gzip = dump_file != 0;
+      } else
+#endif
       dump_file = fopen(dump_path, "w");
 
       if (dump_file == 0) {
@@ -413,6 +624,18 @@ static void open_dumpfile(vpiHandle callh)
 	    vpi_printf("VCD info: dumpfile %s opened for output.\n",
 	               dump_path);
 
+	      /* Use a large buffer so that the value changes go out in
+	       * a few big writes. */
+	    setvbuf(dump_file, NULL, _IOFBF, 1024*1024);
+
+	    if (ring_enabled) {
+		  dump_ring = vcd_ring_create(ring_size, ring_window,
+		                              ring_evict);
+		  vcd_dump_trigger = dump_trigger;
+		  vpi_printf("VCD info: flight recorder is on, the dump "
+		             "is written by $dumptrigger or $stop.\n");
+	    }
+
 	    time(&walltime);
 
 	    assert(prec >= -15);
@@ -472,9 +695,24 @@ static PLI_INT32 sys_dumpfile_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
       return 0;
 }
 
+static PLI_INT32 sys_dumptrigger_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
+{
+      dump_trigger();
+
+      return 0;
+}
+
 static PLI_INT32 sys_dumpflush_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
 {
-      if (dump_file) fflush(dump_file);
+      if (dump_file == 0) return 0;
+
+#ifdef HAVE_LIBZ
+      if (dump_is_gzip) {
+	    vcd_gzip_flush(dump_file);
+	    return 0;
+      }
+#endif
+      fflush(dump_file);
 
       return 0;
 }
@@ -494,85 +732,172 @@ static PLI_INT32 sys_dumplimit_calltf(ICARUS_VPI_CONST PLI_BYTE8 *name)
       return 0;
 }
 
-static void scan_item(unsigned depth, vpiHandle item, int skip)
+/*
+ * Get the displayed type for the various $var and $scope types. Not
+ * all of these are supported now, but they should be in a future
+ * development version.
+ */
+static const char *item_type_name(PLI_INT32 item_type, PLI_INT32 net_type)
 {
-      struct t_cb_data cb;
-      struct vcd_info* info;
-
-      const char *type;
-      const char *name;
-      const char *fullname;
-      const char *prefix;
-      const char *ident;
-      int nexus_id;
-      unsigned size;
-      PLI_INT32 item_type;
-
-      /* list of types to iterate upon */
-      int i;
-      static int types[] = {
-	    /* Value */
-	    vpiNamedEvent,
-	    vpiNet,
-//	    vpiParameter,
-	    vpiReg,
-	    vpiVariables,
-	    /* Scope */
-	    vpiFunction,
-	    vpiModule,
-	    vpiNamedBegin,
-	    vpiNamedFork,
-	    vpiTask,
-	    -1
-      };
-
-	/* Get the displayed type for the various $var and $scope types. */
-	/* Not all of these are supported now, but they should be in a
-	 * future development version. */
-      item_type = vpi_get(vpiType, item);
       switch (item_type) {
-	  case vpiNamedEvent: type = "event"; break;
+	  case vpiNamedEvent: return "event";
 	  case vpiIntVar:
-	  case vpiIntegerVar: type = "integer"; break;
-	  case vpiParameter:  type = "parameter"; break;
+	  case vpiIntegerVar: return "integer";
+	  case vpiParameter:  return "parameter";
 	    /* Icarus converts realtime to real. */
-	  case vpiRealVar:    type = "real"; break;
+	  case vpiRealVar:    return "real";
 	  case vpiMemoryWord:
 	  case vpiBitVar:
 	  case vpiByteVar:
 	  case vpiShortIntVar:
 	  case vpiLongIntVar:
-	  case vpiReg:        type = "reg"; break;
+	  case vpiReg:        return "reg";
 	    /* Icarus converts a time to a plain register. */
-	  case vpiTimeVar:    type = "time"; break;
+	  case vpiTimeVar:    return "time";
 	  case vpiNet:
-	    switch (vpi_get(vpiNetType, item)) {
-		case vpiWand:    type = "wand"; break;
-		case vpiWor:     type = "wor"; break;
-		case vpiTri:     type = "tri"; break;
-		case vpiTri0:    type = "tri0"; break;
-		case vpiTri1:    type = "tri1"; break;
-		case vpiTriReg:  type = "trireg"; break;
-		case vpiTriAnd:  type = "triand"; break;
-		case vpiTriOr:   type = "trior"; break;
-		case vpiSupply1: type = "supply1"; break;
-		case vpiSupply0: type = "supply0"; break;
-		default:         type = "wire"; break;
+	    switch (net_type) {
+		case vpiWand:    return "wand";
+		case vpiWor:     return "wor";
+		case vpiTri:     return "tri";
+		case vpiTri0:    return "tri0";
+		case vpiTri1:    return "tri1";
+		case vpiTriReg:  return "trireg";
+		case vpiTriAnd:  return "triand";
+		case vpiTriOr:   return "trior";
+		case vpiSupply1: return "supply1";
+		case vpiSupply0: return "supply0";
+		default:         return "wire";
 	    }
-	    break;
 
-	  case vpiNamedBegin: type = "begin"; break;
-	  case vpiNamedFork:  type = "fork"; break;
-	  case vpiFunction:   type = "function"; break;
-	  case vpiModule:     type = "module"; break;
-	  case vpiTask:       type = "task"; break;
+	  case vpiNamedBegin: return "begin";
+	  case vpiNamedFork:  return "fork";
+	  case vpiFunction:   return "function";
+	  case vpiModule:     return "module";
+	  case vpiTask:       return "task";
+      }
 
-	  default:
+      return 0;
+}
+
+static int is_scope_type(PLI_INT32 item_type)
+{
+      switch (item_type) {
+	  case vpiModule:
+	  case vpiNamedBegin:
+	  case vpiTask:
+	  case vpiFunction:
+	  case vpiNamedFork:
+	    return 1;
+      }
+      return 0;
+}
+
+/* Generate the $var command for a signal and add its callback. */
+static void scan_var(const s_vpip_hier_item *it, int skip)
+{
+      struct t_cb_data cb;
+      struct vcd_info* info;
+      const char *prefix;
+      const char *ident;
+      unsigned size;
+
+	/* If we are skipping all signal or this is in an automatic
+	 * scope then just return. */
+      if (skip || it->automatic) return;
+
+	/* Skip this signal if it has already been included. This can
+	 * only happen for implicitly given signals, so the full name
+	 * is only needed when some have been given or there is a dump
+	 * filter. */
+      if (vcd_filter_active ||
+          vcd_var.listed_names || vcd_var.sorted_names) {
+	    const char *fullname = vpi_get_str(vpiFullName, it->obj);
+	    if (!vcd_filter_signal(it->obj, fullname, it->type,
+	                           it->type == vpiNamedEvent ? 1 : it->size))
+		  return;
+	    if (vcd_names_search(&vcd_var, fullname)) return;
+      }
+
+	/* Declare the variable in the VCD file. */
+      prefix = is_escaped_id(it->name) ? "\\" : "";
+
+	/* Named events do not have a size, but other tools use a size
+	 * of 1 and some viewers do not accept a width of zero so we
+	 * will also use a width of one for events. */
+      if (it->type == vpiNamedEvent) size = 1;
+      else size = it->size;
+
+	/* Some signals can have an alias so handle that. */
+      ident = find_nexus_ident(it->nexus_id);
+
+      if (!ident) {
+	    ident = strdup(vcdid);
+	    gen_new_vcd_id();
+
+	    set_nexus_ident(it->nexus_id, ident);
+
+	      /* Add a callback for the signal. */
+	    info = malloc(sizeof(*info));
+
+	    info->time.type = vpiSimTime;
+	    info->item  = it->obj;
+	    info->ident = ident;
+	    info->type  = it->type;
+	    info->base  = 0;
+	    info->base_len = 0;
+	    info->size  = size;
+
+	    cb.time      = &info->time;
+	    cb.user_data = (char*)info;
+	    cb.value     = NULL;
+	    cb.obj       = it->obj;
+	    cb.reason    = _cbValueChangeBatch;
+	    cb.cb_rtn    = variable_cb;
+
+	    info->next  = vcd_list;
+	    vcd_list    = info;
+
+	    info->cb    = vpi_register_cb(&cb);
+      }
+
+      fprintf(dump_file, "$var %s %u %s %s%s",
+	      item_type_name(it->type, it->net_type), size, ident,
+	      prefix, it->name);
+
+	/* Add a range for vectored values. */
+      if (size > 1 || it->left_range != 0) {
+	    fprintf(dump_file, " [%i:%i]",
+		    (int)it->left_range, (int)it->right_range);
+      }
+
+      fprintf(dump_file, " $end\n");
+}
+
+/*
+ * Dump the item and, if it is a scope, everything under it to the
+ * given depth. The whole tree is fetched from the run time in one
+ * array, and the $scope and $upscope commands are generated from the
+ * parent of each item in the array.
+ */
+static void scan_item(unsigned depth, vpiHandle item, int skip)
+{
+      p_vpip_hier_item items;
+      PLI_INT32 count, pos;
+      PLI_INT32 open = -1;
+      char *skips;
+      PLI_INT32 item_type = vpi_get(vpiType, item);
+
+      if (item_type_name(item_type, 0) == 0) {
 	    vpi_printf("VCD warning: $dumpvars: Unsupported argument "
 	               "type (%s)\n", vpi_get_str(vpiType, item));
 	    return;
       }
 
+      if (item_type == vpiParameter) {
+	    vpi_printf("VCD sorry: $dumpvars: can not dump parameters.\n");
+	    return;
+      }
+
 	/* Do some special processing/checking on array words. Dumping
 	 * array words is an Icarus extension. */
       if (item_type == vpiMemoryWord) {
@@ -596,127 +921,52 @@ static void scan_item(unsigned depth, vpiHandle item, int skip)
             }
       }
 
-      fullname = vpi_get_str(vpiFullName, item);
-
-	/* Generate the $var or $scope commands. */
-      switch (item_type) {
-	  case vpiParameter:
-	    vpi_printf("VCD sorry: $dumpvars: can not dump parameters.\n");
-	    break;
-
-	  case vpiNamedEvent:
-	  case vpiIntegerVar:
-	  case vpiBitVar:
-	  case vpiByteVar:
-	  case vpiShortIntVar:
-	  case vpiIntVar:
-	  case vpiLongIntVar:
-	  case vpiRealVar:
-	  case vpiMemoryWord:
-	  case vpiReg:
-	  case vpiTimeVar:
-	  case vpiNet:
-
-
-	      /* If we are skipping all signal or this is in an automatic
-	       * scope then just return. */
-            if (skip || vpi_get(vpiAutomatic, item)) return;
-
-	      /* Skip this signal if it has already been included.
-	       * This can only happen for implicitly given signals. */
-	    if (vcd_names_search(&vcd_var, fullname)) return;
-
-	      /* Declare the variable in the VCD file. */
-	    name = vpi_get_str(vpiName, item);
-	    prefix = is_escaped_id(name) ? "\\" : "";
-
-	      /* Some signals can have an alias so handle that. */
-	    nexus_id = vpi_get(_vpiNexusId, item);
-
-	    ident = 0;
-	    if (nexus_id) ident = find_nexus_ident(nexus_id);
-
-	    if (!ident) {
-		  ident = strdup(vcdid);
-		  gen_new_vcd_id();
+      items = vpip_hier_export(item, depth, &count);
+      if (items == 0) return;
 
-		  if (nexus_id) set_nexus_ident(nexus_id, ident);
+	/* This is set for each scope whose signals are skipped. */
+      skips = calloc(count, sizeof(char));
 
-		    /* Add a callback for the signal. */
-		  info = malloc(sizeof(*info));
+      for (pos = 0 ;  pos < count ;  pos += 1) {
+	    p_vpip_hier_item it = items + pos;
 
-		  info->time.type = vpiSimTime;
-		  info->item  = item;
-		  info->ident = ident;
-		  info->scheduled = 0;
-
-		  cb.time      = &info->time;
-		  cb.user_data = (char*)info;
-		  cb.value     = NULL;
-		  cb.obj       = item;
-		  cb.reason    = cbValueChange;
-		  cb.cb_rtn    = variable_cb_1;
-
-		  info->dmp_next = 0;
-		  info->next  = vcd_list;
-		  vcd_list    = info;
-
-		  info->cb    = vpi_register_cb(&cb);
+	      /* Close the scopes that this item is not in. */
+	    while (open != it->parent) {
+		  fprintf(dump_file, "$upscope $end\n");
+		  open = items[open].parent;
 	    }
 
-	      /* Named events do not have a size, but other tools use
-	       * a size of 1 and some viewers do not accept a width of
-	       * zero so we will also use a width of one for events. */
-	    if (item_type == vpiNamedEvent) size = 1;
-	    else size = vpi_get(vpiSize, item);
-
-	    fprintf(dump_file, "$var %s %u %s %s%s",
-		    type, size, ident, prefix, name);
-
-	      /* Add a range for vectored values. */
-	    if (size > 1 || vpi_get(vpiLeftRange, item) != 0) {
-		  fprintf(dump_file, " [%i:%i]",
-			  (int)vpi_get(vpiLeftRange, item),
-			  (int)vpi_get(vpiRightRange, item));
+	    if (! is_scope_type(it->type)) {
+		  scan_var(it, it->parent < 0 ? skip : skips[it->parent]);
+		  continue;
 	    }
 
-	    fprintf(dump_file, " $end\n");
-	    break;
-
-	  case vpiModule:
-	  case vpiNamedBegin:
-	  case vpiTask:
-	  case vpiFunction:
-	  case vpiNamedFork:
-
-	    if (depth > 0) {
-		  int nskip = (vcd_names_search(&vcd_tab, fullname) != 0);
+	    {
+		  const char *fullname = vpi_get_str(vpiFullName, it->obj);
 
 		    /* We have to always scan the scope because the
 		     * depth could be different for this call. */
-		  if (nskip) {
+		  skips[pos] = (vcd_names_search(&vcd_tab, fullname) != 0);
+		  if (skips[pos]) {
 			vpi_printf("VCD warning: ignoring signals in "
 			           "previously scanned scope %s.\n", fullname);
 		  } else {
 			vcd_names_add(&vcd_tab, fullname);
 		  }
+	    }
 
-		  name = vpi_get_str(vpiName, item);
-		  fprintf(dump_file, "$scope %s %s $end\n", type, name);
-
-		  for (i=0; types[i]>0; i++) {
-			vpiHandle hand;
-			vpiHandle argv = vpi_iterate(types[i], item);
-			while (argv && (hand = vpi_scan(argv))) {
-			      scan_item(depth-1, hand, nskip);
-			}
-		  }
+	    fprintf(dump_file, "$scope %s %s $end\n",
+	            item_type_name(it->type, 0), it->name);
+	    open = pos;
+      }
 
-		    /* Sort any signals that we added above. */
-		  fprintf(dump_file, "$upscope $end\n");
-	    }
-	    break;
+      while (open >= 0) {
+	    fprintf(dump_file, "$upscope $end\n");
+	    open = items[open].parent;
       }
+
+      free(skips);
+      vpip_hier_free(items);
 }
 
 static int draw_scope(vpiHandle item, vpiHandle callh)
@@ -856,6 +1106,9 @@ void sys_vcd_register()
       s_vpi_systf_data tf_data;
       vpiHandle res;
 
+      ring_enabled = vcd_ring_args(&ring_size, &ring_window);
+      vcd_filter_args("VCD");
+
       /* All the compiletf routines are located in vcd_priv.c. */
 
       tf_data.type      = vpiSysTask;
@@ -885,6 +1138,15 @@ void sys_vcd_register()
       res = vpi_register_systf(&tf_data);
       vpip_make_systf_system_defined(res);
 
+      tf_data.type      = vpiSysTask;
+      tf_data.tfname    = "$dumptrigger";
+      tf_data.calltf    = sys_dumptrigger_calltf;
+      tf_data.compiletf = sys_no_arg_compiletf;
+      tf_data.sizetf    = 0;
+      tf_data.user_data = "$dumptrigger";
+      res = vpi_register_systf(&tf_data);
+      vpip_make_systf_system_defined(res);
+
       tf_data.type      = vpiSysTask;
       tf_data.tfname    = "$dumplimit";
       tf_data.calltf    = sys_dumplimit_calltf;
@@ -0,0 +1,308 @@
+/*
+ * Copyright (c) 2012 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+#include  "sys_priv.h"
+#include  "vcd_priv.h"
+#include  "ivl_alloc.h"
+#include  <stdio.h>
+#include  <stdlib.h>
+#include  <string.h>
+
+/*
+ * The +dumpfilter=<file> rules are read once into this table. Each
+ * include or exclude rule is a glob pattern on the full hierarchical
+ * name of a signal, and the last rule that matches a signal decides
+ * whether it is dumped. If no rule matches, the signal is dumped
+ * unless there are include rules.
+ */
+struct filter_rule_s {
+      int include;
+      char *pattern;
+	/* The characters before the first wildcard, to reject most
+	 * names without running the match. */
+      size_t prefix_len;
+};
+
+static struct filter_rule_s *rules = 0;
+static unsigned nrules = 0;
+static int have_include = 0;
+static int max_depth = -1;
+static long max_width = -1;
+static int skip_memories = 0;
+static PLI_INT32 skip_types[8];
+static unsigned nskip_types = 0;
+
+static unsigned dropped = 0;
+
+int vcd_filter_active = 0;
+
+/*
+ * Match a glob pattern. A * matches any string, including the dots
+ * between scopes, a ? matches any one character and [...] matches one
+ * of a set of characters. A \ makes the next character plain, but
+ * a \ that starts an escaped identifier in the name is matched by
+ * writing it twice.
+ */
+static int glob_match(const char *pat, const char *str)
+{
+      const char *star_pat = 0;
+      const char *star_str = 0;
+
+      while (*str) {
+	    int ok = 0;
+
+	    switch (*pat) {
+		case '*':
+		  star_pat = ++pat;
+		  star_str = str;
+		  continue;
+
+		case '?':
+		  ok = 1;
+		  pat += 1;
+		  break;
+
+		case '[': {
+		      const char *cp = pat + 1;
+		      int negate = 0, found = 0;
+		      if (*cp == '!' || *cp == '^') {
+			    negate = 1;
+			    cp += 1;
+		      }
+		      do {
+			    if (*cp == 0) break;
+			    if (cp[1] == '-' && cp[2] && cp[2] != ']') {
+				  if (*str >= cp[0] && *str <= cp[2]) found = 1;
+				  cp += 3;
+			    } else {
+				  if (*str == *cp) found = 1;
+				  cp += 1;
+			    }
+		      } while (*cp != ']');
+		      if (*cp == ']') {
+			    ok = found != negate;
+			    pat = cp + 1;
+		      }
+		      break;
+		}
+
+		case '\\':
+		  if (pat[1] == *str) {
+			ok = 1;
+			pat += 2;
+		  }
+		  break;
+
+		case 0:
+		  break;
+
+		default:
+		  if (*pat == *str) {
+			ok = 1;
+			pat += 1;
+		  }
+		  break;
+	    }
+
+	    if (ok) {
+		  str += 1;
+	    } else if (star_pat) {
+		  pat = star_pat;
+		  str = ++star_str;
+	    } else {
+		  return 0;
+	    }
+      }
+
+      while (*pat == '*') pat += 1;
+      return *pat == 0;
+}
+
+static PLI_INT32 type_by_name(const char *name)
+{
+      if (strcmp(name, "event") == 0)   return vpiNamedEvent;
+      if (strcmp(name, "integer") == 0) return vpiIntegerVar;
+      if (strcmp(name, "net") == 0)     return vpiNet;
+      if (strcmp(name, "real") == 0)    return vpiRealVar;
+      if (strcmp(name, "reg") == 0)     return vpiReg;
+      if (strcmp(name, "time") == 0)    return vpiTimeVar;
+      return 0;
+}
+
+static void add_rule(int include, const char *pattern)
+{
+      struct filter_rule_s *cur;
+
+      rules = realloc(rules, (nrules+1) * sizeof(struct filter_rule_s));
+      cur = rules + nrules;
+      nrules += 1;
+
+      cur->include = include;
+      cur->pattern = strdup(pattern);
+      cur->prefix_len = strcspn(pattern, "*?[\\");
+      if (include) have_include = 1;
+}
+
+/*
+ * Read the rules file. Each line holds one rule, and a # starts a
+ * comment. The rules are:
+ *
+ *    include <glob>      dump the signals that match
+ *    exclude <glob>      do not dump the signals that match
+ *    maxdepth <n>        do not dump signals more than n scopes down
+ *    maxwidth <n>        do not dump signals wider than n bits
+ *    nomemories          do not dump array words
+ *    notype <type>       do not dump signals of this type (event,
+ *                        integer, net, real, reg or time)
+ */
+static void load_filter(const char *dumper, const char *path)
+{
+      char line[4096];
+      unsigned lineno = 0;
+      FILE *fd = fopen(path, "r");
+
+      if (fd == 0) {
+	    vpi_printf("%s warning: Unable to open dump filter file %s, "
+	               "dumping everything.\n", dumper, path);
+	    return;
+      }
+
+      while (fgets(line, sizeof line, fd)) {
+	    char *cmd, *arg, *cp;
+
+	    lineno += 1;
+	    if ((cp = strchr(line, '#'))) *cp = 0;
+
+	    cmd = strtok(line, " \t\r\n");
+	    if (cmd == 0) continue;
+	    arg = strtok(0, " \t\r\n");
+
+	    if (strcmp(cmd, "include") == 0 && arg) {
+		  add_rule(1, arg);
+	    } else if (strcmp(cmd, "exclude") == 0 && arg) {
+		  add_rule(0, arg);
+	    } else if (strcmp(cmd, "maxdepth") == 0 && arg) {
+		  max_depth = atoi(arg);
+	    } else if (strcmp(cmd, "maxwidth") == 0 && arg) {
+		  max_width = atol(arg);
+	    } else if (strcmp(cmd, "nomemories") == 0) {
+		  skip_memories = 1;
+	    } else if (strcmp(cmd, "notype") == 0 && arg &&
+	               type_by_name(arg) &&
+	               nskip_types < sizeof skip_types/sizeof skip_types[0]) {
+		  skip_types[nskip_types++] = type_by_name(arg);
+	    } else {
+		  vpi_printf("%s warning: %s:%u: Ignoring invalid dump "
+		             "filter rule.\n", dumper, path, lineno);
+	    }
+      }
+
+      fclose(fd);
+      vcd_filter_active = 1;
+}
+
+void vcd_filter_args(const char *dumper)
+{
+      struct t_vpi_vlog_info vlog_info;
+      int idx;
+
+      vpi_get_vlog_info(&vlog_info);
+      for (idx = 0 ;  idx < vlog_info.argc ;  idx += 1) {
+	    const char *arg = vlog_info.argv[idx];
+	    if (strncmp(arg, "+dumpfilter=", 12) == 0) {
+		  load_filter(dumper, arg+12);
+		  break;
+	    }
+      }
+}
+
+int vcd_filter_signal(vpiHandle item, const char *fullname,
+                      PLI_INT32 type, unsigned size)
+{
+      unsigned idx;
+      int res;
+
+      if (!vcd_filter_active) return 1;
+
+      if (skip_memories && type == vpiMemoryWord) goto drop;
+
+      for (idx = 0 ;  idx < nskip_types ;  idx += 1) {
+	    PLI_INT32 skip = skip_types[idx];
+	    if (type == skip) goto drop;
+	      /* The other variable types count as integers or regs. */
+	    if (skip == vpiIntegerVar && type == vpiIntVar) goto drop;
+	    if (skip == vpiReg && (type == vpiBitVar || type == vpiByteVar ||
+	                           type == vpiShortIntVar ||
+	                           type == vpiLongIntVar)) goto drop;
+      }
+
+      if (max_width >= 0 && (long)size > max_width) goto drop;
+
+	/* The depth is the number of scopes that hold the signal. It
+	 * is taken from the scopes and not the dots in the full name,
+	 * since an escaped identifier may hold dots. */
+      if (max_depth >= 0) {
+	    vpiHandle scope = vpi_handle(vpiScope, item);
+	    int depth = 0;
+	    while (scope) {
+		  depth += 1;
+		  if (depth > max_depth) goto drop;
+		  scope = vpi_handle(vpiScope, scope);
+	    }
+      }
+
+      res = !have_include;
+      for (idx = nrules ;  idx > 0 ;  idx -= 1) {
+	    struct filter_rule_s *cur = rules + idx - 1;
+	    if (strncmp(fullname, cur->pattern, cur->prefix_len) != 0)
+		  continue;
+	    if (glob_match(cur->pattern, fullname)) {
+		  res = cur->include;
+		  break;
+	    }
+      }
+
+      if (res) return 1;
+
+  drop:
+      dropped += 1;
+      return 0;
+}
+
+unsigned vcd_filter_dropped(void)
+{
+      return dropped;
+}
+
+void vcd_filter_delete(void)
+{
+      unsigned idx;
+
+      for (idx = 0 ;  idx < nrules ;  idx += 1) free(rules[idx].pattern);
+      free(rules);
+      rules = 0;
+      nrules = 0;
+      have_include = 0;
+      max_depth = -1;
+      max_width = -1;
+      skip_memories = 0;
+      nskip_types = 0;
+      dropped = 0;
+      vcd_filter_active = 0;
+}
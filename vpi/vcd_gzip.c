@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2012 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+#include  "sys_priv.h"
+#include  "vcd_priv.h"
+#include  <stdio.h>
+#include  <stdlib.h>
+#include  <string.h>
+#include  <assert.h>
+#include  <pthread.h>
+#include  <unistd.h>
+#include  <zlib.h>
+#ifdef __MINGW32__
+# include  <io.h>
+# include  <fcntl.h>
+#endif
+
+/*
+ * A compressed VCD file is written through a pipe. The dumper writes
+ * the text into the write end with the usual stdio calls, and a
+ * thread reads the other end and compresses it into the file, so the
+ * compression runs beside the simulation. There is only ever one
+ * VCD dump file, so the state is kept here.
+ *
+ * A flush request is a nul byte written into the pipe after the text
+ * that it covers. VCD text never holds a nul, so the thread knows
+ * exactly which data came before the request.
+ *
+ * If the thread cannot be started, the text is written into a
+ * temporary file instead, and compressed into the output file when
+ * the dump is closed.
+ */
+static FILE *gz_file = 0;
+static gzFile gz_out;
+static int gz_fd;
+static int gz_deferred;
+static pthread_t gz_thread;
+static pthread_mutex_t gz_lock = PTHREAD_MUTEX_INITIALIZER;
+static long gz_size;
+
+static void *vcd_gzip_thread(void *arg)
+{
+      char buf[64*1024];
+      int rc;
+
+      while ((rc = read(gz_fd, buf, sizeof(buf))) > 0) {
+	    char *cur = buf;
+	    char *end = buf + rc;
+	    char *mark;
+
+	    while ((mark = memchr(cur, 0, end - cur))) {
+		  if (mark > cur) gzwrite(gz_out, cur, mark - cur);
+		  gzflush(gz_out, Z_SYNC_FLUSH);
+		  cur = mark + 1;
+	    }
+	    if (end > cur) gzwrite(gz_out, cur, end - cur);
+
+	    pthread_mutex_lock(&gz_lock);
+	    gz_size = gzoffset(gz_out);
+	    pthread_mutex_unlock(&gz_lock);
+      }
+
+      gzclose(gz_out);
+      close(gz_fd);
+      return 0;
+}
+
+int vcd_gzip_path(const char *path)
+{
+      size_t len = strlen(path);
+      return len > 3 && strcmp(path + len - 3, ".gz") == 0;
+}
+
+FILE *vcd_gzip_open(const char *path)
+{
+      int fds[2];
+
+      assert(gz_file == 0);
+
+      gz_out = gzopen(path, "wb");
+      if (gz_out == 0) return 0;
+
+#ifdef __MINGW32__
+      if (_pipe(fds, 64*1024, _O_BINARY) != 0) {
+#else
+      if (pipe(fds) != 0) {
+#endif
+	    gzclose(gz_out);
+	    return 0;
+      }
+
+      gz_file = fdopen(fds[1], "w");
+      if (gz_file == 0) {
+	    close(fds[0]);
+	    close(fds[1]);
+	    gzclose(gz_out);
+	    return 0;
+      }
+
+      gz_fd = fds[0];
+      gz_size = 0;
+      gz_deferred = 0;
+      if (pthread_create(&gz_thread, 0, vcd_gzip_thread, 0) == 0)
+	    return gz_file;
+
+      fclose(gz_file);
+      close(gz_fd);
+      gz_file = tmpfile();
+      if (gz_file == 0) {
+	    gzclose(gz_out);
+	    return 0;
+      }
+
+      vpi_printf("VCD warning: Unable to start the compression thread, "
+                 "%s will be written when the dump is closed.\n", path);
+      gz_deferred = 1;
+      return gz_file;
+}
+
+/* Compress the deferred text into the output file. */
+static void vcd_gzip_deferred(FILE *file)
+{
+      char buf[64*1024];
+      size_t cnt;
+
+      rewind(file);
+      while ((cnt = fread(buf, 1, sizeof(buf), file)) > 0)
+	    gzwrite(gz_out, buf, cnt);
+      fclose(file);
+      gzclose(gz_out);
+}
+
+/*
+ * Ask the thread to flush the compressed stream when it has taken
+ * everything written so far, so a reader sees all of it.
+ */
+void vcd_gzip_flush(FILE *file)
+{
+      assert(file == gz_file);
+      if (!gz_deferred) fputc(0, file);
+      fflush(file);
+}
+
+/*
+ * The size of the compressed file so far. A deferred file is not
+ * compressed yet, so use the size of the text instead.
+ */
+long vcd_gzip_size(FILE *file)
+{
+      long res;
+
+      assert(file == gz_file);
+      if (gz_deferred) return ftell(file);
+      pthread_mutex_lock(&gz_lock);
+      res = gz_size;
+      pthread_mutex_unlock(&gz_lock);
+      return res;
+}
+
+/*
+ * Closing the pipe ends the thread, which then finishes the
+ * compressed file.
+ */
+void vcd_gzip_close(FILE *file)
+{
+      assert(file == gz_file);
+      if (gz_deferred) {
+	    vcd_gzip_deferred(file);
+      } else {
+	    fclose(file);
+	    pthread_join(gz_thread, 0);
+      }
+      gz_file = 0;
+}
@@ -20,6 +20,7 @@
  */
 
 #include "vpi_user.h"
+#include <stdio.h>
 
 #ifdef __cplusplus
 # define EXTERN extern "C"
@@ -48,11 +49,18 @@ EXTERN void vcd_names_sort(struct vcd_names_list_s*tab);
 EXTERN void vcd_names_delete();
 
 /*
- * Keep a map of nexus ident's to help with alias detection.
+ * Keep a map of nexus ident's to help with alias detection. The
+ * dumpers call find_nexus_ident for every signal they dump, and
+ * set_nexus_ident for every signal that gets its own callback, even
+ * if the nexus id is zero, so that the number of callbacks saved by
+ * the aliases can be counted. The ident is whatever the dumper uses
+ * to name the signal. With +dumpstats, nexus_ident_stats prints the
+ * counts.
  */
-EXTERN const char*find_nexus_ident(int nex);
-EXTERN void       set_nexus_ident(int nex, const char *id);
+EXTERN const void*find_nexus_ident(int nex);
+EXTERN void       set_nexus_ident(int nex, const void *id);
 
+EXTERN void nexus_ident_stats(const char*dumper);
 EXTERN void nexus_ident_delete();
 
 /*
@@ -126,6 +134,70 @@ EXTERN void vcd_work_dumpoff(void);
 EXTERN void vcd_work_emit_double(struct lxt2_wr_symbol*sym, double val);
 EXTERN void vcd_work_emit_bits(struct lxt2_wr_symbol*sym, const char*bits);
 
+/*
+ * The flight recorder keeps the most recent value changes in a ring
+ * buffer in memory instead of writing them out. A change is recorded
+ * as the time, the dumper's info for the signal and the bytes that
+ * the dumper would write. When the ring is full, or a record is older
+ * than the time window, the oldest record is given to the evict
+ * function, which keeps it as the base value of the signal. When the
+ * recorder is triggered, the dumper writes the base values at the
+ * base time and then drains the ring in order.
+ *
+ * vcd_ring_args looks for the +dumpwindow=<time> and +dumpbuffer=<MB>
+ * arguments, and returns true if either is present.
+ */
+struct vcd_ring_s;
+
+EXTERN int vcd_ring_args(size_t *size, PLI_UINT64 *window);
+EXTERN struct vcd_ring_s *vcd_ring_create(size_t size, PLI_UINT64 window,
+                                          void (*evict)(void *info,
+                                                        const char *data,
+                                                        unsigned len));
+EXTERN void vcd_ring_add(struct vcd_ring_s *ring, PLI_UINT64 time,
+                         void *info, const char *data, unsigned len);
+EXTERN int  vcd_ring_base_time(struct vcd_ring_s *ring, PLI_UINT64 *time);
+EXTERN void vcd_ring_drain(struct vcd_ring_s *ring,
+                           void (*emit)(PLI_UINT64 time, void *info,
+                                        const char *data, unsigned len));
+EXTERN void vcd_ring_delete(struct vcd_ring_s *ring);
+
+/*
+ * A dumper in flight recorder mode points this at the function that
+ * writes out the recording, so that $stop writes it as well.
+ */
+EXTERN void (*vcd_dump_trigger)(void);
+
+/*
+ * The +dumpfilter=<file> option names a file of rules that select the
+ * signals to dump by name, depth, width and type. vcd_filter_args
+ * reads the rules, and vcd_filter_signal returns true if the signal
+ * with the given handle and full name should be dumped. vcd_filter_active is set
+ * when there are rules, so the dumpers need only get the full name of
+ * each signal then. vcd_filter_dropped returns the number of signals
+ * that the rules have dropped.
+ */
+EXTERN int vcd_filter_active;
+EXTERN void vcd_filter_args(const char *dumper);
+EXTERN int  vcd_filter_signal(vpiHandle item, const char *fullname,
+                              PLI_INT32 type, unsigned size);
+EXTERN unsigned vcd_filter_dropped(void);
+EXTERN void vcd_filter_delete(void);
+
+/*
+ * Write a VCD file compressed with gzip. vcd_gzip_path tells if the
+ * file name ends in .gz. vcd_gzip_open returns a stdio stream that
+ * the dumper writes as usual, and a thread does the compression, so
+ * the stream must be closed with vcd_gzip_close. vcd_gzip_flush
+ * flushes both the stream and the compressed file, and vcd_gzip_size
+ * returns the size of the compressed file written so far.
+ */
+EXTERN int   vcd_gzip_path(const char *path);
+EXTERN FILE *vcd_gzip_open(const char *path);
+EXTERN void  vcd_gzip_flush(FILE *file);
+EXTERN long  vcd_gzip_size(FILE *file);
+EXTERN void  vcd_gzip_close(FILE *file);
+
 /* The compiletf routines are common for the VCD, LXT and LXT2 dumpers. */
 EXTERN PLI_INT32 sys_dumpvars_compiletf(ICARUS_VPI_CONST PLI_BYTE8 *name);
 
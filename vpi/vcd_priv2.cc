@@ -18,7 +18,6 @@
  */
 
 # include  "vcd_priv.h"
-# include  <map>
 # include  <set>
 # include  <string>
 # include  <pthread.h>
@@ -38,28 +37,120 @@
    will be installed.  This saves considerable CPU time and leads
    to smaller VCD files.
 
-   The _vpiNexusId is a private (int) property of IVL simulators.
+   The _vpiNexusId is a private (int) property of IVL simulators. It
+   is never zero for a real nexus, so a zero key marks an empty slot
+   in this open addressing hash table. The table is doubled whenever
+   it becomes half full.
 */
 
-static std::map<int,const char*> nexus_ident_map;
+struct nexus_slot_s {
+      int nex;
+      const void*id;
+};
 
-extern "C" const char*find_nexus_ident(int nex)
+static struct nexus_slot_s*nexus_table = 0;
+static unsigned nexus_mask = 0;
+static unsigned nexus_count = 0;
+
+static unsigned nexus_signals = 0;
+static unsigned nexus_callbacks = 0;
+
+static inline unsigned nexus_hash(int nex)
+{
+      return (unsigned)nex * 2654435761U;
+}
+
+static struct nexus_slot_s*nexus_find_slot(int nex)
+{
+      unsigned pos = nexus_hash(nex) & nexus_mask;
+      while (nexus_table[pos].nex != 0 && nexus_table[pos].nex != nex)
+	    pos = (pos + 1) & nexus_mask;
+      return nexus_table + pos;
+}
+
+static void nexus_rehash(unsigned size)
+{
+      struct nexus_slot_s*old_table = nexus_table;
+      unsigned old_size = old_table? nexus_mask+1 : 0;
+
+      nexus_table = new struct nexus_slot_s[size];
+      nexus_mask = size - 1;
+      for (unsigned idx = 0 ; idx < size ; idx += 1)
+	    nexus_table[idx].nex = 0;
+
+      for (unsigned idx = 0 ; idx < old_size ; idx += 1) {
+	    if (old_table[idx].nex == 0)
+		  continue;
+	    *nexus_find_slot(old_table[idx].nex) = old_table[idx];
+      }
+
+      delete[]old_table;
+}
+
+extern "C" const void*find_nexus_ident(int nex)
 {
-      std::map<int,const char*>::const_iterator cur = nexus_ident_map.find(nex);
-      if (cur == nexus_ident_map.end())
+      nexus_signals += 1;
+      if (nex == 0 || nexus_table == 0)
 	    return 0;
-      else
-	    return cur->second;
+
+      struct nexus_slot_s*cur = nexus_find_slot(nex);
+      return cur->nex? cur->id : 0;
+}
+
+/*
+ * The first ident set for a nexus stays, so a dumper that can not use
+ * an alias (the FST shards, for example) may still set its own.
+ */
+extern "C" void set_nexus_ident(int nex, const void*id)
+{
+      nexus_callbacks += 1;
+      if (nex == 0)
+	    return;
+
+      if (nexus_table == 0)
+	    nexus_rehash(1024);
+      else if (2*(nexus_count+1) > nexus_mask+1)
+	    nexus_rehash(2*(nexus_mask+1));
+
+      struct nexus_slot_s*cur = nexus_find_slot(nex);
+      if (cur->nex)
+	    return;
+
+      cur->nex = nex;
+      cur->id = id;
+      nexus_count += 1;
 }
 
-extern "C" void set_nexus_ident(int nex, const char*id)
+extern "C" void nexus_ident_stats(const char*dumper)
 {
-      nexus_ident_map[nex] = id;
+      struct t_vpi_vlog_info vlog_info;
+      bool flag = false;
+
+      vpi_get_vlog_info(&vlog_info);
+      for (int idx = 0 ; idx < vlog_info.argc ; idx += 1) {
+	    if (strcmp(vlog_info.argv[idx], "+dumpstats") == 0)
+		  flag = true;
+      }
+
+      if (!flag)
+	    return;
+
+      vpi_printf("%s info: %u signals dumped with %u callbacks, "
+		 "%u saved by aliases.\n", dumper, nexus_signals,
+		 nexus_callbacks, nexus_signals - nexus_callbacks);
+      if (vcd_filter_active)
+	    vpi_printf("%s info: %u signals dropped by +dumpfilter.\n",
+		       dumper, vcd_filter_dropped());
 }
 
 extern "C" void nexus_ident_delete()
 {
-      nexus_ident_map.clear();
+      delete[]nexus_table;
+      nexus_table = 0;
+      nexus_mask = 0;
+      nexus_count = 0;
+      nexus_signals = 0;
+      nexus_callbacks = 0;
 }
 
 
@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2012 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+#include  "sys_priv.h"
+#include  "vcd_priv.h"
+#include  "ivl_alloc.h"
+#include  <stdio.h>
+#include  <stdlib.h>
+#include  <string.h>
+#include  <assert.h>
+
+/*
+ * The records are packed one after the other in a circular byte
+ * buffer. A record that does not fit before the end of the buffer
+ * goes to the start of the buffer, and the space left at the end is
+ * marked with a record that has no info.
+ */
+struct vcd_ring_rec_s {
+      PLI_UINT64 time;
+      void *info;
+      unsigned len;
+};
+
+#define REC_ALIGN(x) (((x) + 7) & ~(size_t)7)
+#define REC_SIZE(len) REC_ALIGN(sizeof(struct vcd_ring_rec_s) + (len))
+
+struct vcd_ring_s {
+      char *buf;
+      size_t size;
+	/* The oldest record, where the next record goes, and the bytes
+	 * used, including any space skipped at the end. */
+      size_t head, tail, used;
+      PLI_UINT64 window;
+      void (*evict)(void *info, const char *data, unsigned len);
+	/* The time of the last record that was evicted. */
+      PLI_UINT64 base_time;
+      int have_base;
+};
+
+void (*vcd_dump_trigger)(void) = 0;
+
+int vcd_ring_args(size_t *size, PLI_UINT64 *window)
+{
+      struct t_vpi_vlog_info vlog_info;
+      int idx, flag = 0;
+
+      *size = 64;
+      *window = 0;
+
+      vpi_get_vlog_info(&vlog_info);
+      for (idx = 0 ;  idx < vlog_info.argc ;  idx += 1) {
+	    const char *arg = vlog_info.argv[idx];
+	    if (strncmp(arg, "+dumpwindow=", 12) == 0) {
+		  *window = strtoull(arg+12, 0, 10);
+		  flag = 1;
+	    } else if (strncmp(arg, "+dumpbuffer=", 12) == 0) {
+		  long mb = strtol(arg+12, 0, 10);
+		  if (mb > 0) *size = mb;
+		  flag = 1;
+	    }
+      }
+
+      *size *= 1024*1024;
+      return flag;
+}
+
+struct vcd_ring_s *vcd_ring_create(size_t size, PLI_UINT64 window,
+                                   void (*evict)(void *info,
+                                                 const char *data,
+                                                 unsigned len))
+{
+      struct vcd_ring_s *ring = calloc(1, sizeof(struct vcd_ring_s));
+      ring->size = REC_ALIGN(size);
+      ring->buf = malloc(ring->size);
+      ring->window = window;
+      ring->evict = evict;
+      return ring;
+}
+
+void vcd_ring_delete(struct vcd_ring_s *ring)
+{
+      free(ring->buf);
+      free(ring);
+}
+
+/*
+ * Take the oldest record out of the ring. The record stays valid
+ * until the next record is added. The head is always left at a
+ * record, so it moves past the space skipped at the end here.
+ */
+static struct vcd_ring_rec_s *ring_pop(struct vcd_ring_s *ring)
+{
+      struct vcd_ring_rec_s *rec;
+
+      assert(ring->used > 0);
+      rec = (struct vcd_ring_rec_s *)(ring->buf + ring->head);
+      ring->head += REC_SIZE(rec->len);
+      ring->used -= REC_SIZE(rec->len);
+
+      if (ring->used == 0) {
+	    ring->head = ring->tail = 0;
+      } else if (ring->size - ring->head < sizeof(struct vcd_ring_rec_s) ||
+                 ((struct vcd_ring_rec_s *)(ring->buf+ring->head))->info == 0) {
+	    ring->used -= ring->size - ring->head;
+	    ring->head = 0;
+      }
+
+      return rec;
+}
+
+static void ring_evict_oldest(struct vcd_ring_s *ring)
+{
+      struct vcd_ring_rec_s *rec = ring_pop(ring);
+      ring->evict(rec->info, (const char *)(rec + 1), rec->len);
+      ring->base_time = rec->time;
+      ring->have_base = 1;
+}
+
+void vcd_ring_add(struct vcd_ring_s *ring, PLI_UINT64 time, void *info,
+                  const char *data, unsigned len)
+{
+      size_t need = REC_SIZE(len);
+      struct vcd_ring_rec_s *rec;
+
+      assert(info);
+
+	/* Drop the records that are now outside the time window. */
+      while (ring->window && ring->used > 0 &&
+             time - ((struct vcd_ring_rec_s *)
+                     (ring->buf + ring->head))->time > ring->window)
+	    ring_evict_oldest(ring);
+
+	/* A record bigger than the whole ring goes straight to the
+	 * base values. */
+      if (need > ring->size) {
+	    while (ring->used > 0) ring_evict_oldest(ring);
+	    ring->evict(info, data, len);
+	    ring->base_time = time;
+	    ring->have_base = 1;
+	    return;
+      }
+
+      for (;;) {
+	    if (ring->used == 0) {
+		  ring->head = ring->tail = 0;
+		  break;
+	    }
+	    if (ring->tail > ring->head) {
+		    /* The free space is at the end and the start. */
+		  if (need <= ring->size - ring->tail) break;
+		  if (need <= ring->head) {
+			if (ring->size - ring->tail >=
+			    sizeof(struct vcd_ring_rec_s)) {
+			      rec = (struct vcd_ring_rec_s *)
+				    (ring->buf + ring->tail);
+			      rec->info = 0;
+			}
+			ring->used += ring->size - ring->tail;
+			ring->tail = 0;
+			break;
+		  }
+	    } else if (ring->tail < ring->head) {
+		  if (need <= ring->head - ring->tail) break;
+	    }
+	    ring_evict_oldest(ring);
+      }
+
+      rec = (struct vcd_ring_rec_s *)(ring->buf + ring->tail);
+      rec->time = time;
+      rec->info = info;
+      rec->len = len;
+      memcpy(rec + 1, data, len);
+      ring->tail += need;
+      ring->used += need;
+      if (ring->tail == ring->size) ring->tail = 0;
+}
+
+int vcd_ring_base_time(struct vcd_ring_s *ring, PLI_UINT64 *time)
+{
+      *time = ring->base_time;
+      return ring->have_base;
+}
+
+void vcd_ring_drain(struct vcd_ring_s *ring,
+                    void (*emit)(PLI_UINT64 time, void *info,
+                                 const char *data, unsigned len))
+{
+      while (ring->used > 0) {
+	    struct vcd_ring_rec_s *rec = ring_pop(ring);
+	    emit(rec->time, rec->info, (const char *)(rec + 1), rec->len);
+      }
+}
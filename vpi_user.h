@@ -465,6 +465,19 @@ typedef struct t_cb_data {
 #define cbExitInteractive   22
 #define cbInteractiveScopeChange 23
 #define cbUnresolvedSystf   24
+/* IVL private callback reasons */
+/*
+ * A _cbValueChangeBatch callback is placed on an object just like a
+ * cbValueChange callback, but the changes are not reported one at a
+ * time. The changes of all the _cbValueChangeBatch callbacks that
+ * have the same cb_rtn are collected during a time step, and the
+ * cb_rtn is called once for them in the read-only synch region. In
+ * that call the obj and value are nil, the index is the number of
+ * objects that changed, and the user_data points to an array (char**)
+ * of the user_data of their callbacks. Each object is listed once,
+ * in the order of its first change.
+ */
+#define _cbValueChangeBatch 0x1000000
 
 extern vpiHandle vpi_register_cb(p_cb_data data);
 extern PLI_INT32 vpi_remove_cb(vpiHandle ref);
@@ -604,6 +617,34 @@ extern void vpip_set_return_value(int value);
 extern s_vpi_vecval vpip_calc_clog2(vpiHandle arg);
 extern void vpip_make_systf_system_defined(vpiHandle ref);
 
+/*
+ * The vpip_hier_export function returns in one flat array the scope
+ * or signal ref and, for a scope, all the signals and scopes under it
+ * to the given depth. A depth of 1 gets the signals of the scope and
+ * no sub-scopes. The array is in depth first order, with the signals
+ * of a scope (events, nets, regs, then variables) before its
+ * sub-scopes, which is the order that vpi_iterate gives them in. The
+ * parent is the index of the enclosing scope in the array, or -1 for
+ * the first item. The names are in the array and remain valid until
+ * the array is released with vpip_hier_free.
+ */
+typedef struct t_vpip_hier_item {
+      vpiHandle obj;
+      const char*name;      /* vpiName */
+      const char*def_name;  /* vpiDefName of a module, otherwise 0 */
+      PLI_INT32 type;       /* vpiType */
+      PLI_INT32 parent;
+      PLI_INT32 net_type;   /* vpiNetType of a net, otherwise 0 */
+      PLI_INT32 automatic;  /* vpiAutomatic */
+      PLI_INT32 size;       /* vpiSize of a signal, otherwise 0 */
+      PLI_INT32 left_range, right_range;
+      PLI_INT32 nexus_id;   /* _vpiNexusId of a signal, otherwise 0 */
+} s_vpip_hier_item, *p_vpip_hier_item;
+
+extern p_vpip_hier_item vpip_hier_export(vpiHandle ref, PLI_INT32 depth,
+                                         PLI_INT32*count);
+extern void vpip_hier_free(p_vpip_hier_item items);
+
 EXTERN_C_END
 
 #endif
@@ -496,6 +496,68 @@ vvp_arith_sum::~vvp_arith_sum()
 {
 }
 
+/*
+ * Get the bits of a 2-state operand as an array of words that is
+ * wid bits wide. If the operand is narrower, the missing bits are
+ * filled from the pad word.
+ */
+static unsigned long* operand_words(const vvp_vector4_t&vec, unsigned wid,
+				    unsigned long pad)
+{
+      const unsigned BITS_PER_WORD = 8*sizeof(unsigned long);
+      unsigned words = (wid + BITS_PER_WORD - 1) / BITS_PER_WORD;
+      unsigned use = vec.size() < wid? vec.size() : wid;
+
+      unsigned long*bits = use? vec.subarray(0, use) : 0;
+      unsigned long*res = new unsigned long[words];
+      for (unsigned idx = 0 ;  idx < words ;  idx += 1) {
+	    unsigned base = idx * BITS_PER_WORD;
+	    if (base >= use) {
+		  res[idx] = pad;
+		  continue;
+	    }
+
+	    res[idx] = bits[idx];
+	    if (use - base < BITS_PER_WORD)
+		  res[idx] |= pad & (-1UL << (use - base));
+      }
+
+      delete[]bits;
+      return res;
+}
+
+/*
+ * When neither operand has X or Z bits, the sum can be calculated a
+ * word at a time, instead of a bit at a time. This does a+b+carry,
+ * or a+~b+carry if invert_b is true, with the operands padded as the
+ * bitwise loops do.
+ */
+static void add_2state(vvp_vector4_t&value, const vvp_vector4_t&a,
+		       unsigned long pad_a, const vvp_vector4_t&b,
+		       bool invert_b, unsigned long carry)
+{
+      const unsigned BITS_PER_WORD = 8*sizeof(unsigned long);
+      unsigned wid = value.size();
+      unsigned words = (wid + BITS_PER_WORD - 1) / BITS_PER_WORD;
+
+      unsigned long*aw = operand_words(a, wid, pad_a);
+      unsigned long*bw = operand_words(b, wid, 0);
+
+      for (unsigned idx = 0 ;  idx < words ;  idx += 1) {
+	    unsigned long bb = invert_b? ~bw[idx] : bw[idx];
+	    unsigned long sum = aw[idx] + bb;
+	    unsigned long c1 = sum < bb;
+	    sum += carry;
+	    unsigned long c2 = sum < carry;
+	    aw[idx] = sum;
+	    carry = c1 | c2;
+      }
+
+      value.setarray(0, wid, aw);
+      delete[]aw;
+      delete[]bw;
+}
+
 void vvp_arith_sum::recv_vec4(vvp_net_ptr_t ptr, const vvp_vector4_t&bit,
                               vvp_context_t)
 {
@@ -505,6 +567,13 @@ void vvp_arith_sum::recv_vec4(vvp_net_ptr_t ptr, const vvp_vector4_t&bit,
 
       vvp_vector4_t value (wid_);
 
+      if (wid_ > 0 && op_a_.size() > 0 && op_b_.size() > 0
+	  && !op_a_.has_xz() && !op_b_.has_xz()) {
+	    add_2state(value, op_a_, 0, op_b_, false, 0);
+	    net->send_vec4(value, 0);
+	    return;
+      }
+
 	/* Pad input vectors with this value to widen to the desired
 	   output width. */
       const vvp_bit4_t pad = BIT4_0;
@@ -550,6 +619,13 @@ void vvp_arith_sub::recv_vec4(vvp_net_ptr_t ptr, const vvp_vector4_t&bit,
 
       vvp_vector4_t value (wid_);
 
+      if (wid_ > 0 && op_a_.size() > 0 && op_b_.size() > 0
+	  && !op_a_.has_xz() && !op_b_.has_xz()) {
+	    add_2state(value, op_a_, -1UL, op_b_, true, 1);
+	    net->send_vec4(value, 0);
+	    return;
+      }
+
 	/* Pad input vectors with this value to widen to the desired
 	   output width. */
       const vvp_bit4_t pad = BIT4_1;
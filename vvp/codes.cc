@@ -25,6 +25,8 @@
 #endif
 # include  <cstring>
 # include  <cassert>
+# include  <algorithm>
+# include  <vector>
 
 /*
  * The code space is broken into chunks, to make for efficient
@@ -33,8 +35,6 @@
  * instruction to branch to the next chunk. This handles the case
  * where the program counter steps off the end of a chunk.
  */
-const unsigned code_chunk_size = 1024;
-
 static struct vvp_code_s *first_chunk = 0;
 static struct vvp_code_s *current_chunk = 0;
 static unsigned current_within_chunk = 0;
@@ -96,6 +96,113 @@ vvp_code_t codespace_null(void)
       return first_chunk + 0;
 }
 
+static bool fusion_flag = true;
+
+void codespace_set_fusion(bool flag)
+{
+      fusion_flag = flag;
+}
+
+/*
+ * These are the instruction sequences that the fusion pass knows
+ * about. Longer sequences must come before any shorter sequence that
+ * they start with.
+ */
+static const struct fuse_pattern_s {
+      unsigned len;
+      vvp_code_fun seq[3];
+      vvp_code_fun fused;
+} fuse_patterns[] = {
+      { 3, {of_LOAD_VEC, of_CMPIU, of_JMP0XZ}, of_LOAD_VEC_CMPIU_JMP0XZ },
+      { 2, {of_LOAD_VEC, of_JMP0XZ, 0},        of_LOAD_VEC_JMP0XZ },
+      { 2, {of_CMPIU,    of_JMP0XZ, 0},        of_CMPIU_JMP0XZ },
+      { 2, {of_CMPU,     of_JMP0XZ, 0},        of_CMPU_JMP0XZ },
+      { 2, {of_ADDI,     of_SET_VEC, 0},       of_ADDI_SET_VEC },
+      { 2, {of_MOV,      of_SET_VEC, 0},       of_MOV_SET_VEC }
+};
+
+static const unsigned fuse_pattern_count
+      = sizeof fuse_patterns / sizeof fuse_patterns[0];
+
+unsigned long codespace_fuse(void)
+{
+      if (! fusion_flag)
+	    return 0;
+
+      unsigned long count = 0;
+
+      for (vvp_code_t cur = first_chunk ; cur ; cur = cur[code_chunk_size-1].cptr) {
+	      /* Sequences never cross a chunk boundary, because
+		 the last instruction of a chunk is %chunk_link. */
+	    for (unsigned idx = 0 ; idx < code_chunk_size-1 ; idx += 1) {
+		  for (unsigned pat = 0 ; pat < fuse_pattern_count ; pat += 1) {
+			const fuse_pattern_s&fp = fuse_patterns[pat];
+			if (idx + fp.len > code_chunk_size-1)
+			      continue;
+
+			unsigned cnt = 0;
+			while (cnt < fp.len && cur[idx+cnt].opcode == fp.seq[cnt])
+			      cnt += 1;
+			if (cnt < fp.len)
+			      continue;
+
+			cur[idx].opcode = fp.fused;
+			count += 1;
+			idx += fp.len - 1;
+			break;
+		  }
+	    }
+      }
+
+      return count;
+}
+
+/*
+ * The decoded chunks are kept sorted by base address so that an
+ * instruction pointer can be mapped to its chunk with a binary
+ * search. The dispatch engine only needs to do this when a jump
+ * leaves the current chunk.
+ */
+static std::vector<vvp_code_chunk_s> decoded_chunks;
+
+static bool chunk_base_less(const vvp_code_chunk_s&a, const vvp_code_chunk_s&b)
+{
+      return a.base < b.base;
+}
+
+void codespace_decode(vvp_code_classify_fun classify)
+{
+      assert(decoded_chunks.empty());
+
+      for (vvp_code_t cur = first_chunk ; cur ; cur = cur[code_chunk_size-1].cptr) {
+	    vvp_code_chunk_s chunk;
+	    chunk.base = cur;
+	    chunk.ops = new unsigned char [code_chunk_size];
+	    for (unsigned idx = 0 ; idx < code_chunk_size ; idx += 1)
+		  chunk.ops[idx] = cur[idx].opcode? classify(cur[idx].opcode) : 0;
+
+	    decoded_chunks.push_back(chunk);
+      }
+
+      std::sort(decoded_chunks.begin(), decoded_chunks.end(), chunk_base_less);
+}
+
+const vvp_code_chunk_s* codespace_find_chunk(vvp_code_t cp)
+{
+      vvp_code_chunk_s key;
+      key.base = cp;
+      key.ops = 0;
+
+      std::vector<vvp_code_chunk_s>::const_iterator cur
+	    = std::upper_bound(decoded_chunks.begin(), decoded_chunks.end(),
+			  key, chunk_base_less);
+      assert(cur != decoded_chunks.begin());
+      cur -= 1;
+      assert(cp >= cur->base && cp < cur->base + code_chunk_size);
+
+      return &*cur;
+}
+
 #ifdef CHECK_WITH_VALGRIND
 void codespace_delete(void)
 {
@@ -125,5 +232,9 @@ void codespace_delete(void)
 	    delete [] cur;
 	    cur = next;
       } while (cur != 0);
+
+      for (unsigned idx = 0 ; idx < decoded_chunks.size() ; idx += 1)
+	    delete [] decoded_chunks[idx].ops;
+      decoded_chunks.clear();
 }
 #endif
@@ -175,6 +175,18 @@ extern bool of_EXEC_UFUNC(vthread_t thr, vvp_code_t code);
 
 extern bool of_CHUNK_LINK(vthread_t thr, vvp_code_t code);
 
+/*
+ * These are the fused opcodes that the codespace_fuse pass puts in
+ * place of common instruction sequences. Each executes the
+ * instruction it replaces and the instructions that follow it.
+ */
+extern bool of_ADDI_SET_VEC(vthread_t thr, vvp_code_t code);
+extern bool of_CMPIU_JMP0XZ(vthread_t thr, vvp_code_t code);
+extern bool of_CMPU_JMP0XZ(vthread_t thr, vvp_code_t code);
+extern bool of_LOAD_VEC_CMPIU_JMP0XZ(vthread_t thr, vvp_code_t code);
+extern bool of_LOAD_VEC_JMP0XZ(vthread_t thr, vvp_code_t code);
+extern bool of_MOV_SET_VEC(vthread_t thr, vvp_code_t code);
+
 /*
  * This is the format of a machine code instruction.
  */
@@ -216,4 +228,44 @@ extern vvp_code_t codespace_allocate(void);
 extern vvp_code_t codespace_next(void);
 extern vvp_code_t codespace_null(void);
 
+/*
+ * The codespace_fuse function looks for common sequences of
+ * instructions and replaces the first instruction of each with a
+ * fused opcode that executes the entire sequence in one dispatch. The
+ * remaining instructions of the sequence are left in place, so jumps
+ * into the middle of a sequence still work. This is done once the
+ * code space is complete, and returns the number of sequences that
+ * were fused. The pass can be disabled with codespace_set_fusion.
+ */
+extern void codespace_set_fusion(bool flag);
+extern unsigned long codespace_fuse(void);
+
+/*
+ * The code space is allocated in chunks of this many instructions.
+ * The last instruction of every chunk is a %chunk_link to the next.
+ */
+const unsigned code_chunk_size = 1024;
+
+/*
+ * The threaded dispatch engine in vthread.cc runs from a pre-decoded
+ * form of the code space. Each chunk gets a dense array with a small
+ * dispatch code for each instruction, which the engine maps to the
+ * handler that executes it. The codespace_decode function builds the
+ * arrays, using the classify function to pick a dispatch code for
+ * each opcode, and codespace_find_chunk returns the decoded chunk
+ * that holds an instruction.
+ */
+struct vvp_code_chunk_s {
+      vvp_code_t base;
+      unsigned char*ops;
+};
+
+typedef unsigned char (*vvp_code_classify_fun)(vvp_code_fun opcode);
+
+extern void codespace_decode(vvp_code_classify_fun classify);
+extern const struct vvp_code_chunk_s* codespace_find_chunk(vvp_code_t cp);
+
+/* This is the classify function for the vthread.cc dispatch engine. */
+extern unsigned char vthread_classify_opcode(vvp_code_fun opcode);
+
 #endif
@@ -28,6 +28,8 @@
 # include  "vpi_priv.h"
 # include  "parse_misc.h"
 # include  "statistics.h"
+# include  "parallel.h"
+# include  "profile.h"
 # include  <iostream>
 # include  <list>
 # include  <cstdlib>
@@ -701,6 +703,20 @@ void compile_cleanup(void)
       }
 
       vpi_mode_flag = VPI_MODE_NONE;
+
+	/* The code space is complete, so common instruction
+	   sequences can be fused and the result decoded for the
+	   threaded dispatch engine. */
+      count_opcodes_fused = codespace_fuse();
+
+      if (vthread_threaded_dispatch())
+	    codespace_decode(&vthread_classify_opcode);
+
+	/* The net graph is also complete, so it can be partitioned. */
+      if (parallel_jobs() > 1)
+	    parallel_partition_nets();
+
+      profile_start();
 }
 
 void compile_vpi_symbol(const char*label, vpiHandle obj)
@@ -724,6 +740,17 @@ void compile_init(void)
       codespace_init();
 }
 
+/*
+ * Most functor statements in a .vvp file are well over 100 bytes
+ * long, and there are several of them for each VPI object, so these
+ * estimates do not overshoot by much for large designs.
+ */
+void compile_size_hint(unsigned long bytes)
+{
+      sym_functors->sym_reserve(bytes / 128);
+      sym_vpi->sym_reserve(bytes / 512);
+}
+
 void compile_load_vpi_module(char*name)
 {
       vpip_load_module(name);
@@ -46,6 +46,12 @@ extern vector<const char*> file_names;
 
 extern void compile_init(void);
 
+/*
+ * The parser calls this with the size of the input file before it
+ * starts, so that the symbol tables can be sized up front.
+ */
+extern void compile_size_hint(unsigned long bytes);
+
 extern void compile_cleanup(void);
 
 extern bool verbose_flag;
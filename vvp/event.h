@@ -156,6 +156,8 @@ class vvp_fun_edge : public vvp_net_fun_t, public waitable_hooks_s {
       explicit vvp_fun_edge(edge_t e);
       virtual ~vvp_fun_edge();
 
+      bool sends_events(void) const { return true; }
+
     protected:
       bool recv_vec4_(const vvp_vector4_t&bit,
                       vvp_bit4_t&old_bit, vthread_t&threads);
@@ -232,6 +234,8 @@ class vvp_fun_anyedge : public vvp_net_fun_t, public waitable_hooks_s {
       explicit vvp_fun_anyedge();
       virtual ~vvp_fun_anyedge();
 
+      bool sends_events(void) const { return true; }
+
     protected:
       bool recv_vec4_(const vvp_vector4_t&bit,
                       vvp_vector4_t&old_bits, vthread_t&threads);
@@ -304,6 +308,8 @@ class vvp_fun_event_or : public vvp_net_fun_t, public waitable_hooks_s {
     public:
       explicit vvp_fun_event_or();
       ~vvp_fun_event_or();
+
+      bool sends_events(void) const { return true; }
 };
 
 /*
@@ -360,6 +366,8 @@ class vvp_named_event : public vvp_net_fun_t, public waitable_hooks_s {
       explicit vvp_named_event(class __vpiHandle*eh);
       ~vvp_named_event();
 
+      bool sends_events(void) const { return true; }
+
     protected:
       class __vpiHandle*handle_;
 };
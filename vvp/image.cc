@@ -0,0 +1,455 @@
+/*
+ * Copyright (c) 2012 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+# include  "config.h"
+# include  "version_base.h"
+# include  "image.h"
+# include  "parse_misc.h"
+# include  "compile.h"
+# include  "parse.h"
+# include  <vector>
+# include  <cstdio>
+# include  <cstdlib>
+# include  <cstring>
+# include  <cassert>
+#ifndef __MINGW32__
+# include  <sys/mman.h>
+# include  <sys/stat.h>
+# include  <fcntl.h>
+# include  <unistd.h>
+#endif
+
+/*
+ * The image file starts with this header, followed by the vvp
+ * version string, the source path and then the token records. Each
+ * token record is the token code and line number, followed by the
+ * semantic value for tokens that carry one. Strings are stored as a
+ * length followed by the characters, without the trailing nul.
+ */
+static const char image_magic[8] = { '\177', 'V', 'V', 'P', 'I', 'M', 'G', '\n' };
+static const uint32_t image_byte_order = 0x01020304;
+static const uint32_t image_format = 2;
+
+struct image_header_s {
+      char magic[8];
+      uint32_t byte_order;
+      uint32_t format;
+      uint64_t token_sum;
+      uint64_t src_size;
+      uint64_t src_sum;
+      uint64_t body_size;
+      uint64_t body_sum;
+      uint32_t version_len;
+      uint32_t path_len;
+};
+
+static uint64_t image_checksum(uint64_t sum, const char*buf, size_t len)
+{
+	// 64bit FNV-1a
+      for (size_t idx = 0 ; idx < len ; idx += 1) {
+	    sum ^= (unsigned char)buf[idx];
+	    sum *= 0x100000001b3ULL;
+      }
+      return sum;
+}
+
+static const uint64_t image_checksum_init = 0xcbf29ce484222325ULL;
+
+/*
+ * The token codes in the image are those of the parser that wrote
+ * it. The version string does not change with every edit of the
+ * grammar, so the header also carries a checksum of the token names
+ * in code order.
+ */
+static uint64_t token_checksum(void)
+{
+      uint64_t sum = image_checksum_init;
+      const char*name;
+      for (unsigned idx = 0 ; (name = parse_token_name(idx)) ; idx += 1)
+	    sum = image_checksum(sum, name, strlen(name)+1);
+      return sum;
+}
+
+/*
+ * Calculate the checksum of the source file. Return false if the
+ * file cannot be read.
+ */
+static bool source_checksum(const char*path, uint64_t&size, uint64_t&sum)
+{
+      FILE*fd = fopen(path, "rb");
+      if (fd == 0)
+	    return false;
+
+      char buf[65536];
+      size = 0;
+      sum = image_checksum_init;
+      for (;;) {
+	    size_t cnt = fread(buf, 1, sizeof buf, fd);
+	    if (cnt == 0)
+		  break;
+	    size += cnt;
+	    sum = image_checksum(sum, buf, cnt);
+      }
+
+      bool ok = ferror(fd) == 0;
+      fclose(fd);
+      return ok;
+}
+
+/*
+ * The tokens of the source file being compiled are collected here
+ * when an output image was requested.
+ */
+static const char*image_output = 0;
+static std::vector<char> image_body;
+
+void image_set_output(const char*path)
+{
+      image_output = path;
+}
+
+static void record_bytes(const void*data, size_t len)
+{
+      const char*ptr = static_cast<const char*>(data);
+      image_body.insert(image_body.end(), ptr, ptr+len);
+}
+
+static void record_u32(uint32_t val)
+{
+      record_bytes(&val, sizeof val);
+}
+
+static void record_text(const char*text)
+{
+      uint32_t len = strlen(text);
+      record_u32(len);
+      record_bytes(text, len);
+}
+
+static void record_token(int tok)
+{
+      record_u32(tok);
+      record_u32(yyline);
+
+      switch (tok) {
+	  case T_LABEL:
+	  case T_STRING:
+	  case T_INSTR:
+	  case T_SYMBOL:
+	    record_text(yylval.text);
+	    break;
+	  case T_NUMBER:
+	    record_bytes(&yylval.numb, sizeof yylval.numb);
+	    break;
+	  case T_VECTOR:
+	    record_u32(yylval.vect.idx);
+	    record_text(yylval.vect.text);
+	    break;
+	  default:
+	    break;
+      }
+}
+
+int image_write(const char*src_path)
+{
+      if (image_output == 0)
+	    return 0;
+
+      struct image_header_s head;
+      memset(&head, 0, sizeof head);
+      memcpy(head.magic, image_magic, sizeof head.magic);
+      head.byte_order = image_byte_order;
+      head.format = image_format;
+      head.token_sum = token_checksum();
+      if (! source_checksum(src_path, head.src_size, head.src_sum)) {
+	    fprintf(stderr, "%s: Unable to read source file.\n", src_path);
+	    return -1;
+      }
+
+      const char*body = image_body.empty()? "" : &image_body[0];
+      head.body_size = image_body.size();
+      head.body_sum = image_checksum(image_checksum_init, body,
+				     image_body.size());
+      head.version_len = strlen(VERSION);
+      head.path_len = strlen(src_path);
+
+      FILE*fd = fopen(image_output, "wb");
+      if (fd == 0) {
+	    fprintf(stderr, "%s: Unable to open image file for writing.\n",
+		    image_output);
+	    return -1;
+      }
+
+      fwrite(&head, sizeof head, 1, fd);
+      fwrite(VERSION, 1, head.version_len, fd);
+      fwrite(src_path, 1, head.path_len, fd);
+      fwrite(body, 1, image_body.size(), fd);
+
+      int rc = 0;
+      if (ferror(fd)) {
+	    fprintf(stderr, "%s: Error writing image file.\n", image_output);
+	    rc = -1;
+      }
+      if (fclose(fd) != 0)
+	    rc = -1;
+
+      std::vector<char>().swap(image_body);
+      return rc;
+}
+
+/*
+ * These describe the open image. The whole file is mapped (or read)
+ * into image_base, and image_cur/image_end are the token records
+ * that are yet to be given to the parser.
+ */
+static char*image_base = 0;
+static size_t image_size = 0;
+static bool image_mapped = false;
+static const char*image_cur = 0;
+static const char*image_end = 0;
+static char*image_src_path = 0;
+
+static bool load_file(const char*path)
+{
+#ifndef __MINGW32__
+      int fd = open(path, O_RDONLY);
+      if (fd < 0)
+	    return false;
+
+      struct stat sb;
+      if (fstat(fd, &sb) < 0 || sb.st_size == 0) {
+	    close(fd);
+	    return false;
+      }
+
+      void*base = mmap(0, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      close(fd);
+      if (base == MAP_FAILED)
+	    return false;
+
+      image_base = static_cast<char*>(base);
+      image_size = sb.st_size;
+      image_mapped = true;
+      return true;
+#else
+      FILE*fd = fopen(path, "rb");
+      if (fd == 0)
+	    return false;
+
+      fseek(fd, 0, SEEK_END);
+      long size = ftell(fd);
+      fseek(fd, 0, SEEK_SET);
+      if (size <= 0) {
+	    fclose(fd);
+	    return false;
+      }
+
+      image_base = (char*)malloc(size);
+      image_size = fread(image_base, 1, size, fd);
+      image_mapped = false;
+      fclose(fd);
+      return image_size == (size_t)size;
+#endif
+}
+
+void image_close(void)
+{
+      if (image_base) {
+#ifndef __MINGW32__
+	    if (image_mapped)
+		  munmap(image_base, image_size);
+	    else
+#endif
+		  free(image_base);
+      }
+
+      image_base = 0;
+      image_size = 0;
+      image_cur = 0;
+      image_end = 0;
+	/* The source path is kept, since yypath still refers to it. */
+}
+
+int image_open(const char*path)
+{
+	/* Only files that start with the magic number are images. */
+      FILE*fd = fopen(path, "rb");
+      if (fd == 0)
+	    return 0;
+
+      char magic[sizeof image_magic];
+      size_t cnt = fread(magic, 1, sizeof magic, fd);
+      fclose(fd);
+      if (cnt != sizeof magic || memcmp(magic, image_magic, sizeof magic) != 0)
+	    return 0;
+
+	/* The image is used as is, so there is nothing to write. */
+      if (image_output) {
+	    fprintf(stderr, "%s: warning: Input is already an image, "
+		    "ignoring -c %s.\n", path, image_output);
+	    image_output = 0;
+      }
+
+      if (! load_file(path)) {
+	    fprintf(stderr, "%s: Unable to load image file.\n", path);
+	    return -1;
+      }
+
+      struct image_header_s head;
+      if (image_size < sizeof head) {
+	    fprintf(stderr, "%s: Image file is truncated.\n", path);
+	    image_close();
+	    return -1;
+      }
+
+      memcpy(&head, image_base, sizeof head);
+      if (head.byte_order != image_byte_order || head.format != image_format) {
+	    fprintf(stderr, "%s: Image file format is not supported.\n", path);
+	    image_close();
+	    return -1;
+      }
+
+      const char*ptr = image_base + sizeof head;
+      if (image_size != sizeof head + head.version_len + head.path_len
+	                + head.body_size) {
+	    fprintf(stderr, "%s: Image file is truncated.\n", path);
+	    image_close();
+	    return -1;
+      }
+
+      if (head.version_len != strlen(VERSION)
+	  || strncmp(ptr, VERSION, head.version_len) != 0) {
+	    fprintf(stderr, "%s: Image file was made by a different version "
+		    "of vvp.\n", path);
+	    image_close();
+	    return -1;
+      }
+      ptr += head.version_len;
+
+      if (head.token_sum != token_checksum()) {
+	    fprintf(stderr, "%s: Image file was made by a different build "
+		    "of vvp.\n", path);
+	    image_close();
+	    return -1;
+      }
+
+      image_src_path = (char*)malloc(head.path_len + 1);
+      memcpy(image_src_path, ptr, head.path_len);
+      image_src_path[head.path_len] = 0;
+      ptr += head.path_len;
+
+      if (image_checksum(image_checksum_init, ptr, head.body_size)
+	  != head.body_sum) {
+	    fprintf(stderr, "%s: Image file is corrupt.\n", path);
+	    image_close();
+	    return -1;
+      }
+
+	/* If the source file is still around, make sure it has not
+	   changed since the image was made. */
+      uint64_t src_size, src_sum;
+      if (! source_checksum(image_src_path, src_size, src_sum)) {
+	    fprintf(stderr, "%s: warning: Source file %s is missing, "
+		    "using image as is.\n", path, image_src_path);
+
+      } else if (src_size != head.src_size || src_sum != head.src_sum) {
+	    fprintf(stderr, "%s: Image file is stale, recompile it "
+		    "from %s.\n", path, image_src_path);
+	    image_close();
+	    return -1;
+      }
+
+      compile_size_hint(head.src_size);
+
+	/* Messages from the parser refer to the source file. */
+      yypath = image_src_path;
+      image_cur = ptr;
+      image_end = ptr + head.body_size;
+      return 1;
+}
+
+static uint32_t replay_u32(void)
+{
+      uint32_t val;
+      assert(image_cur + sizeof val <= image_end);
+      memcpy(&val, image_cur, sizeof val);
+      image_cur += sizeof val;
+      return val;
+}
+
+static char* replay_text(bool use_new =false)
+{
+      uint32_t len = replay_u32();
+      assert(image_cur + len <= image_end);
+      char*text = use_new? new char [len+1] : (char*)malloc(len + 1);
+      memcpy(text, image_cur, len);
+      text[len] = 0;
+      image_cur += len;
+      return text;
+}
+
+/*
+ * Give the parser the next token from the image. The semantic values
+ * are allocated the same way that the lexor allocates them, so that
+ * the parser can release them in the usual way.
+ */
+static int replay_token(void)
+{
+      if (image_cur == image_end)
+	    return 0;
+
+      int tok = replay_u32();
+      yyline = replay_u32();
+
+      switch (tok) {
+	  case T_LABEL:
+	  case T_INSTR:
+	  case T_SYMBOL:
+	    yylval.text = replay_text();
+	    break;
+	  case T_STRING:
+	    yylval.text = replay_text(true);
+	    break;
+	  case T_NUMBER:
+	    assert(image_cur + sizeof yylval.numb <= image_end);
+	    memcpy(&yylval.numb, image_cur, sizeof yylval.numb);
+	    image_cur += sizeof yylval.numb;
+	    break;
+	  case T_VECTOR:
+	    yylval.vect.idx = replay_u32();
+	    yylval.vect.text = replay_text();
+	    break;
+	  default:
+	    break;
+      }
+
+      return tok;
+}
+
+int yylex(void)
+{
+      if (image_cur)
+	    return replay_token();
+
+      int tok = yylex_text();
+      if (image_output && tok != 0)
+	    record_token(tok);
+
+      return tok;
+}
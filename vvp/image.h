@@ -0,0 +1,67 @@
+#ifndef __image_H
+#define __image_H
+/*
+ * Copyright (c) 2012 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+/*
+ * A precompiled image is the token stream of a .vvp file, saved in
+ * a binary form that can be mapped into memory and handed to the
+ * parser without running the lexical analyzer again. The image
+ * header carries the vvp version, a checksum of the parser token
+ * table and a checksum of the source file, so an image that no
+ * longer matches its source or the vvp build is rejected.
+ *
+ * The parser gets its tokens from yylex(), which either replays an
+ * open image, or calls the flex scanner (yylex_text) and, if an
+ * output image was requested, records the tokens as they pass.
+ */
+
+/*
+ * Request that the tokens of the next compiled source file are saved
+ * into an image at the given path.
+ */
+extern void image_set_output(const char*path);
+
+/*
+ * Try to open the file as a precompiled image. Return 1 if the file
+ * is an image and the parser will read from it, 0 if it is not an
+ * image, or -1 (after printing a message) if it is an image that
+ * cannot be used.
+ */
+extern int image_open(const char*path);
+extern void image_close(void);
+
+/*
+ * Write out the tokens recorded while compiling the source file at
+ * the given path. Return 0 on success.
+ */
+extern int image_write(const char*src_path);
+
+/*
+ * The flex generated scanner.
+ */
+extern int yylex_text(void);
+
+/*
+ * Return the name of the parser token with the given symbol number,
+ * or nil if there is no such token.
+ */
+extern const char* parse_token_name(unsigned idx);
+
+#endif
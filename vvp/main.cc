@@ -22,9 +22,14 @@
 # include  "config.h"
 # include  "parse_misc.h"
 # include  "compile.h"
+# include  "codes.h"
 # include  "schedule.h"
 # include  "vpi_priv.h"
 # include  "statistics.h"
+# include  "parallel.h"
+# include  "profile.h"
+# include  "image.h"
+# include  "vvp_simd.h"
 # include  "vvp_cleanup.h"
 # include  <cstdio>
 # include  <cstdlib>
@@ -92,7 +97,7 @@ static void my_getrusage(struct rusage *a)
 #     endif
 }
 
-static void print_rusage(struct rusage *a, struct rusage *b)
+static double print_rusage(struct rusage *a, struct rusage *b)
 {
       double delta = a->ru_utime.tv_sec
 	    +        a->ru_utime.tv_usec/1E6
@@ -111,6 +116,8 @@ static void print_rusage(struct rusage *a, struct rusage *b)
 	      a->ru_maxrss/1024.0,
 	      (a->ru_idrss+a->ru_isrss)/1024.0,
 	      a->ru_ixrss/1024.0 );
+
+      return delta;
 }
 
 #else // ! defined(HAVE_SYS_RESOURCE_H)
@@ -118,7 +125,8 @@ static void print_rusage(struct rusage *a, struct rusage *b)
 // Provide dummies
 struct rusage { int x; };
 inline static void my_getrusage(struct rusage *) { }
-inline static void print_rusage(struct rusage *, struct rusage *){};
+inline static double print_rusage(struct rusage *, struct rusage *)
+{ return 0.0; }
 
 #endif // ! defined(HAVE_SYS_RESOURCE_H)
 
@@ -287,25 +295,41 @@ int main(int argc, char*argv[])
         /* For non-interactive runs we do not want to run the interactive
          * debugger, so make $stop just execute a $finish. */
       stop_is_finish = false;
-      while ((opt = getopt(argc, argv, "+hl:M:m:nNsvV")) != EOF) switch (opt) {
+      while ((opt = getopt(argc, argv, "+c:FhP:l:LM:m:nNp:sSTvV")) != EOF) switch (opt) {
+	  case 'c':
+	    image_set_output(optarg);
+	    break;
+	  case 'F':
+	    codespace_set_fusion(false);
+	    break;
          case 'h':
            fprintf(stderr,
                    "Usage: vvp [options] input-file [+plusargs...]\n"
                    "Options:\n"
+                   " -c file        Save a precompiled image of the input.\n"
+                   " -F             Do not fuse common instruction sequences.\n"
                    " -h             Print this help message.\n"
                    " -l file        Logfile, '-' for <stderr>\n"
+                   " -L             Use a linear list for the event queue.\n"
                    " -M path        VPI module directory\n"
 		   " -M -           Clear VPI module path\n"
                    " -m module      Load vpi module.\n"
 		   " -n             Non-interactive ($stop = $finish).\n"
                    " -N             Same as -n, but exit code is 1 instead of 0\n"
+                   " -p file        Write a profile of the simulation.\n"
+                   " -P N           Report the speedup that N jobs could achieve.\n"
 		   " -s             $stop right away.\n"
+                   " -S             Drop repeated values sent from a net.\n"
+                   " -T             Use threaded code dispatch for threads.\n"
                    " -v             Verbose progress messages.\n"
                    " -V             Print the version information.\n" );
            exit(0);
 	  case 'l':
 	    logfile_name = optarg;
 	    break;
+	  case 'L':
+	    schedule_set_time_list(true);
+	    break;
 	  case 'M':
 	    if (strcmp(optarg,"-") == 0) {
 		  vpip_module_path_cnt = 0;
@@ -324,9 +348,30 @@ int main(int argc, char*argv[])
             stop_is_finish = true;
             stop_is_finish_exit_code = 1;
             break;
+	  case 'p':
+	    profile_set_output(optarg);
+	    break;
+	  case 'P':
+	    if (atoi(optarg) < 1) {
+		  fprintf(stderr, "%s: -P requires a positive job count.\n",
+			  argv[0]);
+		  flag_errors += 1;
+	    } else {
+		  parallel_set_jobs(atoi(optarg));
+	    }
+	    break;
 	  case 's':
 	    schedule_stop(0);
 	    break;
+	  case 'S':
+	    vvp_net_t::set_send_cache(true);
+	    break;
+	  case 'T':
+	    if (! vthread_set_threaded_dispatch(true)) {
+		  fprintf(stderr, "%s: Threaded code dispatch is not "
+			  "supported by this build.\n", argv[0]);
+	    }
+	    break;
 	  case 'v':
 	    verbose_flag = true;
 	    break;
@@ -395,9 +440,13 @@ int main(int argc, char*argv[])
 
       vpip_mcd_init(logfile);
 
+      vvp_simd_init();
+
       if (verbose_flag) {
 	    my_getrusage(cycles+0);
 	    vpi_mcd_printf(1, "Compiling VVP ...\n");
+	    vpi_mcd_printf(1, " ... using %s vector kernels\n",
+			   vvp_simd->name);
       }
 
       vvp_vpi_init();
@@ -457,6 +506,10 @@ int main(int argc, char*argv[])
 	    vpi_mcd_printf(1, " ... %8lu opcodes (%zu bytes)\n",
 #endif
 	                   count_opcodes, size_opcodes);
+	    vpi_mcd_printf(1, "           %8lu fused sequences\n",
+			   count_opcodes_fused);
+	    vpi_mcd_printf(1, " ... %8lu symbol lookups (%lu probes)\n",
+			   count_symbol_lookups, count_symbol_probes);
 	    vpi_mcd_printf(1, " ... %8lu nets\n",     count_vpi_nets);
 #ifdef __MINGW32__  /* MinGW does not know about z. */
 	    vpi_mcd_printf(1, " ... %8lu vvp_nets (%u bytes)\n",
@@ -486,11 +539,14 @@ int main(int argc, char*argv[])
 
       if (verbose_flag) {
 	    my_getrusage(cycles+2);
-	    print_rusage(cycles+2, cycles+1);
+	    double run_time = print_rusage(cycles+2, cycles+1);
 
 	    vpi_mcd_printf(1, "Event counts:\n");
 	    vpi_mcd_printf(1, "    %8lu time steps (pool=%lu)\n",
 			   count_time_events, count_time_pool());
+	    vpi_mcd_printf(1, "    %8lu time step lookups (%lu probes, %s)\n",
+			   count_time_lookups, count_time_probes,
+			   schedule_time_list()? "list" : "wheel");
 	    vpi_mcd_printf(1, "    %8lu thread schedule events\n",
 		    count_thread_events);
 	    vpi_mcd_printf(1, "    %8lu assign events\n",
@@ -507,8 +563,27 @@ int main(int argc, char*argv[])
 			   count_assign_arword_pool());
 	    vpi_mcd_printf(1, "    %8lu other events (pool=%lu)\n",
 			   count_gen_events, count_gen_pool());
+	    vpi_mcd_printf(1, "Thread counts:\n");
+	    vpi_mcd_printf(1, "    %8lu opcodes executed", count_opcodes_executed);
+	    if (run_time > 0.0)
+		  vpi_mcd_printf(1, " (%.0f/s)",
+				 count_opcodes_executed / run_time);
+	    vpi_mcd_printf(1, ", %s dispatch\n",
+			   vthread_threaded_dispatch()? "threaded" : "call");
+	    if (vvp_net_t::send_cache()) {
+		  vpi_mcd_printf(1, "Net propagation:\n");
+		  vpi_mcd_printf(1, "    %8lu vec4 values sent, "
+				 "%lu suppressed\n",
+				 count_vec4_sends - count_vec4_suppressed,
+				 count_vec4_suppressed);
+	    }
       }
 
+      if (parallel_jobs() > 1)
+	    parallel_print_stats();
+
+      profile_finish();
+
       final_cleanup();
 
       return vvp_return_value;
@@ -0,0 +1,286 @@
+/*
+ * Copyright (c) 2012 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+# include  "parallel.h"
+# include  "logic.h"
+# include  "delay.h"
+# include  "part.h"
+# include  "udp.h"
+# include  "event.h"
+# include  "sfunc.h"
+# include  "ufunc.h"
+# include  "vvp_island.h"
+# include  "vpi_priv.h"
+# include  <algorithm>
+# include  <vector>
+# include  <cassert>
+
+static unsigned jobs_count = 1;
+
+void parallel_set_jobs(unsigned jobs)
+{
+      jobs_count = jobs? jobs : 1;
+}
+
+unsigned parallel_jobs(void)
+{
+      return jobs_count;
+}
+
+/*
+ * A functor that defers its work by scheduling itself only latches
+ * its inputs when a value arrives. Propagation into such a functor
+ * does not need to be in the same partition as its source.
+ */
+static bool functor_defers_input(vvp_net_fun_t*fun)
+{
+      if (fun == 0) return false;
+      if (dynamic_cast<vvp_fun_boolean_*>(fun)) return true;
+      if (dynamic_cast<vvp_fun_buf*>(fun)) return true;
+      if (dynamic_cast<vvp_fun_not*>(fun)) return true;
+      if (dynamic_cast<vvp_fun_muxz*>(fun)) return true;
+      if (dynamic_cast<vvp_fun_muxr*>(fun)) return true;
+      if (dynamic_cast<vvp_fun_delay*>(fun)) return true;
+      if (dynamic_cast<vvp_fun_modpath*>(fun)) return true;
+      if (dynamic_cast<vvp_fun_part_sa*>(fun)) return true;
+      return false;
+}
+
+/*
+ * These functors wake threads, run user functions or system
+ * functions, or share state with other nets. Their partitions are
+ * always run serially.
+ */
+static bool functor_is_serial(vvp_net_fun_t*fun)
+{
+      if (fun == 0) return false;
+      if (dynamic_cast<waitable_hooks_s*>(fun)) return true;
+      if (dynamic_cast<sfunc_core*>(fun)) return true;
+      if (dynamic_cast<ufunc_core*>(fun)) return true;
+      if (dynamic_cast<vvp_island_port*>(fun)) return true;
+      if (dynamic_cast<automatic_hooks_s*>(fun)) return true;
+      return false;
+}
+
+/*
+ * The partitions are built with a union-find over the nets, which
+ * are numbered by their position in the sorted nets list.
+ */
+struct partition_builder_s {
+      std::vector<vvp_net_t*> nets;
+      std::vector<size_t> parent;
+
+      size_t index(vvp_net_t*net) const;
+      size_t find(size_t idx);
+      void join(size_t a, size_t b);
+};
+
+size_t partition_builder_s::index(vvp_net_t*net) const
+{
+      std::vector<vvp_net_t*>::const_iterator cur
+	    = std::lower_bound(nets.begin(), nets.end(), net);
+      assert(cur != nets.end() && *cur == net);
+      return cur - nets.begin();
+}
+
+size_t partition_builder_s::find(size_t idx)
+{
+      while (parent[idx] != idx) {
+	    parent[idx] = parent[parent[idx]];
+	    idx = parent[idx];
+      }
+      return idx;
+}
+
+void partition_builder_s::join(size_t a, size_t b)
+{
+      a = find(a);
+      b = find(b);
+      if (a != b)
+	    parent[b] = a;
+}
+
+static void collect_net(vvp_net_t*net, void*data)
+{
+      partition_builder_s*pb = static_cast<partition_builder_s*>(data);
+      pb->nets.push_back(net);
+}
+
+typedef std::pair<const void*,unsigned> partition_key_t;
+
+/* The partition of each net and net functor, sorted by address. */
+static std::vector<partition_key_t> partition_keys;
+static unsigned partition_count = 0;
+static unsigned long serial_nets = 0;
+
+static bool key_less(const partition_key_t&a, const partition_key_t&b)
+{
+      return a.first < b.first;
+}
+
+void parallel_partition_nets(void)
+{
+      partition_builder_s pb;
+      vvp_net_pool_scan(&collect_net, &pb);
+      std::sort(pb.nets.begin(), pb.nets.end());
+
+      size_t count = pb.nets.size();
+      pb.parent.resize(count);
+      for (size_t idx = 0 ; idx < count ; idx += 1)
+	    pb.parent[idx] = idx;
+
+      for (size_t idx = 0 ; idx < count ; idx += 1) {
+	    vvp_net_ptr_t cur = pb.nets[idx]->output_list();
+	    while (! cur.nil()) {
+		  vvp_net_t*dst = cur.ptr();
+		  if (! functor_defers_input(dst->fun))
+			pb.join(idx, pb.index(dst));
+		  cur = dst->port[cur.port()];
+	    }
+      }
+
+	/* Number the partitions, starting from 1 because partition
+	   0 is for serial only work. */
+      std::vector<unsigned> root_id (count, 0);
+      std::vector<bool> root_serial (count, false);
+      for (size_t idx = 0 ; idx < count ; idx += 1) {
+	    if (functor_is_serial(pb.nets[idx]->fun))
+		  root_serial[pb.find(idx)] = true;
+      }
+
+      partition_keys.reserve(2*count);
+      for (size_t idx = 0 ; idx < count ; idx += 1) {
+	    size_t root = pb.find(idx);
+	    unsigned id = 0;
+	    if (root_serial[root]) {
+		  serial_nets += 1;
+	    } else {
+		  if (root_id[root] == 0)
+			root_id[root] = ++partition_count;
+		  id = root_id[root];
+	    }
+
+	    vvp_net_t*net = pb.nets[idx];
+	    partition_keys.push_back(partition_key_t(net, id));
+	    if (net->fun)
+		  partition_keys.push_back(
+			partition_key_t(dynamic_cast<const void*>(net->fun), id));
+      }
+
+      std::sort(partition_keys.begin(), partition_keys.end(), key_less);
+}
+
+unsigned parallel_partition(const void*key)
+{
+      if (key == 0)
+	    return 0;
+
+      std::vector<partition_key_t>::const_iterator cur
+	    = std::lower_bound(partition_keys.begin(), partition_keys.end(),
+			       partition_key_t(key, 0), key_less);
+      if (cur == partition_keys.end() || cur->first != key)
+	    return 0;
+
+      return cur->second;
+}
+
+/*
+ * The batch statistics. The events in a batch that are in the same
+ * partition must be run in order by a single worker, and serial
+ * events can not overlap anything, so the ideal time for a batch is
+ * the serial events plus the larger of the busiest partition or the
+ * parallel events divided among the jobs.
+ */
+static unsigned long batch_number = 0;
+static std::vector<unsigned long> batch_stamp;
+static std::vector<unsigned long> batch_part_events;
+static unsigned long batch_events = 0;
+static unsigned long batch_serial = 0;
+static unsigned long batch_width = 0;
+static unsigned long batch_busiest = 0;
+
+static unsigned long total_batches = 0;
+static unsigned long total_events = 0;
+static unsigned long total_serial = 0;
+static unsigned long total_ideal = 0;
+static unsigned long widest_batch = 0;
+
+void parallel_note_event(const void*key)
+{
+      unsigned part = parallel_partition(key);
+
+      batch_events += 1;
+      if (part == 0) {
+	    batch_serial += 1;
+	    return;
+      }
+
+      if (batch_stamp.size() <= part) {
+	    batch_stamp.resize(partition_count+1, 0);
+	    batch_part_events.resize(partition_count+1, 0);
+      }
+
+      if (batch_stamp[part] != batch_number+1) {
+	    batch_stamp[part] = batch_number+1;
+	    batch_part_events[part] = 0;
+	    batch_width += 1;
+      }
+
+      batch_part_events[part] += 1;
+      if (batch_part_events[part] > batch_busiest)
+	    batch_busiest = batch_part_events[part];
+}
+
+void parallel_end_batch(void)
+{
+      if (batch_events == 0)
+	    return;
+
+      unsigned long par = batch_events - batch_serial;
+      unsigned long split = (par + jobs_count - 1) / jobs_count;
+
+      total_batches += 1;
+      total_events += batch_events;
+      total_serial += batch_serial;
+      total_ideal += batch_serial + std::max(batch_busiest, split);
+      if (batch_width > widest_batch)
+	    widest_batch = batch_width;
+
+      batch_number += 1;
+      batch_events = 0;
+      batch_serial = 0;
+      batch_width = 0;
+      batch_busiest = 0;
+}
+
+void parallel_print_stats(void)
+{
+      parallel_end_batch();
+
+      vpi_mcd_printf(1, "Parallel analysis (%u jobs):\n", jobs_count);
+      vpi_mcd_printf(1, "    %8u net partitions (%lu nets serial only)\n",
+		     partition_count, serial_nets);
+      vpi_mcd_printf(1, "    %8lu active batches, widest %lu partitions\n",
+		     total_batches, widest_batch);
+      vpi_mcd_printf(1, "    %8lu active events (%lu serial only)\n",
+		     total_events, total_serial);
+      if (total_ideal > 0)
+	    vpi_mcd_printf(1, "    %8.2f ideal speedup\n",
+			   (double)total_events / (double)total_ideal);
+}
@@ -0,0 +1,67 @@
+#ifndef __parallel_H
+#define __parallel_H
+/*
+ * Copyright (c) 2012 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+# include  "vvp_net.h"
+
+/*
+ * These functions support the analysis of how much of the work in
+ * the active event queue could be spread across several processors.
+ *
+ * At load time the net graph is split into static partitions. Two
+ * nets are in the same partition if an output of one is delivered
+ * directly (without passing through the scheduler) into the other,
+ * so propagation that starts in one partition stays there. Functors
+ * that can wake threads or call back into the compiled code make
+ * their partition serial only.
+ *
+ * While the simulation runs, the scheduler reports each active event
+ * and the end of each batch of active events. The partitions touched
+ * by each batch are counted to estimate the speedup that could be
+ * had with the given number of jobs. The events are still executed
+ * one at a time, in the usual order.
+ */
+
+extern void parallel_set_jobs(unsigned jobs);
+extern unsigned parallel_jobs(void);
+
+/*
+ * Build the static partition of the net graph. This is called once
+ * the design is completely linked.
+ */
+extern void parallel_partition_nets(void);
+
+/*
+ * Return the partition for the object that an event works on. The
+ * key is a vvp_net_t pointer, or the most derived address of a net
+ * functor (from dynamic_cast<const void*>). Partition 0 is used for
+ * events that must be run serially.
+ */
+extern unsigned parallel_partition(const void*key);
+
+/*
+ * The scheduler calls these to describe the active events.
+ */
+extern void parallel_note_event(const void*key);
+extern void parallel_end_batch(void);
+
+extern void parallel_print_stats(void);
+
+#endif
@@ -22,6 +22,7 @@
 # include  "parse_misc.h"
 # include  "compile.h"
 # include  "delay.h"
+# include  "image.h"
 # include  <list>
 # include  <cstdio>
 # include  <cstdlib>
@@ -1093,17 +1094,51 @@ delay
 
 %%
 
+/*
+ * The image header carries a checksum of these names, since the
+ * token codes in an image only mean something to a parser made from
+ * the same grammar.
+ */
+const char* parse_token_name(unsigned idx)
+{
+      if (idx >= YYNTOKENS)
+	    return 0;
+      return yytname[idx];
+}
+
 int compile_design(const char*path)
 {
       yypath = path;
       yyline = 1;
+
+	/* A precompiled image replaces the lexor as the token source. */
+      int rc = image_open(path);
+      if (rc < 0)
+	    return -1;
+      if (rc > 0) {
+	    rc = yyparse();
+	    image_close();
+	    return rc;
+      }
+
       yyin = fopen(path, "r");
       if (yyin == 0) {
 	    fprintf(stderr, "%s: Unable to open input file.\n", path);
 	    return -1;
       }
 
-      int rc = yyparse();
+      if (fseek(yyin, 0, SEEK_END) == 0) {
+	    long size = ftell(yyin);
+	    if (size > 0)
+		  compile_size_hint(size);
+	    rewind(yyin);
+      }
+
+      rc = yyparse();
       fclose(yyin);
+
+      if (rc == 0 && image_write(path) != 0)
+	    rc = -1;
+
       return rc;
 }
@@ -0,0 +1,444 @@
+/*
+ * Copyright (c) 2012 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+# include  "config.h"
+# include  "profile.h"
+# include  "logic.h"
+# include  "bufif.h"
+# include  "npmos.h"
+# include  "arith.h"
+# include  "udp.h"
+# include  "resolv.h"
+# include  "delay.h"
+# include  "part.h"
+# include  "event.h"
+# include  "sfunc.h"
+# include  "ufunc.h"
+# include  "vvp_island.h"
+# include  "vvp_net_sig.h"
+# include  "vpi_priv.h"
+# include  <algorithm>
+# include  <string>
+# include  <vector>
+# include  <map>
+# include  <cstdio>
+# include  <cstring>
+#ifndef __MINGW32__
+# include  <csignal>
+# include  <sys/time.h>
+#endif
+
+/*
+ * The profile timer fires after this many microseconds of processor
+ * time.
+ */
+static const long SAMPLE_INTERVAL = 1000;
+
+struct profile_rec_s {
+      profile_rec_s() : events(0), opcodes(0), samples(0) { }
+      unsigned long events;
+      unsigned long opcodes;
+      volatile unsigned long samples;
+};
+
+/*
+ * The kinds of functors that work is charged to. Thread runs are
+ * charged to KIND_THREAD, and whatever runs outside of an event
+ * (callbacks, the scheduler itself) to KIND_SCHEDULER.
+ */
+enum profile_kind_t {
+      KIND_THREAD = 0,
+      KIND_LOGIC,
+      KIND_ARITH,
+      KIND_UDP,
+      KIND_RESOLV,
+      KIND_ISLAND,
+      KIND_SIGNAL,
+      KIND_EVENT,
+      KIND_DELAY,
+      KIND_PART,
+      KIND_SFUNC,
+      KIND_UFUNC,
+      KIND_OTHER,
+      KIND_SCHEDULER,
+      KIND_COUNT
+};
+
+static const char*kind_names[KIND_COUNT] = {
+      "thread", "logic", "arith", "udp", "resolv", "island", "signal",
+      "event", "delay", "part", "sfunc", "ufunc", "other", "scheduler"
+};
+
+static profile_rec_s kind_recs[KIND_COUNT];
+
+/*
+ * The scope records. Work that cannot be charged to a scope goes to
+ * the record for the nil scope.
+ */
+static std::map<struct __vpiScope*,profile_rec_s> scope_recs;
+static profile_rec_s*none_scope = 0;
+
+struct profile_target_s {
+      profile_rec_s*scope;
+      profile_rec_s*kind;
+};
+
+static std::map<const void*,profile_target_s> targets;
+
+static const char*profile_path = 0;
+static bool profile_started = false;
+static std::vector< std::pair<vvp_net_t*,struct __vpiScope*> > noted_nets;
+
+/*
+ * This is what is running right now. The sample handler reads these.
+ */
+static profile_rec_s*volatile cur_scope = 0;
+static profile_rec_s*volatile cur_kind = 0;
+static volatile unsigned long total_samples = 0;
+
+void profile_set_output(const char*path)
+{
+      profile_path = path;
+}
+
+bool profile_enabled(void)
+{
+      return profile_path != 0;
+}
+
+void profile_note_net(vvp_net_t*net)
+{
+      if (profile_started)
+	    return;
+
+      noted_nets.push_back(std::make_pair(net, vpip_peek_current_scope()));
+}
+
+static profile_kind_t classify_functor(vvp_net_fun_t*fun)
+{
+      if (fun == 0) return KIND_OTHER;
+      if (dynamic_cast<vvp_fun_boolean_*>(fun)) return KIND_LOGIC;
+      if (dynamic_cast<vvp_fun_buf*>(fun)) return KIND_LOGIC;
+      if (dynamic_cast<vvp_fun_bufz*>(fun)) return KIND_LOGIC;
+      if (dynamic_cast<vvp_fun_muxz*>(fun)) return KIND_LOGIC;
+      if (dynamic_cast<vvp_fun_muxr*>(fun)) return KIND_LOGIC;
+      if (dynamic_cast<vvp_fun_not*>(fun)) return KIND_LOGIC;
+      if (dynamic_cast<vvp_fun_bufif*>(fun)) return KIND_LOGIC;
+      if (dynamic_cast<vvp_fun_pmos_*>(fun)) return KIND_LOGIC;
+      if (dynamic_cast<vvp_fun_cmos_*>(fun)) return KIND_LOGIC;
+      if (dynamic_cast<vvp_arith_*>(fun)) return KIND_ARITH;
+      if (dynamic_cast<vvp_arith_real_*>(fun)) return KIND_ARITH;
+      if (dynamic_cast<vvp_arith_abs*>(fun)) return KIND_ARITH;
+      if (dynamic_cast<vvp_arith_cast_int*>(fun)) return KIND_ARITH;
+      if (dynamic_cast<vvp_arith_cast_real*>(fun)) return KIND_ARITH;
+      if (dynamic_cast<vvp_arith_cast_vec2*>(fun)) return KIND_ARITH;
+      if (dynamic_cast<vvp_udp_fun_core*>(fun)) return KIND_UDP;
+      if (dynamic_cast<resolv_functor*>(fun)) return KIND_RESOLV;
+      if (dynamic_cast<resolv_wired_logic*>(fun)) return KIND_RESOLV;
+      if (dynamic_cast<vvp_island_port*>(fun)) return KIND_ISLAND;
+      if (dynamic_cast<vvp_fun_signal_base*>(fun)) return KIND_SIGNAL;
+      if (dynamic_cast<waitable_hooks_s*>(fun)) return KIND_EVENT;
+      if (dynamic_cast<vvp_fun_delay*>(fun)) return KIND_DELAY;
+      if (dynamic_cast<vvp_fun_modpath*>(fun)) return KIND_DELAY;
+      if (dynamic_cast<vvp_fun_modpath_src*>(fun)) return KIND_DELAY;
+      if (dynamic_cast<vvp_fun_part*>(fun)) return KIND_PART;
+      if (dynamic_cast<vvp_fun_part_pv*>(fun)) return KIND_PART;
+      if (dynamic_cast<vvp_fun_part_var*>(fun)) return KIND_PART;
+      if (dynamic_cast<sfunc_core*>(fun)) return KIND_SFUNC;
+      if (dynamic_cast<ufunc_core*>(fun)) return KIND_UFUNC;
+      return KIND_OTHER;
+}
+
+static void add_target(const void*key, const profile_target_s&tgt)
+{
+	// The first net to claim an object keeps it.
+      targets.insert(std::make_pair(key, tgt));
+}
+
+#ifndef __MINGW32__
+static struct sigaction old_sigprof;
+
+static void profile_sample(int)
+{
+      profile_rec_s*scope = cur_scope;
+      profile_rec_s*kind = cur_kind;
+      if (scope) scope->samples += 1;
+      if (kind) kind->samples += 1;
+      total_samples += 1;
+}
+
+static void set_timer(long usec)
+{
+      struct itimerval tv;
+      tv.it_interval.tv_sec = 0;
+      tv.it_interval.tv_usec = usec;
+      tv.it_value = tv.it_interval;
+      setitimer(ITIMER_PROF, &tv, 0);
+}
+#endif
+
+void profile_start(void)
+{
+      if (profile_path == 0)
+	    return;
+
+      none_scope = &scope_recs[0];
+
+	/* Map each net, and the functor on it, to the scope that the
+	   net was compiled in and the kind of the functor. The
+	   scheduler identifies events by either of these. */
+      for (size_t idx = 0 ; idx < noted_nets.size() ; idx += 1) {
+	    vvp_net_t*net = noted_nets[idx].first;
+	    profile_target_s tgt;
+	    tgt.scope = &scope_recs[noted_nets[idx].second];
+	    tgt.kind = &kind_recs[classify_functor(net->fun)];
+
+	    add_target(net, tgt);
+	    if (net->fun == 0)
+		  continue;
+
+	    add_target(dynamic_cast<const void*>(net->fun), tgt);
+	    if (vvp_island_port*port = dynamic_cast<vvp_island_port*>(net->fun))
+		  add_target(dynamic_cast<const void*>(port->island()), tgt);
+      }
+      std::vector< std::pair<vvp_net_t*,struct __vpiScope*> >().swap(noted_nets);
+
+      profile_started = true;
+      cur_scope = none_scope;
+      cur_kind = &kind_recs[KIND_SCHEDULER];
+
+#ifndef __MINGW32__
+      struct sigaction sa;
+      memset(&sa, 0, sizeof sa);
+      sa.sa_handler = &profile_sample;
+      sa.sa_flags = SA_RESTART;
+      sigemptyset(&sa.sa_mask);
+      sigaction(SIGPROF, &sa, &old_sigprof);
+      set_timer(SAMPLE_INTERVAL);
+#endif
+}
+
+void profile_event_begin(const void*key)
+{
+      if (key == 0) {
+	      /* Thread events are charged by vthread_run. */
+	    return;
+      }
+
+      std::map<const void*,profile_target_s>::iterator cur = targets.find(key);
+      if (cur == targets.end()) {
+	    cur_scope = none_scope;
+	    cur_kind = &kind_recs[KIND_OTHER];
+      } else {
+	    cur_scope = cur->second.scope;
+	    cur_kind = cur->second.kind;
+      }
+
+      cur_scope->events += 1;
+      cur_kind->events += 1;
+}
+
+void profile_event_end(void)
+{
+      cur_scope = none_scope;
+      cur_kind = &kind_recs[KIND_SCHEDULER];
+}
+
+profile_mark_s profile_thread_begin(vthread_t thr)
+{
+      profile_mark_s mark;
+      mark.scope = cur_scope;
+      mark.kind = cur_kind;
+
+      profile_rec_s*scope = &scope_recs[vthread_scope(thr)];
+      scope->events += 1;
+      kind_recs[KIND_THREAD].events += 1;
+
+      cur_scope = scope;
+      cur_kind = &kind_recs[KIND_THREAD];
+      return mark;
+}
+
+void profile_thread_end(const profile_mark_s&mark, unsigned long opcodes)
+{
+      cur_scope->opcodes += opcodes;
+      cur_kind->opcodes += opcodes;
+
+      cur_scope = mark.scope;
+      cur_kind = mark.kind;
+}
+
+/*
+ * This is a row of the report.
+ */
+struct profile_row_s {
+      std::string name;
+      std::string type;
+      const profile_rec_s*rec;
+};
+
+static bool row_before(const profile_row_s&a, const profile_row_s&b)
+{
+      if (a.rec->samples != b.rec->samples)
+	    return a.rec->samples > b.rec->samples;
+      if (a.rec->opcodes != b.rec->opcodes)
+	    return a.rec->opcodes > b.rec->opcodes;
+      if (a.rec->events != b.rec->events)
+	    return a.rec->events > b.rec->events;
+      return a.name < b.name;
+}
+
+static bool rec_is_idle(const profile_rec_s&rec)
+{
+      return rec.samples == 0 && rec.opcodes == 0 && rec.events == 0;
+}
+
+static void collect_rows(std::vector<profile_row_s>&scopes,
+			 std::vector<profile_row_s>&kinds)
+{
+      for (std::map<struct __vpiScope*,profile_rec_s>::iterator cur
+		 = scope_recs.begin() ; cur != scope_recs.end() ; ++ cur) {
+	    if (rec_is_idle(cur->second))
+		  continue;
+
+	    profile_row_s row;
+	    row.rec = &cur->second;
+	    if (struct __vpiScope*scope = cur->first) {
+		  row.name = scope->vpi_get_str(vpiFullName);
+		  if (scope->tname)
+			row.type = scope->tname;
+	    } else {
+		  row.name = "(none)";
+	    }
+	    scopes.push_back(row);
+      }
+
+      for (unsigned idx = 0 ; idx < KIND_COUNT ; idx += 1) {
+	    if (rec_is_idle(kind_recs[idx]))
+		  continue;
+
+	    profile_row_s row;
+	    row.name = kind_names[idx];
+	    row.rec = &kind_recs[idx];
+	    kinds.push_back(row);
+      }
+
+      std::sort(scopes.begin(), scopes.end(), row_before);
+      std::sort(kinds.begin(), kinds.end(), row_before);
+}
+
+static double percent(unsigned long val)
+{
+      return total_samples? 100.0 * val / total_samples : 0.0;
+}
+
+static void write_text_rows(FILE*fd, const std::vector<profile_row_s>&rows)
+{
+      fprintf(fd, "%10s %6s %12s %14s  %s\n",
+	      "samples", "%", "events", "opcodes", "name");
+      for (size_t idx = 0 ; idx < rows.size() ; idx += 1) {
+	    const profile_rec_s*rec = rows[idx].rec;
+	    fprintf(fd, "%10lu %6.2f %12lu %14lu  %s",
+		    (unsigned long)rec->samples, percent(rec->samples),
+		    rec->events, rec->opcodes, rows[idx].name.c_str());
+	    if (! rows[idx].type.empty())
+		  fprintf(fd, " (%s)", rows[idx].type.c_str());
+	    fprintf(fd, "\n");
+      }
+}
+
+static void write_json_string(FILE*fd, const std::string&str)
+{
+      fputc('"', fd);
+      for (size_t idx = 0 ; idx < str.size() ; idx += 1) {
+	    unsigned char ch = str[idx];
+	    if (ch == '"' || ch == '\\')
+		  fprintf(fd, "\\%c", ch);
+	    else if (ch < 0x20)
+		  fprintf(fd, "\\u%04x", ch);
+	    else
+		  fputc(ch, fd);
+      }
+      fputc('"', fd);
+}
+
+static void write_json_rows(FILE*fd, const char*label,
+			    const std::vector<profile_row_s>&rows)
+{
+      fprintf(fd, "  \"%s\": [", label);
+      for (size_t idx = 0 ; idx < rows.size() ; idx += 1) {
+	    const profile_rec_s*rec = rows[idx].rec;
+	    fprintf(fd, "%s\n    { \"name\": ", idx? "," : "");
+	    write_json_string(fd, rows[idx].name);
+	    if (! rows[idx].type.empty()) {
+		  fprintf(fd, ", \"type\": ");
+		  write_json_string(fd, rows[idx].type);
+	    }
+	    fprintf(fd, ", \"samples\": %lu, \"events\": %lu, "
+		    "\"opcodes\": %lu }",
+		    (unsigned long)rec->samples, rec->events, rec->opcodes);
+      }
+      fprintf(fd, "\n  ]");
+}
+
+void profile_finish(void)
+{
+      if (! profile_started)
+	    return;
+
+#ifndef __MINGW32__
+      set_timer(0);
+      sigaction(SIGPROF, &old_sigprof, 0);
+#endif
+      profile_started = false;
+
+      std::vector<profile_row_s> scopes, kinds;
+      collect_rows(scopes, kinds);
+
+      FILE*fd = fopen(profile_path, "w");
+      if (fd == 0) {
+	    fprintf(stderr, "%s: Unable to open profile for writing.\n",
+		    profile_path);
+	    return;
+      }
+
+      fprintf(fd, "Profile: %lu samples of %ld us\n\n",
+	      (unsigned long)total_samples, SAMPLE_INTERVAL);
+      fprintf(fd, "Scopes:\n");
+      write_text_rows(fd, scopes);
+      fprintf(fd, "\nFunctor kinds:\n");
+      write_text_rows(fd, kinds);
+      fclose(fd);
+
+      std::string json_path = std::string(profile_path) + ".json";
+      fd = fopen(json_path.c_str(), "w");
+      if (fd == 0) {
+	    fprintf(stderr, "%s: Unable to open profile for writing.\n",
+		    json_path.c_str());
+	    return;
+      }
+
+      fprintf(fd, "{\n  \"sample_interval_us\": %ld,\n", SAMPLE_INTERVAL);
+      fprintf(fd, "  \"samples\": %lu,\n", (unsigned long)total_samples);
+      write_json_rows(fd, "scopes", scopes);
+      fprintf(fd, ",\n");
+      write_json_rows(fd, "functors", kinds);
+      fprintf(fd, "\n}\n");
+      fclose(fd);
+}
@@ -0,0 +1,83 @@
+#ifndef __profile_H
+#define __profile_H
+/*
+ * Copyright (c) 2012 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+# include  "vvp_net.h"
+# include  "vthread.h"
+
+/*
+ * These functions collect a profile of where the simulation spends
+ * its time. The work is charged to the scope (module instance, task,
+ * named block...) that it belongs to, and to the kind of functor
+ * that does it:
+ *
+ *   - Each thread run is charged to the scope of the thread, with
+ *     the number of opcodes that it executed.
+ *
+ *   - Each active event that works on a net or functor is charged to
+ *     the scope that was current when the net was compiled, and to
+ *     the kind of functor on the net.
+ *
+ *   - A profiling timer periodically samples whatever is running at
+ *     the time, so that the report shows where the time goes.
+ *
+ * At the end of the simulation a report sorted by samples is written
+ * to the output file, and the same data in JSON form is written to
+ * the output file with a .json suffix added.
+ */
+
+extern void profile_set_output(const char*path);
+extern bool profile_enabled(void);
+
+/*
+ * The vvp_net_t allocator calls this for every new net while the
+ * design is compiled, to remember the scope that the net is in.
+ */
+extern void profile_note_net(vvp_net_t*net);
+
+/*
+ * Start the profile once the design is completely linked, and finish
+ * it (and write the report) after the simulation.
+ */
+extern void profile_start(void);
+extern void profile_finish(void);
+
+/*
+ * The scheduler calls these around each active event. The key is the
+ * same as the one given to the parallel analysis.
+ */
+extern void profile_event_begin(const void*key);
+extern void profile_event_end(void);
+
+/*
+ * vthread_run calls these around each run of a thread. Threads can
+ * run other threads, so the begin returns the current mark and the
+ * end puts it back.
+ */
+struct profile_mark_s {
+      struct profile_rec_s*scope;
+      struct profile_rec_s*kind;
+};
+
+extern profile_mark_s profile_thread_begin(vthread_t thr);
+extern void profile_thread_end(const profile_mark_s&mark,
+			       unsigned long opcodes);
+
+#endif
@@ -22,6 +22,9 @@
 # include  "vpi_priv.h"
 # include  "slab.h"
 # include  "compile.h"
+# include  "statistics.h"
+# include  "parallel.h"
+# include  "profile.h"
 # include  <new>
 # include  <typeinfo>
 # include  <csignal>
@@ -29,6 +32,7 @@
 # include  <cassert>
 
 # include  <iostream>
+# include  <map>
 
 unsigned long count_assign_events = 0;
 unsigned long count_gen_events = 0;
@@ -56,6 +60,10 @@ struct event_s {
 	// Write something about the event to stderr
       virtual void single_step_display(void);
 
+	// The net or functor that this event works on, if any. This
+	// is used to find the partition for the parallel analysis.
+      virtual const void* parallel_key(void) const { return 0; }
+
 	// Fallback new/delete
       static void*operator new (size_t size) { return ::new char[size]; }
       static void operator delete(void*ptr)  { ::delete[]( (char*)ptr ); }
@@ -77,7 +85,11 @@ struct event_time_s {
 	    del_thr = 0;
 	    next = NULL;
       }
+	// Delay relative to the previous time step (or to the current
+	// time if this is the head of the queue.)
       vvp_time64_t delay;
+	// Absolute time of this time step. Only used by the timing wheel.
+      vvp_time64_t time;
 
       struct event_s*start;
       struct event_s*active;
@@ -182,6 +194,7 @@ struct assign_vector4_event_s  : public event_s {
       unsigned vwid;
       void run_run(void);
       void single_step_display(void);
+      const void* parallel_key(void) const { return ptr.ptr(); }
 
       static void* operator new(size_t);
       static void operator delete(void*);
@@ -223,6 +236,7 @@ struct assign_vector8_event_s  : public event_s {
       vvp_vector8_t val;
       void run_run(void);
       void single_step_display(void);
+      const void* parallel_key(void) const { return ptr.ptr(); }
 
       static void* operator new(size_t);
       static void operator delete(void*);
@@ -260,6 +274,7 @@ struct assign_real_event_s  : public event_s {
       double val;
       void run_run(void);
       void single_step_display(void);
+      const void* parallel_key(void) const { return ptr.ptr(); }
 
       static void* operator new(size_t);
       static void operator delete(void*);
@@ -347,6 +362,7 @@ struct propagate_vector4_event_s : public event_s {
 	/* Action */
       void run_run(void);
       void single_step_display(void);
+      const void* parallel_key(void) const { return net; }
 };
 
 void propagate_vector4_event_s::run_run(void)
@@ -371,6 +387,7 @@ struct propagate_real_event_s : public event_s {
 	/* Action */
       void run_run(void);
       void single_step_display(void);
+      const void* parallel_key(void) const { return net; }
 };
 
 void propagate_real_event_s::run_run(void)
@@ -419,6 +436,8 @@ struct generic_event_s : public event_s {
       bool delete_obj_when_done;
       void run_run(void);
       void single_step_display(void);
+      const void* parallel_key(void) const
+      { return obj? dynamic_cast<const void*>(obj) : 0; }
 
       static void* operator new(size_t);
       static void operator delete(void*);
@@ -481,10 +500,174 @@ unsigned long count_time_pool(void) { return event_time_heap.pool; }
 /*
  * This is the head of the list of pending events. This includes all
  * the events that have not been executed yet, and reaches into the
- * future.
+ * future. When the timing wheel is in use this is only the earliest
+ * time step, and the remaining time steps are found in the wheel.
  */
 static struct event_time_s* sched_list = 0;
 
+static vvp_time64_t schedule_time;
+
+/*
+ * The pending time steps are normally kept in a timing wheel. The
+ * wheel has a slot for each of the next WHEEL_SIZE time units after
+ * the current time, so finding (or creating) a near future time step
+ * is a direct index. Time steps that are further away are kept in an
+ * ordered overflow map, and are moved into the wheel as the
+ * simulation time advances far enough for them to fit.
+ *
+ * The wheel_used bit map marks the occupied slots so that finding the
+ * next time step does not need to look at every slot.
+ *
+ * The original linear list of relative delays is still available (see
+ * schedule_set_time_list) for comparison and debugging.
+ */
+static bool sched_list_flag = false;
+
+static const unsigned WHEEL_BITS = 12;
+static const vvp_time64_t WHEEL_SIZE = 1 << WHEEL_BITS;
+static const unsigned WHEEL_MASK = WHEEL_SIZE - 1;
+static const unsigned WHEEL_WORD = 8 * sizeof(unsigned long);
+
+static struct event_time_s* wheel_slot[WHEEL_SIZE];
+static unsigned long wheel_used[WHEEL_SIZE / WHEEL_WORD];
+static unsigned long wheel_count = 0;
+static std::map<vvp_time64_t,struct event_time_s*> wheel_overflow;
+
+void schedule_set_time_list(bool flag)
+{
+      assert(sched_list == 0);
+      sched_list_flag = flag;
+}
+
+bool schedule_time_list(void)
+{
+      return sched_list_flag;
+}
+
+static inline void wheel_insert_(struct event_time_s*ctim)
+{
+      unsigned idx = ctim->time & WHEEL_MASK;
+      assert(wheel_slot[idx] == 0);
+      wheel_slot[idx] = ctim;
+      wheel_used[idx / WHEEL_WORD] |= 1UL << (idx % WHEEL_WORD);
+      wheel_count += 1;
+}
+
+/*
+ * Return the index of the first used slot at or after idx, wrapping
+ * around the end of the wheel. The caller must know that there is at
+ * least one used slot.
+ */
+static unsigned wheel_next_used_(unsigned idx)
+{
+      unsigned word = idx / WHEEL_WORD;
+      unsigned long bits = wheel_used[word] & (~0UL << (idx % WHEEL_WORD));
+
+      for (unsigned cnt = 0 ; cnt <= WHEEL_SIZE/WHEEL_WORD ; cnt += 1) {
+	    count_time_probes += 1;
+	    if (bits != 0) {
+		  unsigned bit = 0;
+#if defined(__GNUC__)
+		  bit = __builtin_ctzl(bits);
+#else
+		  while ((bits & 1UL) == 0) {
+			bits >>= 1;
+			bit += 1;
+		  }
+#endif
+		  return word * WHEEL_WORD + bit;
+	    }
+	    word = (word + 1) % (WHEEL_SIZE / WHEEL_WORD);
+	    bits = wheel_used[word];
+      }
+
+      assert(0);
+      return 0;
+}
+
+/*
+ * Make ctim the head of the queue, and give it a delay relative to
+ * the current simulation time.
+ */
+static inline void wheel_set_head_(struct event_time_s*ctim)
+{
+      sched_list = ctim;
+      if (ctim) ctim->delay = ctim->time - schedule_time;
+}
+
+/*
+ * The simulation time has advanced, so the wheel now covers a later
+ * range of times. Move any overflow time steps that now fit.
+ */
+static void wheel_advance_(void)
+{
+      while (! wheel_overflow.empty()) {
+	    std::map<vvp_time64_t,struct event_time_s*>::iterator cur
+		  = wheel_overflow.begin();
+	    if (cur->first - schedule_time >= WHEEL_SIZE)
+		  break;
+
+	    wheel_insert_(cur->second);
+	    wheel_overflow.erase(cur);
+      }
+}
+
+static struct event_time_s* wheel_find_time_(vvp_time64_t delay)
+{
+      vvp_time64_t when = schedule_time + delay;
+      struct event_time_s*ctim;
+
+      count_time_probes += 1;
+      if (delay < WHEEL_SIZE) {
+	    ctim = wheel_slot[when & WHEEL_MASK];
+	    if (ctim) {
+		  assert(ctim->time == when);
+		  return ctim;
+	    }
+
+	    ctim = new struct event_time_s;
+	    ctim->time = when;
+	    wheel_insert_(ctim);
+
+      } else {
+	    struct event_time_s*&ref = wheel_overflow[when];
+	    if (ref)
+		  return ref;
+
+	    ctim = new struct event_time_s;
+	    ctim->time = when;
+	    ref = ctim;
+      }
+
+      if (sched_list == 0 || when < sched_list->time)
+	    wheel_set_head_(ctim);
+
+      return ctim;
+}
+
+/*
+ * Remove the head time step, which must be the current time, from
+ * the wheel and locate the next time step.
+ */
+static void wheel_pop_head_(struct event_time_s*ctim)
+{
+      assert(ctim == sched_list);
+      assert(ctim->time == schedule_time);
+
+      unsigned idx = ctim->time & WHEEL_MASK;
+      assert(wheel_slot[idx] == ctim);
+      wheel_slot[idx] = 0;
+      wheel_used[idx / WHEEL_WORD] &= ~(1UL << (idx % WHEEL_WORD));
+      wheel_count -= 1;
+
+      if (wheel_count > 0)
+	    wheel_set_head_(wheel_slot[wheel_next_used_(idx)]);
+      else if (! wheel_overflow.empty())
+	    wheel_set_head_(wheel_overflow.begin()->second);
+      else
+	    wheel_set_head_(0);
+}
+
 /*
  * This is a list of initialization events. The setup puts
  * initializations in this list so that they happen before the
@@ -587,11 +770,8 @@ static void schedule_final_event(struct event_s*cur)
 typedef enum event_queue_e { SEQ_START, SEQ_ACTIVE, SEQ_NBASSIGN,
 			     SEQ_RWSYNC, SEQ_ROSYNC, DEL_THREAD } event_queue_t;
 
-static void schedule_event_(struct event_s*cur, vvp_time64_t delay,
-			    event_queue_t select_queue)
+static struct event_time_s* list_find_time_(vvp_time64_t delay)
 {
-      cur->next = cur;
-
       struct event_time_s*ctim = sched_list;
 
       if (sched_list == 0) {
@@ -617,6 +797,7 @@ static void schedule_event_(struct event_s*cur, vvp_time64_t delay,
 	    struct event_time_s*prev = 0;
 
 	    while (ctim->next && (ctim->delay < delay)) {
+		  count_time_probes += 1;
 		  delay -= ctim->delay;
 		  prev = ctim;
 		  ctim = ctim->next;
@@ -644,6 +825,19 @@ static void schedule_event_(struct event_s*cur, vvp_time64_t delay,
 	    }
       }
 
+      return ctim;
+}
+
+static void schedule_event_(struct event_s*cur, vvp_time64_t delay,
+			    event_queue_t select_queue)
+{
+      cur->next = cur;
+
+      count_time_lookups += 1;
+      struct event_time_s*ctim = sched_list_flag
+	    ? list_find_time_(delay)
+	    : wheel_find_time_(delay);
+
 	/* By this point, ctim is the event_time structure that is to
 	   receive the event at hand. Put the event in to the
 	   appropriate list for the kind of assign we have at hand. */
@@ -944,7 +1138,6 @@ void schedule_at_start_of_simtime(vvp_gen_event_t obj, vvp_time64_t delay)
       schedule_event_(cur, delay, SEQ_START);
 }
 
-static vvp_time64_t schedule_time;
 vvp_time64_t schedule_simtime(void)
 { return schedule_time; }
 
@@ -1065,6 +1258,8 @@ void schedule_simulate(void)
 			     << schedule_time << endl;
 		  }
 		  ctim->delay = 0;
+		  if (! sched_list_flag)
+			wheel_advance_();
 
 		  vpiNextSimTime();
 		    // Process the cbAtStartOfSimTime callbacks.
@@ -1085,6 +1280,9 @@ void schedule_simulate(void)
 		 queues. If there are not events at all, then release
 		 the event_time object. */
 	    if (ctim->active == 0) {
+		  if (parallel_jobs() > 1)
+			parallel_end_batch();
+
 		  ctim->active = ctim->nbassign;
 		  ctim->nbassign = 0;
 
@@ -1097,7 +1295,10 @@ void schedule_simulate(void)
 			     deletes threads as needed. */
 			if (ctim->active == 0) {
 			      run_rosync(ctim);
-			      sched_list = ctim->next;
+			      if (sched_list_flag)
+				    sched_list = ctim->next;
+			      else
+				    wheel_pop_head_(ctim);
 			      delete ctim;
 			      continue;
 			}
@@ -1114,13 +1315,22 @@ void schedule_simulate(void)
 		  ctim->active->next = cur->next;
 	    }
 
+	    if (parallel_jobs() > 1)
+		  parallel_note_event(cur->parallel_key());
+
 	    if (schedule_single_step_flag) {
 		  cur->single_step_display();
 		  schedule_stopped_flag = true;
 		  schedule_single_step_flag = false;
 	    }
 
-	    cur->run_run();
+	    if (profile_enabled()) {
+		  profile_event_begin(cur->parallel_key());
+		  cur->run_run();
+		  profile_event_end();
+	    } else {
+		  cur->run_run();
+	    }
 
 	    delete (cur);
       }
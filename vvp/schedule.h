@@ -146,6 +146,15 @@ struct vvp_gen_event_s
       virtual void single_step_display(void);
 };
 
+/*
+ * Pending time steps are normally kept in a timing wheel. Passing
+ * true to schedule_set_time_list selects the original linear list of
+ * time steps instead. This must be called before any events are
+ * scheduled.
+ */
+extern void schedule_set_time_list(bool flag);
+extern bool schedule_time_list(void);
+
 /*
  * This runs the simulator. It runs until all the functors run out or
  * the simulation is otherwise finished.
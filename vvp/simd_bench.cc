@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2012 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+/*
+ * This program times the vector kernels that the processor supports
+ * against the scalar kernels, for a range of vector widths, and
+ * checks that both give the same results. Run it with no arguments:
+ *
+ *    make simd_bench
+ *    ./simd_bench
+ */
+
+# include  "config.h"
+# include  "vvp_simd.h"
+# include  <cstdio>
+# include  <cstdlib>
+# include  <cstring>
+# include  <ctime>
+
+static const unsigned BITS_PER_WORD = 8*sizeof(unsigned long);
+
+static unsigned long random_word(void)
+{
+      unsigned long res = 0;
+      for (unsigned idx = 0 ; idx < sizeof(unsigned long) ; idx += 1)
+	    res = (res << 8) | (rand() & 0xff);
+      return res;
+}
+
+static void fill(unsigned long*buf, unsigned words)
+{
+      for (unsigned idx = 0 ; idx < words ; idx += 1)
+	    buf[idx] = random_word();
+}
+
+/*
+ * The operands of each test. The a operand is restored from a_save
+ * before each call so that every call does the same work.
+ */
+struct operands_s {
+      unsigned words;
+      unsigned long*aa, *ab;
+      unsigned long*ba, *bb;
+      unsigned long*a_save;
+};
+
+static double seconds(clock_t start)
+{
+      return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static double time_and4(const vvp_simd_ops_s*ops, operands_s&op, unsigned reps)
+{
+      clock_t start = clock();
+      for (unsigned rep = 0 ; rep < reps ; rep += 1) {
+	    memcpy(op.aa, op.a_save, 2*op.words*sizeof(unsigned long));
+	    ops->and4(op.aa, op.ab, op.ba, op.bb, op.words);
+      }
+      return seconds(start);
+}
+
+static double time_or4(const vvp_simd_ops_s*ops, operands_s&op, unsigned reps)
+{
+      clock_t start = clock();
+      for (unsigned rep = 0 ; rep < reps ; rep += 1) {
+	    memcpy(op.aa, op.a_save, 2*op.words*sizeof(unsigned long));
+	    ops->or4(op.aa, op.ab, op.ba, op.bb, op.words);
+      }
+      return seconds(start);
+}
+
+static volatile bool sink;
+
+static double time_equal(const vvp_simd_ops_s*ops, operands_s&op, unsigned reps)
+{
+	// Compare a with a copy of itself so that the whole array
+	// is scanned.
+      memcpy(op.ba, op.aa, op.words*sizeof(unsigned long));
+      clock_t start = clock();
+      for (unsigned rep = 0 ; rep < reps ; rep += 1)
+	    sink = ops->equal(op.aa, op.ba, op.words);
+      return seconds(start);
+}
+
+static double time_update(const vvp_simd_ops_s*ops, operands_s&op, unsigned reps)
+{
+      clock_t start = clock();
+      for (unsigned rep = 0 ; rep < reps ; rep += 1)
+	    sink = ops->update(op.aa, op.ba, op.words);
+      return seconds(start);
+}
+
+static bool check(const vvp_simd_ops_s*ops, unsigned words)
+{
+      unsigned long*buf = new unsigned long[8*words];
+	// The abits and bbits of each operand are adjacent.
+      unsigned long*aa = buf;
+      unsigned long*ba = buf + 2*words, *bb = buf + 3*words;
+      unsigned long*ra = buf + 4*words, *rb = buf + 5*words;
+      fill(buf, 4*words);
+      bool ok = true;
+
+      memcpy(ra, aa, 2*words*sizeof(unsigned long));
+      vvp_simd_scalar.and4(ra, rb, ba, bb, words);
+      memcpy(buf+6*words, aa, 2*words*sizeof(unsigned long));
+      ops->and4(buf+6*words, buf+7*words, ba, bb, words);
+      if (memcmp(ra, buf+6*words, 2*words*sizeof(unsigned long)) != 0)
+	    ok = false;
+
+      memcpy(ra, aa, 2*words*sizeof(unsigned long));
+      vvp_simd_scalar.or4(ra, rb, ba, bb, words);
+      memcpy(buf+6*words, aa, 2*words*sizeof(unsigned long));
+      ops->or4(buf+6*words, buf+7*words, ba, bb, words);
+      if (memcmp(ra, buf+6*words, 2*words*sizeof(unsigned long)) != 0)
+	    ok = false;
+
+      if (ops->equal(aa, ba, words) != vvp_simd_scalar.equal(aa, ba, words))
+	    ok = false;
+      if (! ops->equal(aa, aa, words))
+	    ok = false;
+
+      memcpy(ra, aa, words*sizeof(unsigned long));
+      if (ops->update(ra, aa, words))
+	    ok = false;
+      ra[words-1] ^= 1;
+      if (! ops->update(ra, aa, words) || ra[words-1] != aa[words-1])
+	    ok = false;
+
+      delete[]buf;
+      return ok;
+}
+
+int main()
+{
+      const vvp_simd_ops_s*best = vvp_simd_best();
+      printf("Vector kernels: %s (compared with %s)\n",
+	     best->name, vvp_simd_scalar.name);
+
+      static const unsigned widths[] = { 128, 256, 1024, 4096, 16384, 0 };
+
+      printf("%8s %-8s %12s %12s %8s\n",
+	     "bits", "kernel", "scalar ns", "best ns", "speedup");
+
+      for (unsigned wdx = 0 ; widths[wdx] ; wdx += 1) {
+	    operands_s op;
+	    op.words = widths[wdx] / BITS_PER_WORD;
+	    unsigned long*buf = new unsigned long[6*op.words];
+	    op.aa = buf;
+	    op.ab = buf + op.words;
+	    op.ba = buf + 2*op.words;
+	    op.bb = buf + 3*op.words;
+	    op.a_save = buf + 4*op.words;
+	    fill(buf, 6*op.words);
+
+	    if (! check(best, op.words)) {
+		  printf("%8u: %s kernels do not match the scalar kernels!\n",
+			 widths[wdx], best->name);
+		  return 1;
+	    }
+
+	    unsigned reps = 200000000 / widths[wdx];
+
+	    struct {
+		  const char*name;
+		  double (*fun)(const vvp_simd_ops_s*, operands_s&, unsigned);
+	    } tests[] = {
+		  { "and4",   &time_and4 },
+		  { "or4",    &time_or4 },
+		  { "equal",  &time_equal },
+		  { "update", &time_update },
+		  { 0, 0 }
+	    };
+
+	    for (unsigned tdx = 0 ; tests[tdx].name ; tdx += 1) {
+		  double ts = tests[tdx].fun(&vvp_simd_scalar, op, reps);
+		  double tb = tests[tdx].fun(best, op, reps);
+		  printf("%8u %-8s %12.2f %12.2f %8.2f\n",
+			 widths[wdx], tests[tdx].name,
+			 1e9*ts/reps, 1e9*tb/reps, tb > 0.0? ts/tb : 0.0);
+	    }
+
+	    delete[]buf;
+      }
+
+      return 0;
+}
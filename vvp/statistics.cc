@@ -24,6 +24,17 @@
  */
 unsigned long count_opcodes = 0;
 
+/*
+ * This is a count of the instructions that threads executed.
+ */
+unsigned long count_opcodes_executed = 0;
+
+/*
+ * This is a count of the instruction sequences that were replaced
+ * with a fused opcode.
+ */
+unsigned long count_opcodes_fused = 0;
+
 unsigned long count_functors = 0;
 unsigned long count_functors_logic = 0;
 unsigned long count_functors_bufif = 0;
@@ -35,5 +46,19 @@ unsigned long count_vpi_nets = 0;
 
 unsigned long count_vpi_scopes = 0;
 
+/*
+ * These count the symbol table lookups made while compiling, and the
+ * hash table slots visited to satisfy them.
+ */
+unsigned long count_symbol_lookups = 0;
+unsigned long count_symbol_probes = 0;
+
+/*
+ * These count the work the scheduler does to find the time step for
+ * each new event. The probes are list cells or wheel words visited.
+ */
+unsigned long count_time_lookups = 0;
+unsigned long count_time_probes = 0;
+
 size_t size_opcodes = 0;
 
@@ -27,6 +27,8 @@
 #endif
 
 extern unsigned long count_opcodes;
+extern unsigned long count_opcodes_executed;
+extern unsigned long count_opcodes_fused;
 extern unsigned long count_functors;
 extern unsigned long count_functors_logic;
 extern unsigned long count_functors_bufif;
@@ -34,9 +36,14 @@ extern unsigned long count_functors_resolv;
 extern unsigned long count_functors_sig;
 extern unsigned long count_filters;
 extern unsigned long count_vvp_nets;
+extern unsigned long count_vec4_sends;
+extern unsigned long count_vec4_suppressed;
 extern unsigned long count_vpi_nets;
 extern unsigned long count_vpi_scopes;
 
+extern unsigned long count_symbol_lookups;
+extern unsigned long count_symbol_probes;
+
 extern unsigned long count_net_arrays;
 extern unsigned long count_net_array_words;
 extern unsigned long count_var_arrays;
@@ -47,6 +54,8 @@ extern unsigned long count_real_array_words;
 
 extern unsigned long count_time_events;
 extern unsigned long count_time_pool(void);
+extern unsigned long count_time_lookups;
+extern unsigned long count_time_probes;
 
 extern unsigned long count_assign_events;
 extern unsigned long count_assign4_pool(void);
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2001-2010 Stephen Williams (steve@icarus.com)
+ * Copyright (c) 2001-2012 Stephen Williams (steve@icarus.com)
  *
  *    This source code is free software; you can redistribute it
  *    and/or modify it in source code form under the terms of the GNU
@@ -18,6 +18,7 @@
  */
 
 # include  "symbols.h"
+# include  "statistics.h"
 # include  <cstring>
 # include  <cstdlib>
 # include  <cassert>
@@ -55,350 +56,150 @@ char*symbol_table_s::key_strdup_(const char*str)
 }
 
 /*
- * This is a B-Tree data structure, where there are nodes and
- * leaves.
- *
- * Nodes have a bunch of pointers to children. Each child pointer has
- * associated with it a key that is the largest key referenced by that
- * child. So, if the key being searched for has a value <= the first
- * key of a node, then the value is in the first child.
- *
- * leaves have a sorted table of key-value pairs. The search can use a
- * simple binary search to find an item. Each key represents an item.
+ * The table itself is an open addressing hash table with linear
+ * probing. The number of slots is always a power of 2, and the table
+ * is rehashed into a bigger table whenever it becomes half full, so
+ * the probe sequences stay short. The full hash of each key is kept
+ * in its slot so that most mismatches can be rejected without a
+ * string compare, and so that rehashing does not need to hash the
+ * keys again.
  */
-
-const unsigned leaf_width = 254;
-const unsigned node_width = 508;
-
-struct tree_data_ {
+struct symbol_slot_ {
       char*key;
+      unsigned hash;
       symbol_value_t val;
 };
 
-struct tree_node_ {
-      bool leaf_flag;
-      unsigned count;
-      struct tree_node_*parent;
+static const unsigned min_table_size = 256;
 
-      union {
-	    struct tree_data_ leaf[leaf_width];
-	    struct tree_node_ *child[node_width];
-      };
-
-};
-
-static inline char* node_last_key(struct tree_node_*node)
+static inline unsigned key_hash(const char*key)
 {
-      while (node->leaf_flag == false)
-	    node = node->child[node->count-1];
-
-      return node->leaf[node->count-1].key;
+	// 32bit FNV-1a
+      unsigned hash = 2166136261U;
+      for ( ; *key ; key += 1) {
+	    hash ^= (unsigned char)*key;
+	    hash *= 16777619U;
+      }
+      return hash;
 }
 
-/*
- * Allocate a new symbol table means creating the table structure and
- * a root node, and initializing the pointers and members of the root
- * node.
- */
-symbol_table_s::symbol_table_s()
+symbol_table_s::symbol_table_s(unsigned size_hint)
 {
-      root = new struct tree_node_;
-      root->leaf_flag = false;
-      root->count = 0;
-      root->parent = 0;
+      table_ = 0;
+      mask_ = 0;
+      count_ = 0;
+      rehash_(min_table_size);
+      sym_reserve(size_hint);
 
       str_chunk = new key_strings;
       str_chunk->next = 0;
       str_used = 0;
 }
 
-static void delete_symbol_node(struct tree_node_*cur)
+symbol_table_s::~symbol_table_s()
 {
-      if (! cur->leaf_flag) {
-	    for (unsigned idx = 0 ;  idx < cur->count ;  idx += 1)
-		  delete_symbol_node(cur->child[idx]);
+      delete[]table_;
+      while (str_chunk) {
+	    key_strings*tmp = str_chunk;
+	    str_chunk = tmp->next;
+	    delete tmp;
       }
-
-      delete cur;
 }
 
-/* Do as split_leaf_ does, but for nodes. */
-static void split_node_(struct tree_node_*cur)
+void symbol_table_s::rehash_(unsigned size)
 {
-	unsigned int idx, idx1, idx2, tmp;
-	struct tree_node_ *new_node;
-
-	assert(!cur->leaf_flag);
-	if (cur->parent)  assert(! cur->parent->leaf_flag);
-
-	while (cur->count == node_width)
-	{
-		/* Create a new node to hold half the data from cur. */
-		new_node = new struct tree_node_;
-		new_node->leaf_flag = false;
-		new_node->count = cur->count / 2;
-		if (cur->parent)
-			/* cur is not root; new_node becomes sibling. */
-			new_node->parent = cur->parent;
-
-		/* Move the last half of the data from the end of the old node
-		   to the beginning of the new node. At the same time, reduce
-		   the size of the old node. */
-		idx1 = new_node->count;
-		idx2 = cur->count;
-		while (idx1 > 0) {
-		      idx1 -= 1;
-		      idx2 -= 1;
-		      new_node->child[idx1] = cur->child[idx2];
-		      new_node->child[idx1]->parent = new_node;
-		      cur->count -= 1;
-		}
+      assert((size & (size-1)) == 0);
 
-		assert(new_node->count > 0);
-		assert(cur->count > 0);
+      struct symbol_slot_*old_table = table_;
+      unsigned old_size = table_? mask_+1 : 0;
 
-		if (cur->parent == 0) {
-			/* cur is root. Move first half of children to
-			   another new node, and put the two new nodes
-			   in cur. The plan here is to make cur into
-			   the new root and split its contents into 2
-			   children. */
+      table_ = new struct symbol_slot_[size];
+      mask_ = size - 1;
+      for (unsigned idx = 0 ; idx < size ; idx += 1)
+	    table_[idx].key = 0;
 
-		      new_node->parent = cur;
-		      struct tree_node_*new2_node = new struct tree_node_;
-		      new2_node->leaf_flag = false;
-		      new2_node->count = cur->count;
-		      new2_node->parent = cur;
-		      for (idx = 0; idx < cur->count; idx += 1) {
-			    new2_node->child[idx] = cur->child[idx];
-			    new2_node->child[idx]->parent = new2_node;
-		      }
-		      cur->child[0] = new2_node;
-		      cur->child[1] = new_node;
-		      cur->count = 2;
-			/* no more ancestors, stop the while loop */
-		      break;
-		}
+      for (unsigned idx = 0 ; idx < old_size ; idx += 1) {
+	    if (old_table[idx].key == 0)
+		  continue;
 
-		/* cur is not root. hook new_node to cur->parent. */
-		idx = 0;
-		while (cur->parent->child[idx] != cur) {
-			assert(idx < cur->parent->count);
-			idx += 1;
-		}
-
-		idx += 1;
+	    unsigned pos = old_table[idx].hash & mask_;
+	    while (table_[pos].key)
+		  pos = (pos + 1) & mask_;
+	    table_[pos] = old_table[idx];
+      }
 
-		for (tmp = cur->parent->count ;  tmp > idx ;  tmp -= 1)
-			cur->parent->child[tmp] = cur->parent->child[tmp-1];
+      delete[]old_table;
+}
 
-		cur->parent->child[idx] = new_node;
-		cur->parent->count += 1;
+void symbol_table_s::sym_reserve(unsigned count)
+{
+      unsigned size = mask_ + 1;
+      while (size/2 < count)
+	    size *= 2;
 
-		/* check the ancestor */
-		cur = cur->parent;
-	}
+      if (size != mask_ + 1)
+	    rehash_(size);
 }
 
 /*
- * This function takes a leaf node and splits in into two. Move half
- * the leaf keys into the new node, and add the new leaf into the
- * parent node.
+ * Find the slot that holds the key, or the empty slot where the key
+ * would go.
  */
-static struct tree_node_* split_leaf_(struct tree_node_*cur)
+struct symbol_slot_* symbol_table_s::find_slot_(const char*key, unsigned hash)
 {
-      assert(cur->leaf_flag);
-      assert(cur->parent);
-      assert(! cur->parent->leaf_flag);
-
-	/* Create a new leaf to hold half the data from the old leaf. */
-      struct tree_node_*new_leaf = new struct tree_node_;
-      new_leaf->leaf_flag = true;
-      new_leaf->count = cur->count / 2;
-      new_leaf->parent = cur->parent;
-
-	/* Move the last half of the data from the end of the old leaf
-	   to the beginning of the new leaf. At the same time, reduce
-	   the size of the old leaf. */
-      unsigned idx1 = new_leaf->count;
-      unsigned idx2 = cur->count;
-      while (idx1 > 0) {
-	    idx1 -= 1;
-	    idx2 -= 1;
-	    new_leaf->leaf[idx1] = cur->leaf[idx2];
-	    cur->count -= 1;
-      }
-
-      assert(new_leaf->count > 0);
-      assert(cur->count > 0);
-
-      unsigned idx = 0;
-      while (cur->parent->child[idx] != cur) {
-	    assert(idx < cur->parent->count);
-	    idx += 1;
+      count_symbol_lookups += 1;
+
+      unsigned pos = hash & mask_;
+      for (;;) {
+	    count_symbol_probes += 1;
+	    struct symbol_slot_*cur = table_ + pos;
+	    if (cur->key == 0)
+		  return cur;
+	    if (cur->hash == hash && strcmp(cur->key, key) == 0)
+		  return cur;
+	    pos = (pos + 1) & mask_;
       }
-
-      idx += 1;
-
-      for (unsigned tmp = cur->parent->count ;  tmp > idx ;  tmp -= 1)
-	    cur->parent->child[tmp] = cur->parent->child[tmp-1];
-
-      cur->parent->child[idx] = new_leaf;
-      cur->parent->count += 1;
-
-      if (cur->parent->count == node_width)
-	    split_node_(cur->parent);
-
-      return new_leaf;
 }
 
-
 /*
- * This function searches tree recursively for the key. If the value
- * is not found (and we are at a leaf) then set the key with the given
- * value. If the key is found, set the value only if the force_flag is
- * true.
+ * Put the key into the empty slot that find_slot_ returned. If the
+ * table needs to grow first, then the slot has to be found again.
  */
-
-symbol_value_t symbol_table_s::find_value_(struct tree_node_*cur,
-					   const char*key, symbol_value_t val,
-					   bool force_flag)
+struct symbol_slot_* symbol_table_s::insert_(struct symbol_slot_*cur,
+					     const char*key, unsigned hash,
+					     symbol_value_t val)
 {
-      if (cur->leaf_flag) {
-
-	    unsigned idx = 0;
-	    for (;;) {
-		    /* If we run out of keys in the leaf, then add
-		       this at the end of the leaf. */
-		  if (idx == cur->count) {
-			cur->leaf[idx].key = key_strdup_(key);
-			cur->leaf[idx].val = val;
-			cur->count += 1;
-			if (cur->count == leaf_width)
-			      split_leaf_(cur);
-
-			return val;
-		  }
-
-		  int rc = strcmp(key, cur->leaf[idx].key);
-
-		    /* If we found the key already in the table, then
-		       set the new value and break. */
-		  if (rc == 0) {
-			if (force_flag)
-			      cur->leaf[idx].val = val;
-			return cur->leaf[idx].val;
-		  }
-
-		    /* If this key goes before the current key, then
-		       push all the following entries back and add
-		       this key here. */
-		  if (rc < 0) {
-			for (unsigned tmp = cur->count; tmp > idx; tmp -= 1)
-			      cur->leaf[tmp] = cur->leaf[tmp-1];
-
-			cur->leaf[idx].key = key_strdup_(key);
-			cur->leaf[idx].val = val;
-			cur->count += 1;
-			if (cur->count == leaf_width)
-			      split_leaf_(cur);
-
-			return val;
-		  }
-
-		  idx += 1;
-	    }
-
-      } else {
-	      /* Do a binary search within the inner node. */
-	    unsigned min = 0;
-	    unsigned max = cur->count;
-	    unsigned idx = max/2;
-	    for (;;) {
-		  int rc = strcmp(key, node_last_key(cur->child[idx]));
-		  if (rc == 0) {
-			return find_value_(cur->child[idx],
-					   key, val, force_flag);
-		  }
-
-		  if (rc > 0) {
-			min = idx + 1;
-			if (min == cur->count)
-			      return find_value_(cur->child[idx],
-						 key, val, force_flag);
-			if (min == max)
-			      return find_value_(cur->child[max],
-						 key, val, force_flag);
-
-			idx = min + (max-min)/2;
-
-		  } else  {
-			max = idx;
-			if (idx == min)
-			      return find_value_(cur->child[idx],
-						 key, val, force_flag);
-			idx = min + (max-min)/2;
-		  }
-	    }
+      if (2*(count_+1) > mask_+1) {
+	    rehash_(2*(mask_+1));
+	    cur = find_slot_(key, hash);
       }
 
-      assert(0);
-      { symbol_value_t tmp;
-        tmp.num = 0;
-        return tmp;
-      }
+      assert(cur->key == 0);
+      cur->key = key_strdup_(key);
+      cur->hash = hash;
+      cur->val = val;
+      count_ += 1;
+      return cur;
 }
 
 void symbol_table_s::sym_set_value(const char*key, symbol_value_t val)
 {
-      if (root->count == 0) {
-	      /* Handle the special case that this is the very first
-		 value in the symbol table. Create the first leaf node
-		 and initialize the pointers. */
-	    struct tree_node_*cur = new struct tree_node_;
-	    cur->leaf_flag = true;
-	    cur->parent = root;
-	    cur->count = 1;
-	    cur->leaf[0].key = key_strdup_(key);
-	    cur->leaf[0].val = val;
-
-	    root->count = 1;
-	    root->child[0] = cur;
-      } else {
-	    find_value_(root, key, val, true);
-      }
+      unsigned hash = key_hash(key);
+      struct symbol_slot_*cur = find_slot_(key, hash);
+      if (cur->key)
+	    cur->val = val;
+      else
+	    insert_(cur, key, hash, val);
 }
 
 symbol_value_t symbol_table_s::sym_get_value(const char*key)
 {
+      unsigned hash = key_hash(key);
+      struct symbol_slot_*cur = find_slot_(key, hash);
+      if (cur->key)
+	    return cur->val;
+
       symbol_value_t def;
       def.num = 0;
-
-      if (root->count == 0) {
-	      /* Handle the special case that this is the very first
-		 value in the symbol table. Create the first leaf node
-		 and initialize the pointers. */
-	    struct tree_node_*cur = new struct tree_node_;
-	    cur->leaf_flag = true;
-	    cur->parent = root;
-	    cur->count = 1;
-	    cur->leaf[0].key = key_strdup_(key);
-	    cur->leaf[0].val = def;
-
-	    root->count = 1;
-	    root->child[0] = cur;
-	    return cur->leaf[0].val;
-      } else {
-	    return find_value_(root, key, def, false);
-      }
-}
-
-symbol_table_s::~symbol_table_s()
-{
-      delete_symbol_node(root);
-      while (str_chunk) {
-	    key_strings*tmp = str_chunk;
-	    str_chunk = tmp->next;
-	    delete tmp;
-      }
+      return insert_(cur, key, hash, def)->val;
 }
@@ -27,7 +27,8 @@
  *
  * The key is an unstructured ASCII string, terminated by a
  * null. Items added to the table are not removed, unless the entire
- * table is deleted.
+ * table is deleted. The table is an open addressing hash table, so
+ * the keys are not kept in any particular order.
  *
  * The compiler uses symbol tables to help match up operands to
  * referenced objects in the source. The compiler knows by the context
@@ -56,7 +57,7 @@ typedef struct symbol_value_s {
 
 class symbol_table_s {
     public:
-      explicit symbol_table_s();
+      explicit symbol_table_s(unsigned size_hint =0);
       virtual ~symbol_table_s();
 
 	// This method locates the value in the symbol table and sets its
@@ -68,14 +69,22 @@ class symbol_table_s {
 	// zero and return the zero value.
       symbol_value_t sym_get_value(const char*key);
 
+	// Make room for at least this many keys without rehashing.
+      void sym_reserve(unsigned count);
+
     private:
-      struct tree_node_*root;
+      struct symbol_slot_*table_;
+      unsigned mask_;
+      unsigned count_;
+
       struct key_strings*str_chunk;
       unsigned str_used;
 
-      symbol_value_t find_value_(struct tree_node_*cur,
-				 const char*key, symbol_value_t val,
-				 bool force_flag);
+      struct symbol_slot_*find_slot_(const char*key, unsigned hash);
+      struct symbol_slot_*insert_(struct symbol_slot_*cur,
+				  const char*key, unsigned hash,
+				  symbol_value_t val);
+      void rehash_(unsigned size);
       char*key_strdup_(const char*str);
 };
 
@@ -34,6 +34,7 @@
 # include  <cstdio>
 # include  <cassert>
 # include  <cstdlib>
+# include  <vector>
 /*
  * Callback handles are created when the VPI function registers a
  * callback. The handle is stored by the run time, and it triggered
@@ -73,6 +74,116 @@ int __vpiCallback::get_type_code(void) const
 { return vpiCallback; }
 
 
+/*
+ * A value_batch collects the _cbValueChangeBatch callbacks that share
+ * a cb_rtn. The first change in a time step schedules the batch in
+ * the read-only synch region, and the batch then calls the cb_rtn once
+ * for all the callbacks that changed. The batches live for the whole
+ * simulation.
+ */
+class value_batch : public vvp_gen_event_s {
+    public:
+      explicit value_batch(PLI_INT32 (*rtn)(struct t_cb_data*));
+      ~value_batch();
+
+      void add(value_callback*cb);
+      void remove(value_callback*cb);
+
+      void run_run();
+
+      PLI_INT32 (*cb_rtn)(struct t_cb_data*);
+
+    private:
+      std::vector<value_callback*> pending_;
+      std::vector<char*> user_data_;
+      bool scheduled_;
+      struct t_vpi_time time_;
+};
+
+static std::vector<value_batch*> value_batches;
+
+static value_batch* find_value_batch(PLI_INT32 (*rtn)(struct t_cb_data*))
+{
+      for (unsigned idx = 0 ; idx < value_batches.size() ; idx += 1) {
+	    if (value_batches[idx]->cb_rtn == rtn)
+		  return value_batches[idx];
+      }
+
+      value_batch*res = new value_batch(rtn);
+      value_batches.push_back(res);
+      return res;
+}
+
+value_batch::value_batch(PLI_INT32 (*rtn)(struct t_cb_data*))
+{
+      cb_rtn = rtn;
+      scheduled_ = false;
+}
+
+value_batch::~value_batch()
+{
+}
+
+inline void value_batch::add(value_callback*cb)
+{
+      cb->batch_pending = true;
+      pending_.push_back(cb);
+
+      if (! scheduled_) {
+	    scheduled_ = true;
+	    schedule_generic(this, 0, true, true);
+      }
+}
+
+/*
+ * A callback that is deleted while it is in the batch must take
+ * itself out. This is rare, so a search is good enough.
+ */
+void value_batch::remove(value_callback*cb)
+{
+      for (unsigned idx = 0 ; idx < pending_.size() ; idx += 1) {
+	    if (pending_[idx] == cb) {
+		  pending_.erase(pending_.begin() + idx);
+		  break;
+	    }
+      }
+      cb->batch_pending = false;
+}
+
+void value_batch::run_run()
+{
+      scheduled_ = false;
+
+      user_data_.clear();
+      for (unsigned idx = 0 ; idx < pending_.size() ; idx += 1) {
+	    value_callback*cur = pending_[idx];
+	    cur->batch_pending = false;
+	      // Skip the callbacks that were removed.
+	    if (cur->cb_data.cb_rtn != 0)
+		  user_data_.push_back(cur->cb_data.user_data);
+      }
+      pending_.clear();
+
+      if (user_data_.empty())
+	    return;
+
+      struct t_cb_data data;
+      time_.type = vpiSimTime;
+      vpip_time_to_timestruct(&time_, schedule_simtime());
+      data.reason = _cbValueChangeBatch;
+      data.cb_rtn = cb_rtn;
+      data.obj = 0;
+      data.time = &time_;
+      data.value = 0;
+      data.index = user_data_.size();
+      data.user_data = (char*) &user_data_[0];
+
+      assert(vpi_mode_flag == VPI_MODE_NONE);
+      vpi_mode_flag = VPI_MODE_ROSYNC;
+      (cb_rtn)(&data);
+      vpi_mode_flag = VPI_MODE_NONE;
+}
+
 value_callback::value_callback(p_cb_data data)
 {
       cb_data = *data;
@@ -88,6 +199,19 @@ value_callback::value_callback(p_cb_data data)
 	    cb_value.format = vpiSuppressVal;
       }
       cb_data.value = &cb_value;
+
+      batch = 0;
+      batch_pending = false;
+	// A batched callback never reports a value, so do not fetch one.
+      if (data->reason == _cbValueChangeBatch) {
+	    batch = find_value_batch(data->cb_rtn);
+	    cb_data.value = 0;
+      }
+}
+
+value_callback::~value_callback()
+{
+      if (batch_pending) batch->remove(this);
 }
 
 /*
@@ -525,6 +649,7 @@ vpiHandle vpi_register_cb(p_cb_data data)
       switch (data->reason) {
 
 	  case cbValueChange:
+	  case _cbValueChangeBatch:
 	    obj = make_value_change(data);
 	    break;
 
@@ -577,6 +702,14 @@ PLI_INT32 vpi_remove_cb(vpiHandle ref)
 
 void callback_execute(struct __vpiCallback*cur)
 {
+	/* A batched value change is only noted here, the batch runs
+	   the callback later. Only value callbacks have this reason. */
+      if (cur->cb_data.reason == _cbValueChangeBatch) {
+	    value_callback*vcb = static_cast<value_callback*>(cur);
+	    if (! vcb->batch_pending) vcb->batch->add(vcb);
+	    return;
+      }
+
       const vpi_mode_t save_mode = vpi_mode_flag;
       vpi_mode_flag = VPI_MODE_RWSYNC;
 
@@ -696,6 +696,11 @@ void vpip_vec4_get_value(const vvp_vector4_t&word_val, unsigned width,
 		s_vpi_vecval *op = (p_vpi_vecval)rbuf;
 		vp->value.vector = op;
 
+		if (word_val.size() == width) {
+		      word_val.get_vecval(op);
+		      break;
+		}
+
 		op->aval = op->bval = 0;
 		for (unsigned idx = 0 ;  idx < width ;  idx += 1) {
 		      switch (word_val.value(idx)) {
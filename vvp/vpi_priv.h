@@ -157,9 +157,12 @@ struct __vpiCallback : public __vpiHandle {
       struct t_cb_data cb_data;
 };
 
+class value_batch;
+
 class value_callback : public __vpiCallback {
     public:
       explicit value_callback(p_cb_data data);
+      ~value_callback();
 	// Return true if the callback really is ready to be called
       virtual bool test_value_callback_ready(void);
 
@@ -167,6 +170,10 @@ class value_callback : public __vpiCallback {
 	// user supplied callback data
       struct t_vpi_time cb_time;
       struct t_vpi_value cb_value;
+	// The batch that a _cbValueChangeBatch callback is collected
+	// in, and whether it is in the batch for this time step.
+      value_batch*batch;
+      bool batch_pending;
 };
 
 extern void callback_execute(struct __vpiCallback*cur);
@@ -473,6 +480,13 @@ struct __vpiRealVar : public __vpiHandle {
 extern struct __vpiScope* vpip_scope(__vpiRealVar*sig);
 extern vpiHandle vpip_make_real_var(const char*name, vvp_net_t*net);
 
+/*
+ * Return the _vpiNexusId of a net. Signals that share a node get the
+ * same id, and the ids are small integers that are never zero, so
+ * that they fit in the int that vpi_get returns on any host.
+ */
+extern int vpip_nexus_id(vvp_net_t*net);
+
 
 /*
  * When a loaded VPI module announces a system task/function, one
@@ -47,6 +47,9 @@ static int real_var_get(int code, vpiHandle ref)
 
 	case vpiAutomatic:
 	    return (int) vpip_scope(rfp)->is_automatic;
+
+	case _vpiNexusId:
+	    return vpip_nexus_id(rfp->net);
       }
 
       return 0;
@@ -28,6 +28,7 @@
 # include  <cstring>
 # include  <cstdlib>
 # include  <cassert>
+# include  <vector>
 # include  "ivl_alloc.h"
 
 static vpiHandle *vpip_root_table_ptr = 0;
@@ -305,6 +306,136 @@ static vpiHandle module_iter(int code, vpiHandle obj)
       return module_iter_subset(code, ref);
 }
 
+/*
+ * The vpip_hier_export function builds the array that the dumpers
+ * would otherwise build with a vpi_iterate for each type of item in
+ * each scope. The names are collected in a pool as they are found,
+ * and the array and the pool are then copied into a single block so
+ * that vpip_hier_free only has to free the one block.
+ */
+struct hier_export_s {
+      std::vector<s_vpip_hier_item> items;
+      std::vector<size_t> name_off;
+      std::vector<size_t> def_off;
+      std::vector<char> pool;
+};
+
+static const size_t HIER_NO_NAME = (size_t)-1;
+
+static size_t hier_add_name(hier_export_s&exp, const char*str)
+{
+      if (str == 0) return HIER_NO_NAME;
+
+      size_t off = exp.pool.size();
+      exp.pool.insert(exp.pool.end(), str, str + strlen(str) + 1);
+      return off;
+}
+
+static int hier_add_item(hier_export_s&exp, vpiHandle obj, int parent)
+{
+      s_vpip_hier_item item;
+      memset(&item, 0, sizeof item);
+
+      item.obj = obj;
+      item.type = obj->get_type_code();
+      item.parent = parent;
+      item.automatic = obj->vpi_get(vpiAutomatic);
+
+      size_t def_off = HIER_NO_NAME;
+      if (item.type == vpiModule)
+	    def_off = hier_add_name(exp, obj->vpi_get_str(vpiDefName));
+      size_t name_off = hier_add_name(exp, obj->vpi_get_str(vpiName));
+
+      if (dynamic_cast<__vpiScope*>(obj) == 0) {
+	    if (item.type == vpiNet)
+		  item.net_type = obj->vpi_get(vpiNetType);
+	    if (item.type != vpiNamedEvent)
+		  item.size = obj->vpi_get(vpiSize);
+	    item.left_range  = obj->vpi_get(vpiLeftRange);
+	    item.right_range = obj->vpi_get(vpiRightRange);
+	    item.nexus_id = obj->vpi_get(_vpiNexusId);
+      }
+
+      exp.items.push_back(item);
+      exp.name_off.push_back(name_off);
+      exp.def_off.push_back(def_off);
+      return exp.items.size() - 1;
+}
+
+static void hier_export_scope(hier_export_s&exp, struct __vpiScope*scope,
+			      int parent, int depth)
+{
+      static const int types[] = {
+	      /* Value */
+	    vpiNamedEvent,
+	    vpiNet,
+	    vpiReg,
+	    vpiVariables,
+	      /* Scope */
+	    vpiFunction,
+	    vpiModule,
+	    vpiNamedBegin,
+	    vpiNamedFork,
+	    vpiTask,
+	    -1
+      };
+
+      for (unsigned tdx = 0 ;  types[tdx] > 0 ;  tdx += 1) {
+	    for (unsigned idx = 0 ;  idx < scope->nintern ;  idx += 1) {
+		  vpiHandle obj = scope->intern[idx];
+		  if (! compare_types(types[tdx], obj->get_type_code()))
+			continue;
+
+		  struct __vpiScope*sub = dynamic_cast<__vpiScope*>(obj);
+		  if (sub == 0) {
+			hier_add_item(exp, obj, parent);
+		  } else if (depth > 1) {
+			int sdx = hier_add_item(exp, obj, parent);
+			hier_export_scope(exp, sub, sdx, depth-1);
+		  }
+	    }
+      }
+}
+
+p_vpip_hier_item vpip_hier_export(vpiHandle ref, PLI_INT32 depth,
+				  PLI_INT32*count)
+{
+      hier_export_s exp;
+
+      struct __vpiScope*scope = dynamic_cast<__vpiScope*>(ref);
+      if (scope == 0) {
+	    hier_add_item(exp, ref, -1);
+      } else if (depth > 0) {
+	    hier_add_item(exp, ref, -1);
+	    hier_export_scope(exp, scope, 0, depth);
+      }
+
+      *count = exp.items.size();
+      if (exp.items.empty())
+	    return 0;
+
+      size_t isize = exp.items.size() * sizeof(s_vpip_hier_item);
+      char*block = (char*)malloc(isize + exp.pool.size());
+      p_vpip_hier_item items = (p_vpip_hier_item)block;
+      char*pool = block + isize;
+
+      memcpy(pool, &exp.pool[0], exp.pool.size());
+      for (size_t idx = 0 ;  idx < exp.items.size() ;  idx += 1) {
+	    items[idx] = exp.items[idx];
+	    if (exp.name_off[idx] != HIER_NO_NAME)
+		  items[idx].name = pool + exp.name_off[idx];
+	    if (exp.def_off[idx] != HIER_NO_NAME)
+		  items[idx].def_name = pool + exp.def_off[idx];
+      }
+
+      return items;
+}
+
+void vpip_hier_free(p_vpip_hier_item items)
+{
+      free(items);
+}
+
 
 int __vpiScope::vpi_get(int code)
 { return scope_get(code, this); }
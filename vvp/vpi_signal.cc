@@ -32,6 +32,7 @@
 # include  "vvp_cleanup.h"
 #endif
 # include  <cmath>
+# include  <map>
 # include  <iostream>
 # include  <cstdio>
 # include  <cstdlib>
@@ -473,9 +474,20 @@ static void format_vpiVectorVal(vvp_signal_value*sig, int base, unsigned wid,
                          need_result_buf(hwid * sizeof(s_vpi_vecval), RBUF_VAL);
       vp->value.vector = op;
 
+	/* If the value is the whole signal, then copy the bits a word
+	   at a time instead of one bit at a time. */
+      if (base == 0 && wid == sig->value_size()) {
+	    vvp_vector4_t tmp;
+	    sig->vec4_value(tmp);
+	    if (tmp.size() == wid) {
+		  tmp.get_vecval(op);
+		  return;
+	    }
+      }
+
       op->aval = op->bval = 0;
       for (long idx = base ;  idx < end ;  idx += 1) {
-	    if (base >= 0 && base < (signed)sig->value_size()) {
+	    if (idx >= 0 && idx < (signed)sig->value_size()) {
 		switch (sig->value(idx)) {
 		case BIT4_0:
 		  op->aval &= ~(1 << obit);
@@ -560,10 +572,7 @@ static int signal_get(int code, vpiHandle ref)
 
 	    // This private property must return zero when undefined.
 	  case _vpiNexusId:
-	    if (rfp->msb == rfp->lsb)
-		  return (int) (unsigned long) rfp->node;
-	    else
-		  return 0;
+	    return vpip_nexus_id(rfp->node);
 
 	  default:
 	    fprintf(stderr, "VPI error: unknown signal_get property %d.\n",
@@ -572,6 +581,24 @@ static int signal_get(int code, vpiHandle ref)
       }
 }
 
+/*
+ * The ids are given out as the dumpers ask for them, so only the
+ * nets that are dumped are in the map.
+ */
+static std::map<vvp_net_t*,int> nexus_id_map;
+
+int vpip_nexus_id(vvp_net_t*net)
+{
+      if (net == 0) return 0;
+
+      std::map<vvp_net_t*,int>::iterator cur = nexus_id_map.find(net);
+      if (cur != nexus_id_map.end()) return cur->second;
+
+      int id = nexus_id_map.size() + 1;
+      nexus_id_map[net] = id;
+      return id;
+}
+
 static char* signal_get_str(int code, vpiHandle ref)
 {
       struct __vpiSignal*rfp = dynamic_cast<__vpiSignal*>(ref);
@@ -25,6 +25,8 @@
 # include  "event.h"
 # include  "vpi_priv.h"
 # include  "vvp_net_sig.h"
+# include  "statistics.h"
+# include  "profile.h"
 #ifdef CHECK_WITH_VALGRIND
 # include  "vvp_cleanup.h"
 #endif
@@ -520,6 +522,227 @@ void vthread_delay_delete()
 	    running_thread->delay_delete = 1;
 }
 
+/*
+ * The threaded dispatch engine runs a thread from the decoded code
+ * space (see codespace_decode) instead of calling through the opcode
+ * pointer of every instruction. Jumps and other trivial instructions
+ * are executed inline, a few common instructions are called directly,
+ * and everything else goes through the opcode pointer just like the
+ * normal loop. This relies on the GCC computed goto extension.
+ */
+#if defined(__GNUC__)
+static bool threaded_dispatch_flag = false;
+#endif
+
+enum vthread_dispatch_e {
+      VD_CALL = 0,
+      VD_CHUNK_LINK,
+      VD_NOOP,
+      VD_JMP,
+      VD_JMP0,
+      VD_JMP0XZ,
+      VD_JMP1,
+      VD_ADD,
+      VD_ADDI,
+      VD_CMPIS,
+      VD_CMPIU,
+      VD_CMPS,
+      VD_CMPU,
+      VD_LOAD_VEC,
+      VD_MOVI,
+      VD_SET_VEC,
+      VD_SUB,
+      VD_SUBI,
+      VD_COUNT
+};
+
+bool vthread_set_threaded_dispatch(bool flag)
+{
+#if defined(__GNUC__)
+      threaded_dispatch_flag = flag;
+      return true;
+#else
+      return flag == false;
+#endif
+}
+
+bool vthread_threaded_dispatch(void)
+{
+#if defined(__GNUC__)
+      return threaded_dispatch_flag;
+#else
+      return false;
+#endif
+}
+
+/*
+ * Only opcodes that never replace themselves in the code space may
+ * be given a dispatch code other than VD_CALL.
+ */
+unsigned char vthread_classify_opcode(vvp_code_fun opcode)
+{
+      if (opcode == &of_CHUNK_LINK) return VD_CHUNK_LINK;
+      if (opcode == &of_NOOP)       return VD_NOOP;
+      if (opcode == &of_JMP)        return VD_JMP;
+      if (opcode == &of_JMP0)       return VD_JMP0;
+      if (opcode == &of_JMP0XZ)     return VD_JMP0XZ;
+      if (opcode == &of_JMP1)       return VD_JMP1;
+      if (opcode == &of_ADD)        return VD_ADD;
+      if (opcode == &of_ADDI)       return VD_ADDI;
+      if (opcode == &of_CMPIS)      return VD_CMPIS;
+      if (opcode == &of_CMPIU)      return VD_CMPIU;
+      if (opcode == &of_CMPS)       return VD_CMPS;
+      if (opcode == &of_CMPU)       return VD_CMPU;
+      if (opcode == &of_LOAD_VEC)   return VD_LOAD_VEC;
+      if (opcode == &of_MOVI)       return VD_MOVI;
+      if (opcode == &of_SET_VEC)    return VD_SET_VEC;
+      if (opcode == &of_SUB)        return VD_SUB;
+      if (opcode == &of_SUBI)       return VD_SUBI;
+      return VD_CALL;
+}
+
+#if defined(__GNUC__)
+/*
+ * Run the thread until it pauses, and return the number of
+ * instructions executed. The thr->pc is kept up to date exactly as
+ * the normal loop does, so the opcode functions that are called can
+ * not tell the difference.
+ */
+static unsigned long vthread_run_threaded_(vthread_t thr)
+{
+      static const void*const handlers[VD_COUNT] = {
+	    &&op_call,
+	    &&op_chunk_link,
+	    &&op_noop,
+	    &&op_jmp,
+	    &&op_jmp0,
+	    &&op_jmp0xz,
+	    &&op_jmp1,
+	    &&op_add,
+	    &&op_addi,
+	    &&op_cmpis,
+	    &&op_cmpiu,
+	    &&op_cmps,
+	    &&op_cmpu,
+	    &&op_load_vec,
+	    &&op_movi,
+	    &&op_set_vec,
+	    &&op_sub,
+	    &&op_subi
+      };
+
+      const vvp_code_chunk_s*chunk = codespace_find_chunk(thr->pc);
+      unsigned idx = thr->pc - chunk->base;
+      vvp_code_t cp;
+      unsigned long count = 0;
+
+	/* Execute the instruction at index idx of the current chunk. */
+# define DISPATCH_IDX() do {					\
+	    cp = chunk->base + idx;					\
+	    thr->pc = cp + 1;						\
+	    count += 1;							\
+	    goto *handlers[chunk->ops[idx]];				\
+      } while (0)
+
+	/* Execute the instruction after this one. The last
+	   instruction of a chunk is always a %chunk_link, so this
+	   never steps off the end of the chunk. */
+# define DISPATCH_NEXT() do { idx += 1; DISPATCH_IDX(); } while (0)
+
+	/* Execute the instruction at thr->pc, which may have been
+	   changed to point anywhere in the code space. */
+# define DISPATCH_PC() do {						\
+	    idx = thr->pc - chunk->base;				\
+	    if (idx >= code_chunk_size) {				\
+		  chunk = codespace_find_chunk(thr->pc);		\
+		  idx = thr->pc - chunk->base;				\
+	    }								\
+	    DISPATCH_IDX();						\
+      } while (0)
+
+	/* The jump instructions check for a $stop so that a hung
+	   loop can be interrupted. See of_JMP. */
+# define CHECK_STOP() do {						\
+	    if (schedule_stopped()) {					\
+		  schedule_vthread(thr, 0, false);			\
+		  goto done;						\
+	    }								\
+      } while (0)
+
+# define DIRECT_OP(label, fun)						\
+  label:								\
+      if (! fun(thr, cp)) goto done;					\
+      DISPATCH_NEXT();
+
+      DISPATCH_IDX();
+
+  op_call:
+      if (! (cp->opcode)(thr, cp)) goto done;
+      DISPATCH_PC();
+
+  op_chunk_link:
+      assert(cp->cptr);
+      thr->pc = cp->cptr;
+      DISPATCH_PC();
+
+  op_noop:
+      DISPATCH_NEXT();
+
+  op_jmp:
+      thr->pc = cp->cptr;
+      CHECK_STOP();
+      DISPATCH_PC();
+
+  op_jmp0:
+      if (thr_get_bit(thr, cp->bit_idx[0]) == BIT4_0) {
+	    thr->pc = cp->cptr;
+	    CHECK_STOP();
+	    DISPATCH_PC();
+      }
+      CHECK_STOP();
+      DISPATCH_NEXT();
+
+  op_jmp0xz:
+      if (thr_get_bit(thr, cp->bit_idx[0]) != BIT4_1) {
+	    thr->pc = cp->cptr;
+	    CHECK_STOP();
+	    DISPATCH_PC();
+      }
+      CHECK_STOP();
+      DISPATCH_NEXT();
+
+  op_jmp1:
+      if (thr_get_bit(thr, cp->bit_idx[0]) == BIT4_1) {
+	    thr->pc = cp->cptr;
+	    CHECK_STOP();
+	    DISPATCH_PC();
+      }
+      CHECK_STOP();
+      DISPATCH_NEXT();
+
+      DIRECT_OP(op_add,      of_ADD)
+      DIRECT_OP(op_addi,     of_ADDI)
+      DIRECT_OP(op_cmpis,    of_CMPIS)
+      DIRECT_OP(op_cmpiu,    of_CMPIU)
+      DIRECT_OP(op_cmps,     of_CMPS)
+      DIRECT_OP(op_cmpu,     of_CMPU)
+      DIRECT_OP(op_load_vec, of_LOAD_VEC)
+      DIRECT_OP(op_movi,     of_MOVI)
+      DIRECT_OP(op_set_vec,  of_SET_VEC)
+      DIRECT_OP(op_sub,      of_SUB)
+      DIRECT_OP(op_subi,     of_SUBI)
+
+  done:
+      return count;
+
+# undef DIRECT_OP
+# undef CHECK_STOP
+# undef DISPATCH_PC
+# undef DISPATCH_NEXT
+# undef DISPATCH_IDX
+}
+#endif
+
 /*
  * This function runs each thread by fetching an instruction,
  * incrementing the PC, and executing the instruction. The thread may
@@ -536,9 +759,21 @@ void vthread_run(vthread_t thr)
 
             running_thread = thr;
 
+	    bool profile_flag = profile_enabled();
+	    profile_mark_s profile_mark;
+	    if (profile_flag)
+		  profile_mark = profile_thread_begin(thr);
+
+	    unsigned long count = 0;
+#if defined(__GNUC__)
+	    if (threaded_dispatch_flag) {
+		  count = vthread_run_threaded_(thr);
+	    } else
+#endif
 	    for (;;) {
 		  vvp_code_t cp = thr->pc;
 		  thr->pc += 1;
+		  count += 1;
 
 		    /* Run the opcode implementation. If the execution of
 		       the opcode returns false, then the thread is meant to
@@ -547,6 +782,10 @@ void vthread_run(vthread_t thr)
 		  if (rc == false)
 			break;
 	    }
+	    count_opcodes_executed += count;
+
+	    if (profile_flag)
+		  profile_thread_end(profile_mark, count);
 
 	    thr = tmp;
       }
@@ -3560,6 +3799,66 @@ bool of_MOV(vthread_t thr, vvp_code_t cp)
       return true;
 }
 
+/*
+ * These are the fused opcodes (see codespace_fuse). The cp is the
+ * first instruction of the sequence, and the rest follow it in the
+ * code space. The thr->pc is advanced past each instruction before it
+ * is executed, just as vthread_run would do.
+ */
+bool of_ADDI_SET_VEC(vthread_t thr, vvp_code_t cp)
+{
+      if (! of_ADDI(thr, cp)) return false;
+      thr->pc = cp + 2;
+      return of_SET_VEC(thr, cp + 1);
+}
+
+bool of_CMPIU_JMP0XZ(vthread_t thr, vvp_code_t cp)
+{
+      if (! of_CMPIU(thr, cp)) return false;
+      thr->pc = cp + 2;
+      return of_JMP0XZ(thr, cp + 1);
+}
+
+bool of_CMPU_JMP0XZ(vthread_t thr, vvp_code_t cp)
+{
+      if (! of_CMPU(thr, cp)) return false;
+      thr->pc = cp + 2;
+      return of_JMP0XZ(thr, cp + 1);
+}
+
+bool of_LOAD_VEC_CMPIU_JMP0XZ(vthread_t thr, vvp_code_t cp)
+{
+      if (! of_LOAD_VEC(thr, cp)) return false;
+      thr->pc = cp + 2;
+      if (! of_CMPIU(thr, cp + 1)) return false;
+      thr->pc = cp + 3;
+      return of_JMP0XZ(thr, cp + 2);
+}
+
+bool of_LOAD_VEC_JMP0XZ(vthread_t thr, vvp_code_t cp)
+{
+      if (! of_LOAD_VEC(thr, cp)) return false;
+      thr->pc = cp + 2;
+      return of_JMP0XZ(thr, cp + 1);
+}
+
+/*
+ * The %mov cannot be run with of_MOV, because that would replace the
+ * fused opcode with one of the specialized %mov opcodes.
+ */
+bool of_MOV_SET_VEC(vthread_t thr, vvp_code_t cp)
+{
+      assert(cp->bit_idx[0] >= 4);
+
+      bool rc = (cp->bit_idx[1] >= 4)
+	    ? of_MOV_(thr, cp)
+	    : of_MOV1XZ_(thr, cp);
+      if (! rc) return false;
+
+      thr->pc = cp + 2;
+      return of_SET_VEC(thr, cp + 1);
+}
+
 bool of_PAD(vthread_t thr, vvp_code_t cp)
 {
       assert(cp->bit_idx[0] >= 4);
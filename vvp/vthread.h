@@ -62,6 +62,14 @@ extern void vthread_delay_delete();
  */
 extern void vthread_run(vthread_t thr);
 
+/*
+ * Select the threaded dispatch engine for vthread_run. This must be
+ * done before the code space is compiled. The set function returns
+ * false if the engine is not available in this build.
+ */
+extern bool vthread_set_threaded_dispatch(bool flag);
+extern bool vthread_threaded_dispatch(void);
+
 /*
  * This function schedules all the threads in the list to be scheduled
  * for execution with delay 0. The thr pointer is taken to be the head
@@ -136,6 +136,8 @@ class vvp_island_port  : public vvp_net_fun_t {
 	// a force/release happens to the net.
       virtual void force_flag(void);
 
+      vvp_island* island() const { return island_; }
+
     public:
       vvp_vector8_t invalue;
       vvp_vector8_t outvalue;
@@ -22,6 +22,8 @@
 # include  "vpi_priv.h"
 # include  "schedule.h"
 # include  "statistics.h"
+# include  "profile.h"
+# include  "vvp_simd.h"
 # include  <cstdio>
 # include  <cstring>
 # include  <cstdlib>
@@ -44,10 +46,8 @@ permaheap vvp_net_fil_t::heap_;
 // Allocate around 1Megabyte/chunk.
 static const size_t VVP_NET_CHUNK = 1024*1024/sizeof(vvp_net_t);
 static vvp_net_t*vvp_net_alloc_table = NULL;
-#ifdef CHECK_WITH_VALGRIND
 static vvp_net_t **vvp_net_pool = NULL;
 static unsigned vvp_net_pool_count = 0;
-#endif
 static size_t vvp_net_alloc_remaining = 0;
 // For statistics, count the vvp_nets allocated and the bytes of alloc
 // chunks allocated.
@@ -64,11 +64,11 @@ void* vvp_net_t::operator new (size_t size)
 #ifdef CHECK_WITH_VALGRIND
 	    VALGRIND_MAKE_MEM_NOACCESS(vvp_net_alloc_table, size*VVP_NET_CHUNK);
 	    VALGRIND_CREATE_MEMPOOL(vvp_net_alloc_table, 0, 0);
+#endif
 	    vvp_net_pool_count += 1;
 	    vvp_net_pool = (vvp_net_t **) realloc(vvp_net_pool,
 	                   vvp_net_pool_count*sizeof(vvp_net_t **));
 	    vvp_net_pool[vvp_net_pool_count-1] = vvp_net_alloc_table;
-#endif
       }
 
       vvp_net_t*return_this = vvp_net_alloc_table;
@@ -80,9 +80,23 @@ void* vvp_net_t::operator new (size_t size)
       vvp_net_alloc_table += 1;
       vvp_net_alloc_remaining -= 1;
       count_vvp_nets += 1;
+      if (profile_enabled())
+	    profile_note_net(return_this);
       return return_this;
 }
 
+void vvp_net_pool_scan(void (*fun)(vvp_net_t*net, void*data), void*data)
+{
+      for (unsigned idx = 0 ; idx < vvp_net_pool_count ; idx += 1) {
+	    size_t count = VVP_NET_CHUNK;
+	    if (idx == vvp_net_pool_count-1)
+		  count -= vvp_net_alloc_remaining;
+
+	    for (size_t cnt = 0 ; cnt < count ; cnt += 1)
+		  fun(vvp_net_pool[idx] + cnt, data);
+      }
+}
+
 #ifdef CHECK_WITH_VALGRIND
 static map<vvp_net_t*, bool> vvp_net_map;
 static map<sfunc_core*, bool> sfunc_map;
@@ -161,15 +175,53 @@ void vvp_net_t::operator delete(void*)
       assert(0);
 }
 
+bool vvp_net_t::send_cache_ = false;
+vvp_vector4_t vvp_net_t::send_uncached_;
+unsigned long count_vec4_sends = 0;
+unsigned long count_vec4_suppressed = 0;
+
 vvp_net_t::vvp_net_t()
 {
       out_ = vvp_net_ptr_t(0,0);
+      sent_vec4_ = 0;
       fun = 0;
       fil = 0;
 }
 
+/*
+ * Return true if the value is the same as the value last sent from
+ * this net. Otherwise, remember it as the last value sent. The
+ * output of an event functor is marked on its first send so that
+ * it is never cached.
+ */
+bool vvp_net_t::sent_vec4_same_(const vvp_vector4_t&val)
+{
+      count_vec4_sends += 1;
+
+      if (sent_vec4_ == &send_uncached_)
+	    return false;
+
+      if (sent_vec4_ == 0) {
+	    if (fun && fun->sends_events())
+		  sent_vec4_ = &send_uncached_;
+	    else
+		  sent_vec4_ = new vvp_vector4_t(val);
+	    return false;
+      }
+
+      if (sent_vec4_->eeq(val)) {
+	    count_vec4_suppressed += 1;
+	    return true;
+      }
+
+      *sent_vec4_ = val;
+      return false;
+}
+
 void vvp_net_t::link(vvp_net_ptr_t port_to_link)
 {
+	// The new port has not seen the cached value.
+      forget_sent_vec4_();
       vvp_net_t*net = port_to_link.ptr();
       net->port[port_to_link.port()] = out_;
       out_ = port_to_link;
@@ -500,6 +552,12 @@ const vvp_vector4_t vvp_vector4_t::nil;
 
 void vvp_vector4_t::copy_bits(const vvp_vector4_t&that)
 {
+	/* If that covers all of this, then this gets its state,
+	   otherwise the bits past the end of that are kept. */
+      if (that.size_ >= size_)
+	    two_state_ = that.two_state_;
+      else
+	    two_state_ = two_state_ && that.two_state_;
 
       if (size_ == that.size_) {
 	    if (size_ > BITS_PER_WORD) {
@@ -583,15 +641,15 @@ void vvp_vector4_t::copy_bits(const vvp_vector4_t&that)
 void vvp_vector4_t::copy_from_(const vvp_vector4_t&that)
 {
       size_ = that.size_;
+      two_state_ = that.two_state_;
       if (size_ > BITS_PER_WORD) {
 	    unsigned words = (size_+BITS_PER_WORD-1) / BITS_PER_WORD;
 	    abits_ptr_ = new unsigned long[2*words];
 	    bbits_ptr_ = abits_ptr_ + words;
 
-	    for (unsigned idx = 0 ;  idx < words ;  idx += 1)
-		  abits_ptr_[idx] = that.abits_ptr_[idx];
-	    for (unsigned idx = 0 ;  idx < words ;  idx += 1)
-		  bbits_ptr_[idx] = that.bbits_ptr_[idx];
+	      /* The abits and bbits are contiguous in both vectors,
+		 so a single block copy does them both. */
+	    memcpy(abits_ptr_, that.abits_ptr_, 2*words*sizeof(unsigned long));
 
       } else {
 	    abits_val_ = that.abits_val_;
@@ -607,6 +665,7 @@ void vvp_vector4_t::copy_from_(const vvp_vector4_t&that)
 void vvp_vector4_t::copy_inverted_from_(const vvp_vector4_t&that)
 {
       size_ = that.size_;
+      two_state_ = that.two_state_;
       if (size_ > BITS_PER_WORD) {
 	    unsigned words = (size_+BITS_PER_WORD-1) / BITS_PER_WORD;
 	    abits_ptr_ = new unsigned long[2*words];
@@ -653,7 +712,7 @@ void vvp_vector4_t::allocate_words_(unsigned long inita, unsigned long initb)
 }
 
 vvp_vector4_t::vvp_vector4_t(unsigned size__, double val)
-: size_(size__)
+: size_(size__), two_state_(true)
 {
       bool is_neg = false;
       double fraction;
@@ -661,6 +720,7 @@ vvp_vector4_t::vvp_vector4_t(unsigned size__, double val)
 
 	/* We return 'bx for a NaN or +/- infinity. */
       if (val != val || (val && (val == 0.5*val)))  {
+	    two_state_ = false;
 	    allocate_words_(WORD_X_ABITS, WORD_X_BBITS);
 	    return;
       }
@@ -731,6 +791,7 @@ vvp_vector4_t::vvp_vector4_t(const vvp_vector4_t&that,
 			    unsigned adr, unsigned wid)
 {
       size_ = wid;
+      two_state_ = that.two_state_;
       assert((adr + wid) <= that.size_);
 
       allocate_words_(WORD_X_ABITS, WORD_X_BBITS);
@@ -831,6 +892,10 @@ void vvp_vector4_t::resize(unsigned newsize)
       if (size_ == newsize)
 	    return;
 
+	/* The new bits are X. */
+      if (newsize > size_)
+	    two_state_ = false;
+
       unsigned cnt = (size_ + BITS_PER_WORD - 1) / BITS_PER_WORD;
 
       if (newsize > BITS_PER_WORD) {
@@ -893,6 +958,17 @@ unsigned long* vvp_vector4_t::subarray(unsigned adr, unsigned wid) const
       for (unsigned idx = 0 ;  idx < awid ;  idx += 1)
 	    val[idx] = 0;
 
+	/* A 2-state vector can have no X or Z in the subarray, so
+	   skip the bbits and copy only the abits. */
+      if (two_state_ && size_ > BITS_PER_WORD && adr%BITS_PER_WORD == 0) {
+	    unsigned ptr = adr / BITS_PER_WORD;
+	    for (unsigned idx = 0 ;  idx < awid ;  idx += 1)
+		  val[idx] = abits_ptr_[ptr+idx];
+	    if (wid % BIT2_PER_WORD)
+		  val[awid-1] &= (1UL << (wid % BIT2_PER_WORD)) - 1;
+	    return val;
+      }
+
       if (size_ <= BITS_PER_WORD) {
 	      /* Handle the special case that the array is small. The
 		 entire value of the vector4 is within the xbits_val_
@@ -952,10 +1028,40 @@ unsigned long* vvp_vector4_t::subarray(unsigned adr, unsigned wid) const
       return 0;
 }
 
+void vvp_vector4_t::get_vecval(s_vpi_vecval*buf) const
+{
+      if (size_ == 0)
+	    return;
+
+      const unsigned long*ap = size_ > BITS_PER_WORD? abits_ptr_ : &abits_val_;
+      const unsigned long*bp = size_ > BITS_PER_WORD? bbits_ptr_ : &bbits_val_;
+      unsigned cnt = (size_ + 31) / 32;
+
+	/* Copy whole words 32 bits at a time. This works whether an
+	   unsigned long is 32 or 64 bits. */
+      for (unsigned idx = 0 ;  idx < cnt ;  idx += 1) {
+	    unsigned wdx = (idx*32) / BITS_PER_WORD;
+	    unsigned off = (idx*32) % BITS_PER_WORD;
+	    buf[idx].aval = (PLI_INT32)(PLI_UINT32)(ap[wdx] >> off);
+	    buf[idx].bval = two_state_? 0 : (PLI_INT32)(PLI_UINT32)(bp[wdx] >> off);
+      }
+
+      if (size_ % 32) {
+	    PLI_UINT32 mask = (1U << (size_ % 32)) - 1;
+	    buf[cnt-1].aval &= (PLI_INT32)mask;
+	    buf[cnt-1].bval &= (PLI_INT32)mask;
+      }
+}
+
 void vvp_vector4_t::setarray(unsigned adr, unsigned wid, const unsigned long*val)
 {
       assert(adr+wid <= size_);
 
+	/* Writing 2-state bits over the whole vector makes it
+	   2-state. Any other write leaves the state alone. */
+      if (adr == 0 && wid == size_)
+	    two_state_ = true;
+
       const unsigned BIT2_PER_WORD = 8*sizeof(unsigned long);
 
       if (size_ <= BITS_PER_WORD) {
@@ -1028,6 +1134,11 @@ bool vvp_vector4_t::set_vec(unsigned adr, const vvp_vector4_t&that)
       assert(adr+that.size_  <= size_);
       bool diff_flag = false;
 
+      if (! that.two_state_)
+	    two_state_ = false;
+      else if (adr == 0 && that.size_ == size_)
+	    two_state_ = true;
+
       if (size_ <= BITS_PER_WORD) {
 
 	      /* The destination vector (me!) is within a bits_val_
@@ -1115,19 +1226,14 @@ bool vvp_vector4_t::set_vec(unsigned adr, const vvp_vector4_t&that)
 	    unsigned remain = that.size_;
 	    unsigned sptr = 0;
 	    unsigned dptr = adr / BITS_PER_WORD;
-	    while (remain >= BITS_PER_WORD) {
-		  if (abits_ptr_[dptr] != that.abits_ptr_[sptr]) {
-			diff_flag = true;
-			abits_ptr_[dptr] = that.abits_ptr_[sptr];
-		  }
-		  if (bbits_ptr_[dptr] != that.bbits_ptr_[sptr]) {
-			diff_flag = true;
-			bbits_ptr_[dptr] = that.bbits_ptr_[sptr];
-		  }
-		  dptr += 1;
-		  sptr += 1;
-		  remain -= BITS_PER_WORD;
-	    }
+	    unsigned full = remain / BITS_PER_WORD;
+	    if (vvp_simd->update(abits_ptr_+dptr, that.abits_ptr_, full))
+		  diff_flag = true;
+	    if (vvp_simd->update(bbits_ptr_+dptr, that.bbits_ptr_, full))
+		  diff_flag = true;
+	    dptr += full;
+	    sptr += full;
+	    remain -= full * BITS_PER_WORD;
 
 	    if (remain > 0) {
 		  unsigned long mask = (1UL << remain) - 1;
@@ -1312,30 +1418,33 @@ bool vvp_vector4_t::eeq(const vvp_vector4_t&that) const
       if (size_ != that.size_)
 	    return false;
 
+	/* If both vectors are 2-state, then the bbits are all 0 and
+	   there is no need to compare them. */
+      bool both_2state = two_state_ && that.two_state_;
+
       if (size_ < BITS_PER_WORD) {
 	    unsigned long mask = (1UL << size_) - 1;
 	    return (abits_val_&mask) == (that.abits_val_&mask)
-		  && (bbits_val_&mask) == (that.bbits_val_&mask);
+		  && (both_2state || (bbits_val_&mask) == (that.bbits_val_&mask));
       }
 
       if (size_ == BITS_PER_WORD) {
 	    return (abits_val_ == that.abits_val_)
-		  && (bbits_val_ == that.bbits_val_);
+		  && (both_2state || bbits_val_ == that.bbits_val_);
       }
 
       unsigned words = size_ / BITS_PER_WORD;
-      for (unsigned idx = 0 ;  idx < words ;  idx += 1) {
-	    if (abits_ptr_[idx] != that.abits_ptr_[idx])
-		  return false;
-	    if (bbits_ptr_[idx] != that.bbits_ptr_[idx])
-		  return false;
-      }
+      if (! vvp_simd->equal(abits_ptr_, that.abits_ptr_, words))
+	    return false;
+      if (! both_2state && ! vvp_simd->equal(bbits_ptr_, that.bbits_ptr_, words))
+	    return false;
 
       unsigned long mask = size_%BITS_PER_WORD;
       if (mask > 0) {
 	    mask = (1UL << mask) - 1;
 	    return (abits_ptr_[words]&mask) == (that.abits_ptr_[words]&mask)
-		  && (bbits_ptr_[words]&mask) == (that.bbits_ptr_[words]&mask);
+		  && (both_2state
+		      || (bbits_ptr_[words]&mask) == (that.bbits_ptr_[words]&mask));
       }
 
       return true;
@@ -1346,6 +1455,9 @@ bool vvp_vector4_t::eq_xz(const vvp_vector4_t&that) const
       if (size_ != that.size_)
 	    return false;
 
+      if (two_state_ && that.two_state_)
+	    return eeq(that);
+
       if (size_ < BITS_PER_WORD) {
 	    unsigned long mask = (1UL << size_) - 1;
 	    return ((abits_val_|bbits_val_)&mask) == ((that.abits_val_|that.bbits_val_)&mask)
@@ -1377,13 +1489,18 @@ bool vvp_vector4_t::eq_xz(const vvp_vector4_t&that) const
 
 bool vvp_vector4_t::has_xz() const
 {
+      if (two_state_)
+	    return false;
+
       if (size_ < BITS_PER_WORD) {
 	    unsigned long mask = -1UL >> (BITS_PER_WORD - size_);
-	    return bbits_val_&mask;
+	    two_state_ = (bbits_val_&mask) == 0;
+	    return ! two_state_;
       }
 
       if (size_ == BITS_PER_WORD) {
-	    return bbits_val_;
+	    two_state_ = bbits_val_ == 0;
+	    return ! two_state_;
       }
 
       unsigned words = size_ / BITS_PER_WORD;
@@ -1395,9 +1512,12 @@ bool vvp_vector4_t::has_xz() const
       unsigned long mask = size_%BITS_PER_WORD;
       if (mask > 0) {
 	    mask = -1UL >> (BITS_PER_WORD - mask);
-	    return bbits_ptr_[words]&mask;
+	    if (bbits_ptr_[words]&mask)
+		  return true;
       }
 
+	/* No X or Z bits, so remember that for next time. */
+      two_state_ = true;
       return false;
 }
 
@@ -1420,6 +1540,7 @@ void vvp_vector4_t::change_z2x()
 
 void vvp_vector4_t::set_to_x()
 {
+      two_state_ = false;
       if (size_ <= BITS_PER_WORD) {
 	    abits_val_ = vvp_vector4_t::WORD_X_ABITS;
             bbits_val_ = vvp_vector4_t::WORD_X_BBITS;
@@ -1487,6 +1608,8 @@ void vvp_vector4_t::invert()
 
 vvp_vector4_t& vvp_vector4_t::operator &= (const vvp_vector4_t&that)
 {
+      two_state_ = two_state_ && that.two_state_;
+
 	// The truth table is:
 	//     00 01 11 10
 	//  00 00 00 00 00
@@ -1500,14 +1623,8 @@ vvp_vector4_t& vvp_vector4_t::operator &= (const vvp_vector4_t&that)
 	    bbits_val_ = (tmp1 & that.bbits_val_) | (tmp2 & bbits_val_);
       } else {
 	    unsigned words = (size_ + BITS_PER_WORD - 1) / BITS_PER_WORD;
-	    for (unsigned idx = 0; idx < words ; idx += 1) {
-		  unsigned long tmp1 = abits_ptr_[idx] | bbits_ptr_[idx];
-		  unsigned long tmp2 = that.abits_ptr_[idx] |
-		                       that.bbits_ptr_[idx];
-		  abits_ptr_[idx] = tmp1 & tmp2;
-		  bbits_ptr_[idx] = (tmp1 & that.bbits_ptr_[idx]) |
-		                    (tmp2 & bbits_ptr_[idx]);
-	    }
+	    vvp_simd->and4(abits_ptr_, bbits_ptr_,
+			   that.abits_ptr_, that.bbits_ptr_, words);
       }
 
       return *this;
@@ -1515,6 +1632,8 @@ vvp_vector4_t& vvp_vector4_t::operator &= (const vvp_vector4_t&that)
 
 vvp_vector4_t& vvp_vector4_t::operator |= (const vvp_vector4_t&that)
 {
+      two_state_ = two_state_ && that.two_state_;
+
 	// The truth table is:
 	//     00 01 11 10
 	//  00 00 01 11 11
@@ -1530,15 +1649,8 @@ vvp_vector4_t& vvp_vector4_t::operator |= (const vvp_vector4_t&that)
 
       } else {
 	    unsigned words = (size_ + BITS_PER_WORD - 1) / BITS_PER_WORD;
-	    for (unsigned idx = 0; idx < words ; idx += 1) {
-		  unsigned long tmp = abits_ptr_[idx] | bbits_ptr_[idx] |
-	                        that.abits_ptr_[idx] | that.bbits_ptr_[idx];
-		  bbits_ptr_[idx] = ((~abits_ptr_[idx] | bbits_ptr_[idx]) &
-		                     that.bbits_ptr_[idx]) |
-		                    ((~that.abits_ptr_[idx] |
-		                      that.bbits_ptr_[idx]) & bbits_ptr_[idx]);
-		  abits_ptr_[idx] = tmp;
-	    }
+	    vvp_simd->or4(abits_ptr_, bbits_ptr_,
+			  that.abits_ptr_, that.bbits_ptr_, words);
       }
 
       return *this;
@@ -2960,6 +3072,11 @@ void vvp_net_fun_t::force_flag(void)
 {
 }
 
+bool vvp_net_fun_t::sends_events(void) const
+{
+      return false;
+}
+
 /* **** vvp_fun_drive methods **** */
 
 vvp_fun_drive::vvp_fun_drive(unsigned str0, unsigned str1)
@@ -233,6 +233,9 @@ class vvp_vector4_t {
 	// in the array.
       unsigned long*subarray(unsigned idx, unsigned size) const;
       void setarray(unsigned idx, unsigned size, const unsigned long*val);
+	// Get the bits into a VPI vecval array, which must have room
+	// for (size+31)/32 entries. Unused bits of the last entry are 0.
+      void get_vecval(s_vpi_vecval*buf) const;
 
 	// Set a 4-value bit or subvector into the vector. Return true
 	// if any bits of the vector change as a result of this operation.
@@ -254,6 +257,11 @@ class vvp_vector4_t {
 	// Return true if there is an X or Z anywhere in the vector.
       bool has_xz() const;
 
+	// Return true if the vector is known to have no X or Z bits,
+	// without looking at the bits. A false result means only that
+	// the vector has not been checked since an X or Z was written.
+      bool is_2state() const { return two_state_; }
+
 	// Change all Z bits to X bits.
       void change_z2x();
 
@@ -308,8 +316,15 @@ class vvp_vector4_t {
 	// BIT4_1    1    0    value is 0. This makes detecting XZ fast.)
 	// BIT4_X    1    1
 	// BIT4_Z    0    1
+	//
+	// The two_state_ flag is set when all the bbits are known to
+	// be 0. Operations that may write an X or Z bit clear it, and
+	// the operations on 2-state vectors use it to skip the bbits.
+	// It only ever errs on the side of false, so has_xz() sets it
+	// when a scan finds no X or Z bits.
 
       unsigned size_;
+      mutable bool two_state_;
       union {
 	    unsigned long abits_val_;
 	    unsigned long*abits_ptr_;
@@ -334,7 +349,7 @@ inline vvp_vector4_t::vvp_vector4_t(const vvp_vector4_t&that, bool invert_flag)
 }
 
 inline vvp_vector4_t::vvp_vector4_t(unsigned size__, vvp_bit4_t val)
-: size_(size__)
+: size_(size__), two_state_(! bit4_is_xz(val))
 {
 	/* note: this relies on the bit encoding for the vvp_bit4_t. */
       static const unsigned long init_atable[4] = {
@@ -418,6 +433,9 @@ inline void vvp_vector4_t::set_bit(unsigned idx, vvp_bit4_t val)
       unsigned long off = idx % BITS_PER_WORD;
       unsigned long mask = 1UL << off;
 
+      if (bit4_is_xz(val))
+	    two_state_ = false;
+
       if (size_ > BITS_PER_WORD) {
 	    unsigned wdx = idx / BITS_PER_WORD;
 	    switch (val) {
@@ -1100,8 +1118,28 @@ class vvp_net_t {
       void force_vec8(const vvp_vector8_t&val, vvp_vector2_t mask);
       void force_real(double val, vvp_vector2_t mask);
 
+	// Return the first port connected to the output of this
+	// net. The rest of the list is reached through the port[]
+	// member of each connected net.
+      vvp_net_ptr_t output_list() const { return out_; }
+
+	// Turn on the cache of the last vec4 value sent from each
+	// net. See send_vec4 below.
+      static void set_send_cache(bool flag) { send_cache_ = flag; }
+      static bool send_cache() { return send_cache_; }
+
     private:
       vvp_net_ptr_t out_;
+	// The last vec4 value sent through out_, if the send cache
+	// is turned on and the last thing sent was a whole vec4. This
+	// points to send_uncached_ for nets that are never cached.
+      vvp_vector4_t*sent_vec4_;
+      static bool send_cache_;
+      static vvp_vector4_t send_uncached_;
+
+      void send_out_vec4_(const vvp_vector4_t&val, vvp_context_t context);
+      bool sent_vec4_same_(const vvp_vector4_t&val);
+      void forget_sent_vec4_();
 
     public: // Need a better new for these objects.
       static void* operator new(std::size_t size);
@@ -1111,6 +1149,13 @@ class vvp_net_t {
       static void operator delete[](void*);
 };
 
+/*
+ * Call the function once for every vvp_net_t that has been allocated
+ * from the net pool.
+ */
+extern void vvp_net_pool_scan(void (*fun)(vvp_net_t*net, void*data),
+			      void*data);
+
 /*
  * Instances of this class represent the functionality of a
  * node. vvp_net_t objects hold pointers to the vvp_net_fun_t
@@ -1172,6 +1217,11 @@ class vvp_net_fun_t {
 	// do something about it.
       virtual void force_flag(void);
 
+	// Return true if each value that this functor sends is an
+	// event in itself, even if it is the same as the value sent
+	// before. The send cache never drops these values.
+      virtual bool sends_events(void) const;
+
     public: // These objects are only permallocated.
       static void* operator new(std::size_t size) { return heap_.alloc(size); }
       static void operator delete(void*); // not implemented
@@ -1560,10 +1610,39 @@ inline void vvp_send_vec8_pv(vvp_net_ptr_t ptr, const vvp_vector8_t&val,
       }
 }
 
+/*
+ * When the send cache is turned on, each net remembers the last vec4
+ * value that it sent, and a send of the same value again is dropped
+ * before the fan-out list is walked. In deep combinational logic the
+ * same value is often sent many times over. Not every receiver can
+ * lose a repeated value, though: the event functors send the same
+ * value for each event, and whatever they drive wakes on every one,
+ * so the output of an event functor is never cached. The cache is
+ * also not used for values sent within an automatic context, and
+ * anything else sent through the output (part vectors, strengths,
+ * reals, forces) or a change to the fan-out list makes the net
+ * forget the cached value.
+ */
+inline void vvp_net_t::forget_sent_vec4_()
+{
+      if (sent_vec4_ && sent_vec4_ != &send_uncached_) {
+	    delete sent_vec4_;
+	    sent_vec4_ = 0;
+      }
+}
+
+inline void vvp_net_t::send_out_vec4_(const vvp_vector4_t&val, vvp_context_t context)
+{
+      if (send_cache_ && context == 0 && sent_vec4_same_(val))
+	    return;
+
+      vvp_send_vec4(out_, val, context);
+}
+
 inline void vvp_net_t::send_vec4(const vvp_vector4_t&val, vvp_context_t context)
 {
       if (fil == 0) {
-	    vvp_send_vec4(out_, val, context);
+	    send_out_vec4_(val, context);
 	    return;
       }
 
@@ -1572,10 +1651,10 @@ inline void vvp_net_t::send_vec4(const vvp_vector4_t&val, vvp_context_t context)
 	  case vvp_net_fil_t::STOP:
 	    break;
 	  case vvp_net_fil_t::PROP:
-	    vvp_send_vec4(out_, val, context);
+	    send_out_vec4_(val, context);
 	    break;
 	  case vvp_net_fil_t::REPL:
-	    vvp_send_vec4(out_, rep, context);
+	    send_out_vec4_(rep, context);
 	    break;
       }
 }
@@ -1584,6 +1663,7 @@ inline void vvp_net_t::send_vec4_pv(const vvp_vector4_t&val,
 				    unsigned base, unsigned wid, unsigned vwid,
 				    vvp_context_t context)
 {
+      forget_sent_vec4_();
       if (fil == 0) {
 	    vvp_send_vec4_pv(out_, val, base, wid, vwid, context);
 	    return;
@@ -1605,6 +1685,7 @@ inline void vvp_net_t::send_vec4_pv(const vvp_vector4_t&val,
 
 inline void vvp_net_t::send_vec8(const vvp_vector8_t&val)
 {
+      forget_sent_vec4_();
       if (fil == 0) {
 	    vvp_send_vec8(out_, val);
 	    return;
@@ -1626,6 +1707,7 @@ inline void vvp_net_t::send_vec8(const vvp_vector8_t&val)
 inline void vvp_net_t::send_vec8_pv(const vvp_vector8_t&val,
 				    unsigned base, unsigned wid, unsigned vwid)
 {
+      forget_sent_vec4_();
       if (fil == 0) {
 	    vvp_send_vec8_pv(out_, val, base, wid, vwid);
 	    return;
@@ -1647,6 +1729,7 @@ inline void vvp_net_t::send_vec8_pv(const vvp_vector8_t&val,
 
 inline void vvp_net_t::send_real(double val, vvp_context_t context)
 {
+      forget_sent_vec4_();
       if (fil && ! fil->filter_real(val))
 	    return;
 
@@ -119,6 +119,7 @@ void vvp_net_t::force_vec4(const vvp_vector4_t&val, vvp_vector2_t mask)
       assert(fil);
       fil->force_fil_vec4(val, mask);
       fun->force_flag();
+      forget_sent_vec4_();
       vvp_send_vec4(out_, val, 0);
 }
 
@@ -127,6 +128,7 @@ void vvp_net_t::force_vec8(const vvp_vector8_t&val, vvp_vector2_t mask)
       assert(fil);
       fil->force_fil_vec8(val, mask);
       fun->force_flag();
+      forget_sent_vec4_();
       vvp_send_vec8(out_, val);
 }
 
@@ -135,6 +137,7 @@ void vvp_net_t::force_real(double val, vvp_vector2_t mask)
       assert(fil);
       fil->force_fil_real(val, mask);
       fun->force_flag();
+      forget_sent_vec4_();
       vvp_send_real(out_, val, 0);
 }
 
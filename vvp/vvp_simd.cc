@@ -0,0 +1,308 @@
+/*
+ * Copyright (c) 2012 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+# include  "config.h"
+# include  "vvp_simd.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define VVP_SIMD_X86 1
+# include  <immintrin.h>
+#endif
+
+/*
+ * The scalar kernels. These are also used by the vector kernels to
+ * finish the words that do not fill a whole vector register. The
+ * truth tables for the 4-value operators are in vvp_net.cc.
+ */
+static inline void and4_words(unsigned long*aa, unsigned long*ab,
+			      const unsigned long*ba, const unsigned long*bb,
+			      unsigned idx, unsigned words)
+{
+      for ( ; idx < words ; idx += 1) {
+	    unsigned long tmp1 = aa[idx] | ab[idx];
+	    unsigned long tmp2 = ba[idx] | bb[idx];
+	    aa[idx] = tmp1 & tmp2;
+	    ab[idx] = (tmp1 & bb[idx]) | (tmp2 & ab[idx]);
+      }
+}
+
+static inline void or4_words(unsigned long*aa, unsigned long*ab,
+			     const unsigned long*ba, const unsigned long*bb,
+			     unsigned idx, unsigned words)
+{
+      for ( ; idx < words ; idx += 1) {
+	    unsigned long tmp = aa[idx] | ab[idx] | ba[idx] | bb[idx];
+	    ab[idx] = ((~aa[idx] | ab[idx]) & bb[idx]) |
+		      ((~ba[idx] | bb[idx]) & ab[idx]);
+	    aa[idx] = tmp;
+      }
+}
+
+static inline bool equal_words(const unsigned long*a, const unsigned long*b,
+			       unsigned idx, unsigned words)
+{
+      for ( ; idx < words ; idx += 1) {
+	    if (a[idx] != b[idx])
+		  return false;
+      }
+      return true;
+}
+
+static inline bool update_words(unsigned long*dst, const unsigned long*src,
+				unsigned idx, unsigned words)
+{
+      bool diff_flag = false;
+      for ( ; idx < words ; idx += 1) {
+	    if (dst[idx] != src[idx]) {
+		  diff_flag = true;
+		  dst[idx] = src[idx];
+	    }
+      }
+      return diff_flag;
+}
+
+static void scalar_and4(unsigned long*aa, unsigned long*ab,
+			const unsigned long*ba, const unsigned long*bb,
+			unsigned words)
+{
+      and4_words(aa, ab, ba, bb, 0, words);
+}
+
+static void scalar_or4(unsigned long*aa, unsigned long*ab,
+		       const unsigned long*ba, const unsigned long*bb,
+		       unsigned words)
+{
+      or4_words(aa, ab, ba, bb, 0, words);
+}
+
+static bool scalar_equal(const unsigned long*a, const unsigned long*b,
+			 unsigned words)
+{
+      return equal_words(a, b, 0, words);
+}
+
+static bool scalar_update(unsigned long*dst, const unsigned long*src,
+			  unsigned words)
+{
+      return update_words(dst, src, 0, words);
+}
+
+const struct vvp_simd_ops_s vvp_simd_scalar = {
+      "scalar",
+      &scalar_and4,
+      &scalar_or4,
+      &scalar_equal,
+      &scalar_update
+};
+
+const struct vvp_simd_ops_s*vvp_simd = &vvp_simd_scalar;
+
+#ifdef VVP_SIMD_X86
+
+/*
+ * The SSE2 kernels work on 128 bits at a time.
+ */
+static const unsigned SSE_WORDS = 16 / sizeof(unsigned long);
+
+__attribute__((target("sse2")))
+static void sse2_and4(unsigned long*aa, unsigned long*ab,
+		      const unsigned long*ba, const unsigned long*bb,
+		      unsigned words)
+{
+      unsigned idx = 0;
+      for ( ; idx + SSE_WORDS <= words ; idx += SSE_WORDS) {
+	    __m128i va = _mm_loadu_si128((const __m128i*)(aa+idx));
+	    __m128i vb = _mm_loadu_si128((const __m128i*)(ab+idx));
+	    __m128i wa = _mm_loadu_si128((const __m128i*)(ba+idx));
+	    __m128i wb = _mm_loadu_si128((const __m128i*)(bb+idx));
+	    __m128i tmp1 = _mm_or_si128(va, vb);
+	    __m128i tmp2 = _mm_or_si128(wa, wb);
+	    _mm_storeu_si128((__m128i*)(aa+idx), _mm_and_si128(tmp1, tmp2));
+	    _mm_storeu_si128((__m128i*)(ab+idx),
+			     _mm_or_si128(_mm_and_si128(tmp1, wb),
+					  _mm_and_si128(tmp2, vb)));
+      }
+      and4_words(aa, ab, ba, bb, idx, words);
+}
+
+__attribute__((target("sse2")))
+static void sse2_or4(unsigned long*aa, unsigned long*ab,
+		     const unsigned long*ba, const unsigned long*bb,
+		     unsigned words)
+{
+      unsigned idx = 0;
+      for ( ; idx + SSE_WORDS <= words ; idx += SSE_WORDS) {
+	    __m128i va = _mm_loadu_si128((const __m128i*)(aa+idx));
+	    __m128i vb = _mm_loadu_si128((const __m128i*)(ab+idx));
+	    __m128i wa = _mm_loadu_si128((const __m128i*)(ba+idx));
+	    __m128i wb = _mm_loadu_si128((const __m128i*)(bb+idx));
+	    __m128i tmp = _mm_or_si128(_mm_or_si128(va, vb),
+				       _mm_or_si128(wa, wb));
+	      // (~a | b) is computed as ~(a & ~b) with andnot.
+	    __m128i nva = _mm_andnot_si128(_mm_andnot_si128(vb, va), wb);
+	    __m128i nwa = _mm_andnot_si128(_mm_andnot_si128(wb, wa), vb);
+	    _mm_storeu_si128((__m128i*)(ab+idx), _mm_or_si128(nva, nwa));
+	    _mm_storeu_si128((__m128i*)(aa+idx), tmp);
+      }
+      or4_words(aa, ab, ba, bb, idx, words);
+}
+
+__attribute__((target("sse2")))
+static bool sse2_equal(const unsigned long*a, const unsigned long*b,
+		       unsigned words)
+{
+      unsigned idx = 0;
+      for ( ; idx + SSE_WORDS <= words ; idx += SSE_WORDS) {
+	    __m128i va = _mm_loadu_si128((const __m128i*)(a+idx));
+	    __m128i vb = _mm_loadu_si128((const __m128i*)(b+idx));
+	    if (_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) != 0xffff)
+		  return false;
+      }
+      return equal_words(a, b, idx, words);
+}
+
+__attribute__((target("sse2")))
+static bool sse2_update(unsigned long*dst, const unsigned long*src,
+			unsigned words)
+{
+      int same = 0xffff;
+      unsigned idx = 0;
+      for ( ; idx + SSE_WORDS <= words ; idx += SSE_WORDS) {
+	    __m128i vd = _mm_loadu_si128((const __m128i*)(dst+idx));
+	    __m128i vs = _mm_loadu_si128((const __m128i*)(src+idx));
+	    same &= _mm_movemask_epi8(_mm_cmpeq_epi8(vd, vs));
+	    _mm_storeu_si128((__m128i*)(dst+idx), vs);
+      }
+      bool diff_flag = update_words(dst, src, idx, words);
+      return diff_flag || same != 0xffff;
+}
+
+static const struct vvp_simd_ops_s vvp_simd_sse2 = {
+      "sse2",
+      &sse2_and4,
+      &sse2_or4,
+      &sse2_equal,
+      &sse2_update
+};
+
+/*
+ * The AVX2 kernels work on 256 bits at a time.
+ */
+static const unsigned AVX_WORDS = 32 / sizeof(unsigned long);
+
+__attribute__((target("avx2")))
+static void avx2_and4(unsigned long*aa, unsigned long*ab,
+		      const unsigned long*ba, const unsigned long*bb,
+		      unsigned words)
+{
+      unsigned idx = 0;
+      for ( ; idx + AVX_WORDS <= words ; idx += AVX_WORDS) {
+	    __m256i va = _mm256_loadu_si256((const __m256i*)(aa+idx));
+	    __m256i vb = _mm256_loadu_si256((const __m256i*)(ab+idx));
+	    __m256i wa = _mm256_loadu_si256((const __m256i*)(ba+idx));
+	    __m256i wb = _mm256_loadu_si256((const __m256i*)(bb+idx));
+	    __m256i tmp1 = _mm256_or_si256(va, vb);
+	    __m256i tmp2 = _mm256_or_si256(wa, wb);
+	    _mm256_storeu_si256((__m256i*)(aa+idx),
+				_mm256_and_si256(tmp1, tmp2));
+	    _mm256_storeu_si256((__m256i*)(ab+idx),
+				_mm256_or_si256(_mm256_and_si256(tmp1, wb),
+						_mm256_and_si256(tmp2, vb)));
+      }
+      and4_words(aa, ab, ba, bb, idx, words);
+}
+
+__attribute__((target("avx2")))
+static void avx2_or4(unsigned long*aa, unsigned long*ab,
+		     const unsigned long*ba, const unsigned long*bb,
+		     unsigned words)
+{
+      unsigned idx = 0;
+      for ( ; idx + AVX_WORDS <= words ; idx += AVX_WORDS) {
+	    __m256i va = _mm256_loadu_si256((const __m256i*)(aa+idx));
+	    __m256i vb = _mm256_loadu_si256((const __m256i*)(ab+idx));
+	    __m256i wa = _mm256_loadu_si256((const __m256i*)(ba+idx));
+	    __m256i wb = _mm256_loadu_si256((const __m256i*)(bb+idx));
+	    __m256i tmp = _mm256_or_si256(_mm256_or_si256(va, vb),
+					  _mm256_or_si256(wa, wb));
+	    __m256i nva = _mm256_andnot_si256(_mm256_andnot_si256(vb, va), wb);
+	    __m256i nwa = _mm256_andnot_si256(_mm256_andnot_si256(wb, wa), vb);
+	    _mm256_storeu_si256((__m256i*)(ab+idx), _mm256_or_si256(nva, nwa));
+	    _mm256_storeu_si256((__m256i*)(aa+idx), tmp);
+      }
+      or4_words(aa, ab, ba, bb, idx, words);
+}
+
+__attribute__((target("avx2")))
+static bool avx2_equal(const unsigned long*a, const unsigned long*b,
+		       unsigned words)
+{
+      unsigned idx = 0;
+      for ( ; idx + AVX_WORDS <= words ; idx += AVX_WORDS) {
+	    __m256i va = _mm256_loadu_si256((const __m256i*)(a+idx));
+	    __m256i vb = _mm256_loadu_si256((const __m256i*)(b+idx));
+	    __m256i dif = _mm256_xor_si256(va, vb);
+	    if (! _mm256_testz_si256(dif, dif))
+		  return false;
+      }
+      return equal_words(a, b, idx, words);
+}
+
+__attribute__((target("avx2")))
+static bool avx2_update(unsigned long*dst, const unsigned long*src,
+			unsigned words)
+{
+      __m256i dif = _mm256_setzero_si256();
+      unsigned idx = 0;
+      for ( ; idx + AVX_WORDS <= words ; idx += AVX_WORDS) {
+	    __m256i vd = _mm256_loadu_si256((const __m256i*)(dst+idx));
+	    __m256i vs = _mm256_loadu_si256((const __m256i*)(src+idx));
+	    dif = _mm256_or_si256(dif, _mm256_xor_si256(vd, vs));
+	    _mm256_storeu_si256((__m256i*)(dst+idx), vs);
+      }
+      bool diff_flag = update_words(dst, src, idx, words);
+      return diff_flag || ! _mm256_testz_si256(dif, dif);
+}
+
+static const struct vvp_simd_ops_s vvp_simd_avx2 = {
+      "avx2",
+      &avx2_and4,
+      &avx2_or4,
+      &avx2_equal,
+      &avx2_update
+};
+
+#endif
+
+const struct vvp_simd_ops_s*vvp_simd_best(void)
+{
+#ifdef VVP_SIMD_X86
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("avx2"))
+	    return &vvp_simd_avx2;
+      if (__builtin_cpu_supports("sse2"))
+	    return &vvp_simd_sse2;
+#endif
+      return &vvp_simd_scalar;
+}
+
+void vvp_simd_init(void)
+{
+      vvp_simd = vvp_simd_best();
+}
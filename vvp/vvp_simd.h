@@ -0,0 +1,62 @@
+#ifndef __vvp_simd_H
+#define __vvp_simd_H
+/*
+ * Copyright (c) 2012 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+/*
+ * These are the word array kernels behind the wide (more than one
+ * word) vvp_vector4_t operations. The abits and bbits of a vector are
+ * passed as separate arrays of the given number of words.
+ *
+ * There is a plain C++ version of each kernel, and on x86 machines
+ * there are also SSE2 and AVX2 versions. The vvp_simd_init function
+ * checks what the processor supports and points vvp_simd at the best
+ * set of kernels. Until then, vvp_simd points at the scalar kernels.
+ */
+struct vvp_simd_ops_s {
+      const char*name;
+
+	// Do the 4-value a &= b, where (aa,ab) are the abits and
+	// bbits of a, and (ba,bb) the abits and bbits of b.
+      void (*and4)(unsigned long*aa, unsigned long*ab,
+		   const unsigned long*ba, const unsigned long*bb,
+		   unsigned words);
+	// Do the 4-value a |= b.
+      void (*or4)(unsigned long*aa, unsigned long*ab,
+		  const unsigned long*ba, const unsigned long*bb,
+		  unsigned words);
+	// Return true if the arrays are equal.
+      bool (*equal)(const unsigned long*a, const unsigned long*b,
+		    unsigned words);
+	// Copy src into dst, and return true if any word changed.
+      bool (*update)(unsigned long*dst, const unsigned long*src,
+		     unsigned words);
+};
+
+extern const struct vvp_simd_ops_s vvp_simd_scalar;
+extern const struct vvp_simd_ops_s*vvp_simd;
+
+/*
+ * Return the best kernels that this processor can run.
+ */
+extern const struct vvp_simd_ops_s*vvp_simd_best(void);
+
+extern void vvp_simd_init(void);
+
+#endif